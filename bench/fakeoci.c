@@ -0,0 +1,1067 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+/****************************************************************************
+a stand-in for the Oracle client library (libclntsh.so). it implements the
+OCI calls opr resolves in loadOraLibs, against the databases, users and
+passwords listed in the file named by FAKEOCI_USERS, so opr can be run and
+benchmarked without a database or network. lines of that file are
+
+  <database> <schema> <password> [<verifiers>]
+  ! <database> <schema> <phase> <action> [rate=<percent>]
+
+verifiers is S, T, S,T or - (none), S by default. the second form injects
+faults: database and schema are patterns (* and ? wildcards), phase is one
+of attach, login, change or query, action is delay=<ms>, delay=<min>-<max>,
+hang or ora=<code>. all matching rules apply, delays add up. waits end
+early with ORA-01013 when OCIBreak is called, as opr's watchdog does.
+password changes are written back to the file.
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "oprhash.h"
+
+/* the OCI types and constants used, with the values of oci.h. oci.h is not
+   included since its prototypes would clash with the definitions here */
+typedef unsigned char  ub1;
+typedef unsigned short ub2;
+typedef short          sb2;
+typedef unsigned int   ub4;
+typedef int            sb4;
+typedef int            sword;
+typedef unsigned char  text;
+
+#define OCI_SUCCESS         0
+#define OCI_ERROR          -1
+#define OCI_INVALID_HANDLE -2
+#define OCI_NO_DATA       100
+
+#define OCI_HTYPE_ENV     1
+#define OCI_HTYPE_ERROR   2
+#define OCI_HTYPE_SVCCTX  3
+#define OCI_HTYPE_STMT    4
+#define OCI_HTYPE_SERVER  8
+#define OCI_HTYPE_SESSION 9
+
+#define OCI_ATTR_SERVER   6
+#define OCI_ATTR_SESSION  7
+#define OCI_ATTR_USERNAME 22
+#define OCI_ATTR_PASSWORD 23
+
+#define OCI_AUTH 0x00000008
+
+/* the environment variable naming the users file */
+#define FAKEOCI_USERS "FAKEOCI_USERS"
+
+/* width of database, schema and password names */
+#define W_NAME 128
+
+/* width of a spare4 value holding both an S: and a T: verifier */
+#define W_VERIFIERS 256
+
+/* width of an error message */
+#define W_MESSAGE 512
+
+/* width of a line in the users file */
+#define W_LINE 1024
+
+/* the phases faults can be injected in */
+#define PHASE_ATTACH 0
+#define PHASE_LOGIN  1
+#define PHASE_CHANGE 2
+#define PHASE_QUERY  3
+
+/* fault actions */
+#define ACTION_DELAY 0
+#define ACTION_HANG  1
+#define ACTION_ORA   2
+
+/* the verifiers kept for a user */
+#define VERIFIER_S 1
+#define VERIFIER_T 2
+
+/* salt sizes and the 12c (T:) key derivation, as checked by oprhash.c */
+#define S_SALT        10
+#define T_SALT        16
+#define T_ITERATIONS  4096
+#define T_SALT_SUFFIX "AUTH_PBKDF2_SPEEDY_KEY"
+
+/****************************************************************************
+a database user. spare4 caches the verifiers once computed, it is empty
+until then.
+****************************************************************************/
+typedef struct {
+  char database[W_NAME];
+  char schema[W_NAME];
+  char passwd[W_NAME];
+  int  verifiers;
+  char spare4[W_VERIFIERS];
+} FakeUser;
+
+/****************************************************************************
+a fault rule, database and schema are upper case patterns. a delay lasts
+between value and value2 milliseconds, an ora fault raises error value.
+rate is the percentage of matching calls the rule fires on.
+****************************************************************************/
+typedef struct {
+  char database[W_NAME];
+  char schema[W_NAME];
+  int  phase;
+  int  action;
+  long value;
+  long value2;
+  int  rate;
+} FakeRule;
+
+/****************************************************************************
+the faults to inject into one call, collected from the matching rules.
+****************************************************************************/
+typedef struct {
+  long delay;
+  int  hang;
+  int  oracode;
+} Fault;
+
+/****************************************************************************
+every handle starts with a Handle, linking it to the environment it was
+allocated from. freeing the environment frees all its handles, as the
+Oracle client does.
+****************************************************************************/
+typedef struct Handle {
+  int           type;
+  struct OCIEnv *env;
+  struct Handle *prev;
+  struct Handle *next;
+} Handle;
+
+typedef struct OCIEnv {
+  Handle          handle;
+  pthread_mutex_t mutex;
+  Handle          *children;
+} OCIEnv;
+
+typedef struct OCIError {
+  Handle handle;
+  int    oracode;
+  char   message[W_MESSAGE];
+} OCIError;
+
+typedef struct OCIServer {
+  Handle          handle;
+  char            database[W_NAME];
+  int             attached;
+  int             broken;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+} OCIServer;
+
+typedef struct OCISession {
+  Handle handle;
+  char   username[W_NAME];
+  char   passwd[W_NAME];
+  int    begun;
+} OCISession;
+
+typedef struct OCISvcCtx {
+  Handle     handle;
+  OCIServer  *server;
+  OCISession *session;
+} OCISvcCtx;
+
+typedef struct OCIDefine {
+  void *value;
+  sb4  size;
+  sb2  *indicator;
+} OCIDefine;
+
+typedef struct OCIStmt {
+  Handle    handle;
+  OCISvcCtx *service;
+  OCIDefine define[2];
+  FakeUser  *rows;
+  int       count;
+  int       fetched;
+} OCIStmt;
+
+/* the users file as last read, guarded by tablemutex */
+static pthread_mutex_t tablemutex = PTHREAD_MUTEX_INITIALIZER;
+static FakeUser        *users = NULL;
+static int             userscount = 0;
+static FakeRule        *rules = NULL;
+static int             rulescount = 0;
+static struct stat     usersstat;
+static int             usersloaded = 0;
+static unsigned long   generation = 0;
+static unsigned long   seed = 0;
+
+/****************************************************************************
+  purpose: copy s upper cased into a name buffer of W_NAME.
+****************************************************************************/
+static void upperName( char *name, const char *s, size_t len )
+{
+  size_t i;
+  if ( len > W_NAME - 1 ) len = W_NAME - 1;
+  for ( i = 0; i < len && s[i]; i++ )
+    name[i] = toupper( (unsigned char) s[i] );
+  name[i] = 0;
+}
+
+/****************************************************************************
+  purpose: match an upper case name against a pattern with * and ?.
+****************************************************************************/
+static int matchName( const char *pattern, const char *name )
+{
+  if ( *pattern == 0 ) return *name == 0;
+  if ( *pattern == '*' )
+    return matchName( pattern + 1, name ) ||
+           ( *name && matchName( pattern, name + 1 ) );
+  if ( *name && ( *pattern == '?' || *pattern == *name ) )
+    return matchName( pattern + 1, name + 1 );
+  return 0;
+}
+
+/****************************************************************************
+  purpose: a pseudo random number in [0,n), caller holds tablemutex.
+****************************************************************************/
+static long randomBelow( long n )
+{
+  if ( !seed ) seed = (unsigned long) time( NULL ) ^ ( getpid() << 16 );
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return n > 0 ? (long) ( ( seed >> 33 ) % (unsigned long) n ) : 0;
+}
+
+/****************************************************************************
+  purpose: parse a fault rule, the words after the leading '!'.
+  post   : returns 0 if the line is not a valid rule.
+****************************************************************************/
+static int parseRule( char *line, FakeRule *rule )
+{
+  char database[W_NAME], schema[W_NAME], phase[32], action[64], rate[32];
+  int  n;
+  n = sscanf( line, "%127s %127s %31s %63s %31s",
+              database, schema, phase, action, rate );
+  if ( n < 4 ) return 0;
+  upperName( rule->database, database, strlen( database ) );
+  upperName( rule->schema, schema, strlen( schema ) );
+  if ( strcmp( phase, "attach" ) == 0 ) rule->phase = PHASE_ATTACH;
+  else if ( strcmp( phase, "login" ) == 0 ) rule->phase = PHASE_LOGIN;
+  else if ( strcmp( phase, "change" ) == 0 ) rule->phase = PHASE_CHANGE;
+  else if ( strcmp( phase, "query" ) == 0 ) rule->phase = PHASE_QUERY;
+  else return 0;
+  rule->value = rule->value2 = 0;
+  if ( strcmp( action, "hang" ) == 0 ) rule->action = ACTION_HANG;
+  else if ( sscanf( action, "ora=%ld", &rule->value ) == 1 )
+    rule->action = ACTION_ORA;
+  else if ( sscanf( action, "delay=%ld-%ld", &rule->value, &rule->value2 ) >= 1 )
+  {
+    rule->action = ACTION_DELAY;
+    if ( rule->value2 < rule->value ) rule->value2 = rule->value;
+  } else return 0;
+  rule->rate = 100;
+  if ( n == 5 && sscanf( rate, "rate=%d", &rule->rate ) != 1 ) return 0;
+  return 1;
+}
+
+/****************************************************************************
+  purpose: parse a user line.
+  post   : returns 0 if the line is not a valid user.
+****************************************************************************/
+static int parseUser( char *line, FakeUser *user )
+{
+  char database[W_NAME], schema[W_NAME], verifiers[32];
+  int  n;
+  n = sscanf( line, "%127s %127s %127s %31s",
+              database, schema, user->passwd, verifiers );
+  if ( n < 3 ) return 0;
+  upperName( user->database, database, strlen( database ) );
+  upperName( user->schema, schema, strlen( schema ) );
+  user->verifiers = VERIFIER_S;
+  if ( n == 4 )
+  {
+    user->verifiers = 0;
+    if ( strchr( verifiers, 'S' ) ) user->verifiers |= VERIFIER_S;
+    if ( strchr( verifiers, 'T' ) ) user->verifiers |= VERIFIER_T;
+  }
+  user->spare4[0] = 0;
+  return 1;
+}
+
+/****************************************************************************
+  purpose: (re)read the users file when it changed since it was last read.
+  pre    : tablemutex is held.
+  post   : returns 0 if the file cannot be read.
+****************************************************************************/
+static int loadUsers()
+{
+  const char  *filename = getenv( FAKEOCI_USERS );
+  struct stat st;
+  char        line[W_LINE];
+  FILE        *file;
+  int         maxusers = 0, maxrules = 0;
+
+  if ( !filename || stat( filename, &st ) ) return 0;
+  if ( usersloaded &&
+       st.st_ino == usersstat.st_ino &&
+       st.st_size == usersstat.st_size &&
+       st.st_mtime == usersstat.st_mtime ) return 1;
+  file = fopen( filename, "r" );
+  if ( !file ) return 0;
+  userscount = rulescount = 0;
+  while ( fgets( line, sizeof( line ), file ) )
+  {
+    char *p = line;
+    while ( isspace( (unsigned char) *p ) ) p++;
+    if ( *p == 0 || *p == '#' ) continue;
+    if ( *p == '!' )
+    {
+      if ( rulescount == maxrules )
+      {
+        maxrules = maxrules ? 2 * maxrules : 16;
+        rules = (FakeRule*) realloc( rules, maxrules * sizeof( FakeRule ) );
+      }
+      if ( rules && parseRule( p + 1, &rules[rulescount] ) ) rulescount++;
+    } else
+    {
+      if ( userscount == maxusers )
+      {
+        maxusers = maxusers ? 2 * maxusers : 256;
+        users = (FakeUser*) realloc( users, maxusers * sizeof( FakeUser ) );
+      }
+      if ( users && parseUser( p, &users[userscount] ) ) userscount++;
+    }
+  }
+  fclose( file );
+  if ( ( maxusers && !users ) || ( maxrules && !rules ) )
+  {
+    userscount = rulescount = 0;
+    return 0;
+  }
+  usersstat = st;
+  usersloaded = 1;
+  generation++;
+  return 1;
+}
+
+/****************************************************************************
+  purpose: find a user, database and schema are upper case.
+  pre    : tablemutex is held.
+****************************************************************************/
+static FakeUser* findUser( const char *database, const char *schema )
+{
+  int i;
+  for ( i = 0; i < userscount; i++ )
+    if ( strcmp( users[i].database, database ) == 0 &&
+         strcmp( users[i].schema, schema ) == 0 ) return &users[i];
+  return NULL;
+}
+
+/****************************************************************************
+  purpose: returns whether the database has any user.
+  pre    : tablemutex is held.
+****************************************************************************/
+static int knownDatabase( const char *database )
+{
+  int i;
+  for ( i = 0; i < userscount; i++ )
+    if ( strcmp( users[i].database, database ) == 0 ) return 1;
+  return 0;
+}
+
+/****************************************************************************
+  purpose: collect the faults of the rules matching a call. schema is NULL
+           for calls made before a logon, only rules on any schema match
+           those.
+  pre    : tablemutex is held.
+****************************************************************************/
+static void collectFaults( int        phase,
+                           const char *database,
+                           const char *schema,
+                           Fault      *fault )
+{
+  int i;
+  fault->delay = 0;
+  fault->hang = 0;
+  fault->oracode = 0;
+  for ( i = 0; i < rulescount; i++ )
+  {
+    FakeRule *rule = &rules[i];
+    if ( rule->phase != phase ||
+         !matchName( rule->database, database ) ) continue;
+    if ( schema ? !matchName( rule->schema, schema )
+                : strcmp( rule->schema, "*" ) != 0 ) continue;
+    if ( rule->rate < 100 && randomBelow( 100 ) >= rule->rate ) continue;
+    switch ( rule->action )
+    {
+      case ACTION_DELAY:
+        fault->delay += rule->value +
+                        randomBelow( rule->value2 - rule->value + 1 );
+        break;
+      case ACTION_HANG:
+        fault->hang = 1;
+        break;
+      case ACTION_ORA:
+        if ( !fault->oracode ) fault->oracode = (int) rule->value;
+        break;
+    }
+  }
+}
+
+/****************************************************************************
+  purpose: set the error of a failed call.
+****************************************************************************/
+static sword oraError( OCIError *error, int oracode )
+{
+  const char *text;
+  switch ( oracode )
+  {
+    case 942:   text = "table or view does not exist"; break;
+    case 1013:  text = "user requested cancel of current operation"; break;
+    case 1017:  text = "invalid username/password; logon denied"; break;
+    case 1031:  text = "insufficient privileges"; break;
+    case 3113:  text = "end-of-file on communication channel"; break;
+    case 3114:  text = "not connected to ORACLE"; break;
+    case 12154: text = "TNS:could not resolve the connect identifier specified"; break;
+    case 12170: text = "TNS:Connect timeout occurred"; break;
+    case 12541: text = "TNS:no listener"; break;
+    case 28000: text = "the account is locked"; break;
+    case 28001: text = "the password has expired"; break;
+    case 28003: text = "password verification for the specified password failed"; break;
+    default:    text = "injected error"; break;
+  }
+  if ( error )
+  {
+    error->oracode = oracode;
+    snprintf( error->message, sizeof( error->message ),
+              "ORA-%05d: %s\n", oracode, text );
+  }
+  return OCI_ERROR;
+}
+
+/****************************************************************************
+  purpose: wait ms milliseconds, or until broken when hang is set.
+  post   : returns OCI_SUCCESS, or OCI_ERROR with ORA-01013 when OCIBreak
+           was called on the server.
+****************************************************************************/
+static sword fakeWait( OCIServer *server,
+                       OCIError  *error,
+                       long      ms,
+                       int       hang )
+{
+  struct timespec until;
+  int             broken;
+  if ( ms <= 0 && !hang ) return server->broken ? oraError( error, 1013 )
+                                                : OCI_SUCCESS;
+  clock_gettime( CLOCK_MONOTONIC, &until );
+  until.tv_sec += ms / 1000;
+  until.tv_nsec += ( ms % 1000 ) * 1000000L;
+  if ( until.tv_nsec >= 1000000000L )
+  {
+    until.tv_sec++;
+    until.tv_nsec -= 1000000000L;
+  }
+  pthread_mutex_lock( &server->mutex );
+  while ( !server->broken )
+  {
+    if ( hang ) pthread_cond_wait( &server->cond, &server->mutex );
+    else if ( pthread_cond_timedwait( &server->cond,
+                                      &server->mutex,
+                                      &until ) == ETIMEDOUT ) break;
+  }
+  broken = server->broken;
+  pthread_mutex_unlock( &server->mutex );
+  return broken ? oraError( error, 1013 ) : OCI_SUCCESS;
+}
+
+/****************************************************************************
+  purpose: inject the faults of the rules matching a call.
+  post   : returns OCI_SUCCESS if the call is to proceed.
+****************************************************************************/
+static sword inject( int        phase,
+                     OCIServer  *server,
+                     OCIError   *error,
+                     const char *schema )
+{
+  Fault fault;
+  sword result;
+  pthread_mutex_lock( &tablemutex );
+  collectFaults( phase, server->database, schema, &fault );
+  pthread_mutex_unlock( &tablemutex );
+  result = fakeWait( server, error, fault.delay, fault.hang );
+  if ( result == OCI_SUCCESS && fault.oracode )
+    result = oraError( error, fault.oracode );
+  return result;
+}
+
+/****************************************************************************
+  purpose: allocate a handle of size bytes and link it to env.
+****************************************************************************/
+static void* newHandle( OCIEnv *env, int type, size_t size )
+{
+  Handle *handle = (Handle*) calloc( 1, size );
+  if ( !handle ) return NULL;
+  handle->type = type;
+  handle->env = env;
+  pthread_mutex_lock( &env->mutex );
+  handle->next = env->children;
+  if ( env->children ) env->children->prev = handle;
+  env->children = handle;
+  pthread_mutex_unlock( &env->mutex );
+  return handle;
+}
+
+/****************************************************************************
+  purpose: release the resources of a handle other than its memory.
+****************************************************************************/
+static void clearHandle( Handle *handle )
+{
+  if ( handle->type == OCI_HTYPE_SERVER )
+  {
+    pthread_mutex_destroy( &( (OCIServer*) handle )->mutex );
+    pthread_cond_destroy( &( (OCIServer*) handle )->cond );
+  } else
+  if ( handle->type == OCI_HTYPE_STMT )
+    free( ( (OCIStmt*) handle )->rows );
+}
+
+/****************************************************************************
+  purpose: unlink a handle from its environment and free it.
+****************************************************************************/
+static void freeHandle( Handle *handle )
+{
+  OCIEnv *env = handle->env;
+  pthread_mutex_lock( &env->mutex );
+  if ( handle->prev ) handle->prev->next = handle->next;
+  else env->children = handle->next;
+  if ( handle->next ) handle->next->prev = handle->prev;
+  pthread_mutex_unlock( &env->mutex );
+  clearHandle( handle );
+  free( handle );
+}
+
+/****************************************************************************
+  purpose: append the hex encoding of data to s.
+****************************************************************************/
+static char* appendHex( char *s, const unsigned char *data, size_t len )
+{
+  size_t i;
+  for ( i = 0; i < len; i++ ) s += sprintf( s, "%02X", data[i] );
+  return s;
+}
+
+/****************************************************************************
+  purpose: compute the spare4 value of a user. the salts are derived from
+           the user and password, so verifiers are the same on every run.
+****************************************************************************/
+static void makeVerifiers( FakeUser *user )
+{
+  unsigned char buffer[3 * W_NAME + SHA512_SIZE + T_SALT];
+  unsigned char seedhash[SHA1_SIZE];
+  unsigned char digest[SHA512_SIZE];
+  unsigned char salt[T_SALT + sizeof( T_SALT_SUFFIX )];
+  size_t        len = strlen( user->passwd );
+  char          *s = user->spare4;
+
+  snprintf( (char*) buffer, sizeof( buffer ), "%s/%s/%s",
+            user->database, user->schema, user->passwd );
+  sha1( buffer, strlen( (char*) buffer ), seedhash );
+  *s = 0;
+  if ( user->verifiers & VERIFIER_S )
+  {
+    memcpy( buffer, user->passwd, len );
+    memcpy( buffer + len, seedhash, S_SALT );
+    sha1( buffer, len + S_SALT, digest );
+    s += sprintf( s, "S:" );
+    s = appendHex( s, digest, SHA1_SIZE );
+    s = appendHex( s, seedhash, S_SALT );
+  }
+  if ( user->verifiers & VERIFIER_T )
+  {
+    memcpy( salt, seedhash + SHA1_SIZE - T_SALT, T_SALT );
+    memcpy( salt + T_SALT, T_SALT_SUFFIX, strlen( T_SALT_SUFFIX ) );
+    pbkdf2Sha512( (const unsigned char*) user->passwd, len,
+                  salt, T_SALT + strlen( T_SALT_SUFFIX ),
+                  T_ITERATIONS, buffer, SHA512_SIZE );
+    memcpy( buffer + SHA512_SIZE, salt, T_SALT );
+    sha512( buffer, SHA512_SIZE + T_SALT, digest );
+    if ( s != user->spare4 ) s += sprintf( s, ";" );
+    s += sprintf( s, "T:" );
+    s = appendHex( s, digest, SHA512_SIZE );
+    s = appendHex( s, salt, T_SALT );
+  }
+}
+
+/****************************************************************************
+  purpose: write a changed password back to the users file. the file is
+           rewritten to a temporary file that replaces it, under a lock on
+           <file>.lock so concurrent processes do not lose changes.
+  post   : returns 0 on failure.
+****************************************************************************/
+static int storePasswd( const char *database,
+                        const char *schema,
+                        const char *passwd )
+{
+  const char *filename = getenv( FAKEOCI_USERS );
+  char       lockname[W_LINE], tmpname[W_LINE], line[W_LINE];
+  FILE       *in, *out;
+  int        lock, result = 1;
+
+  snprintf( lockname, sizeof( lockname ), "%s.lock", filename );
+  snprintf( tmpname, sizeof( tmpname ), "%s.%d", filename, (int) getpid() );
+  lock = open( lockname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR );
+  if ( lock < 0 || flock( lock, LOCK_EX ) )
+  {
+    if ( lock >= 0 ) close( lock );
+    return 0;
+  }
+  in = fopen( filename, "r" );
+  out = fopen( tmpname, "w" );
+  if ( !in || !out ) result = 0;
+  while ( result && fgets( line, sizeof( line ), in ) )
+  {
+    FakeUser user;
+    char     *p = line;
+    while ( isspace( (unsigned char) *p ) ) p++;
+    if ( *p != '#' && *p != '!' && parseUser( p, &user ) &&
+         strcmp( user.database, database ) == 0 &&
+         strcmp( user.schema, schema ) == 0 )
+    {
+      char name[W_NAME], owner[W_NAME], verifiers[32];
+      int  n = sscanf( p, "%127s %127s %*s %31s", name, owner, verifiers );
+      fprintf( out, "%s %s %s%s%s\n", name, owner, passwd,
+               n == 3 ? " " : "", n == 3 ? verifiers : "" );
+    } else fputs( line, out );
+  }
+  if ( in ) fclose( in );
+  if ( out && fclose( out ) ) result = 0;
+  if ( result && rename( tmpname, filename ) ) result = 0;
+  if ( !result ) unlink( tmpname );
+  flock( lock, LOCK_UN );
+  close( lock );
+  return result;
+}
+
+/****************************************************************************
+  purpose: check a logon against the users table.
+  post   : returns OCI_SUCCESS, or OCI_ERROR with ORA-01017.
+****************************************************************************/
+static sword logon( OCIServer  *server,
+                    OCIError   *error,
+                    const char *schema,
+                    const char *passwd )
+{
+  FakeUser *user;
+  int      valid;
+  pthread_mutex_lock( &tablemutex );
+  loadUsers();
+  user = findUser( server->database, schema );
+  valid = user && strcmp( user->passwd, passwd ) == 0;
+  pthread_mutex_unlock( &tablemutex );
+  return valid ? OCI_SUCCESS : oraError( error, 1017 );
+}
+
+sword OCIEnvCreate( OCIEnv  **envp,
+                    ub4     mode,
+                    void    *ctxp,
+                    void    *malocfp,
+                    void    *ralocfp,
+                    void    *mfreefp,
+                    size_t  xtramemsz,
+                    void    **usrmempp )
+{
+  int loaded;
+  *envp = NULL;
+  pthread_mutex_lock( &tablemutex );
+  loaded = loadUsers();
+  pthread_mutex_unlock( &tablemutex );
+  if ( !loaded )
+  {
+    fprintf( stderr,
+             "fakeoci: unable to read the users file named by %s.\n",
+             FAKEOCI_USERS );
+    return OCI_ERROR;
+  }
+  *envp = (OCIEnv*) calloc( 1, sizeof( OCIEnv ) );
+  if ( !*envp ) return OCI_ERROR;
+  ( *envp )->handle.type = OCI_HTYPE_ENV;
+  ( *envp )->handle.env = *envp;
+  pthread_mutex_init( &( *envp )->mutex, NULL );
+  return OCI_SUCCESS;
+}
+
+sword OCIHandleAlloc( const void *parenth,
+                      void       **hndlpp,
+                      ub4        type,
+                      size_t     xtramem_sz,
+                      void       **usrmempp )
+{
+  OCIEnv *env = ( (Handle*) parenth )->env;
+  size_t size;
+  switch ( type )
+  {
+    case OCI_HTYPE_ERROR:   size = sizeof( OCIError ); break;
+    case OCI_HTYPE_SERVER:  size = sizeof( OCIServer ); break;
+    case OCI_HTYPE_SESSION: size = sizeof( OCISession ); break;
+    case OCI_HTYPE_SVCCTX:  size = sizeof( OCISvcCtx ); break;
+    default: return OCI_INVALID_HANDLE;
+  }
+  *hndlpp = newHandle( env, type, size );
+  if ( !*hndlpp ) return OCI_ERROR;
+  if ( type == OCI_HTYPE_SERVER )
+  {
+    pthread_condattr_t attr;
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_mutex_init( &( (OCIServer*) *hndlpp )->mutex, NULL );
+    pthread_cond_init( &( (OCIServer*) *hndlpp )->cond, &attr );
+    pthread_condattr_destroy( &attr );
+  }
+  return OCI_SUCCESS;
+}
+
+sword OCIHandleFree( void *hndlp, ub4 type )
+{
+  Handle *handle = (Handle*) hndlp;
+  if ( !handle ) return OCI_INVALID_HANDLE;
+  if ( type == OCI_HTYPE_ENV )
+  {
+    OCIEnv *env = (OCIEnv*) handle;
+    while ( env->children )
+    {
+      Handle *child = env->children;
+      env->children = child->next;
+      clearHandle( child );
+      free( child );
+    }
+    pthread_mutex_destroy( &env->mutex );
+    free( env );
+  } else freeHandle( handle );
+  return OCI_SUCCESS;
+}
+
+sword OCIAttrSet( void     *trgthndlp,
+                  ub4      trghndltyp,
+                  void     *attributep,
+                  ub4      size,
+                  ub4      attrtype,
+                  OCIError *errhp )
+{
+  if ( trghndltyp == OCI_HTYPE_SVCCTX && attrtype == OCI_ATTR_SERVER )
+    ( (OCISvcCtx*) trgthndlp )->server = (OCIServer*) attributep;
+  else
+  if ( trghndltyp == OCI_HTYPE_SVCCTX && attrtype == OCI_ATTR_SESSION )
+    ( (OCISvcCtx*) trgthndlp )->session = (OCISession*) attributep;
+  else
+  if ( trghndltyp == OCI_HTYPE_SESSION && attrtype == OCI_ATTR_USERNAME )
+    upperName( ( (OCISession*) trgthndlp )->username,
+               (const char*) attributep, size );
+  else
+  if ( trghndltyp == OCI_HTYPE_SESSION && attrtype == OCI_ATTR_PASSWORD )
+  {
+    char *passwd = ( (OCISession*) trgthndlp )->passwd;
+    if ( size > W_NAME - 1 ) size = W_NAME - 1;
+    memcpy( passwd, attributep, size );
+    passwd[size] = 0;
+  }
+  return OCI_SUCCESS;
+}
+
+sword OCIServerAttach( OCIServer  *srvhp,
+                       OCIError   *errhp,
+                       const text *dblink,
+                       sb4        dblink_len,
+                       ub4        mode )
+{
+  sword result;
+  int   known;
+  upperName( srvhp->database, (const char*) dblink, dblink_len );
+  result = inject( PHASE_ATTACH, srvhp, errhp, NULL );
+  if ( result != OCI_SUCCESS ) return result;
+  pthread_mutex_lock( &tablemutex );
+  loadUsers();
+  known = knownDatabase( srvhp->database );
+  pthread_mutex_unlock( &tablemutex );
+  if ( !known ) return oraError( errhp, 12154 );
+  srvhp->attached = 1;
+  return OCI_SUCCESS;
+}
+
+sword OCIServerDetach( OCIServer *srvhp, OCIError *errhp, ub4 mode )
+{
+  srvhp->attached = 0;
+  return OCI_SUCCESS;
+}
+
+sword OCISessionBegin( OCISvcCtx  *svchp,
+                       OCIError   *errhp,
+                       OCISession *usrhp,
+                       ub4        credt,
+                       ub4        mode )
+{
+  sword result;
+  if ( !svchp->server || !svchp->server->attached )
+    return oraError( errhp, 3114 );
+  result = inject( PHASE_LOGIN, svchp->server, errhp, usrhp->username );
+  if ( result == OCI_SUCCESS )
+    result = logon( svchp->server, errhp, usrhp->username, usrhp->passwd );
+  if ( result == OCI_SUCCESS ) usrhp->begun = 1;
+  return result;
+}
+
+sword OCISessionEnd( OCISvcCtx  *svchp,
+                     OCIError   *errhp,
+                     OCISession *usrhp,
+                     ub4        mode )
+{
+  if ( usrhp ) usrhp->begun = 0;
+  return OCI_SUCCESS;
+}
+
+sword OCIPasswordChange( OCISvcCtx  *svchp,
+                         OCIError   *errhp,
+                         const text *user_name,
+                         ub4        usernm_len,
+                         const text *opasswd,
+                         ub4        opasswd_len,
+                         const text *npasswd,
+                         ub4        npasswd_len,
+                         ub4        mode )
+{
+  char     schema[W_NAME], oldpasswd[W_NAME], newpasswd[W_NAME];
+  FakeUser *user;
+  sword    result;
+
+  if ( !svchp->server || !svchp->server->attached )
+    return oraError( errhp, 3114 );
+  if ( opasswd_len > W_NAME - 1 || npasswd_len > W_NAME - 1 )
+    return oraError( errhp, 28003 );
+  upperName( schema, (const char*) user_name, usernm_len );
+  memcpy( oldpasswd, opasswd, opasswd_len );
+  oldpasswd[opasswd_len] = 0;
+  memcpy( newpasswd, npasswd, npasswd_len );
+  newpasswd[npasswd_len] = 0;
+
+  /* with OCI_AUTH the change logs on with the old password first */
+  result = OCI_SUCCESS;
+  if ( mode & OCI_AUTH )
+  {
+    result = inject( PHASE_LOGIN, svchp->server, errhp, schema );
+    if ( result == OCI_SUCCESS )
+      result = logon( svchp->server, errhp, schema, oldpasswd );
+  }
+  if ( result == OCI_SUCCESS )
+    result = inject( PHASE_CHANGE, svchp->server, errhp, schema );
+  if ( result != OCI_SUCCESS ) return result;
+
+  pthread_mutex_lock( &tablemutex );
+  loadUsers();
+  user = findUser( svchp->server->database, schema );
+  if ( !user || strcmp( user->passwd, oldpasswd ) )
+    result = oraError( errhp, 1017 );
+  else
+  if ( !storePasswd( svchp->server->database, schema, newpasswd ) )
+    result = oraError( errhp, 28003 );
+  else
+  {
+    /* the file changed, the next loadUsers reads it again */
+    strcpy( user->passwd, newpasswd );
+    user->spare4[0] = 0;
+    usersloaded = 0;
+  }
+  pthread_mutex_unlock( &tablemutex );
+  if ( result == OCI_SUCCESS && ( mode & OCI_AUTH ) && svchp->session )
+    svchp->session->begun = 1;
+  return result;
+}
+
+sword OCIErrorGet( void *hndlp,
+                   ub4  recordno,
+                   text *sqlstate,
+                   sb4  *errcodep,
+                   text *bufp,
+                   ub4  bufsiz,
+                   ub4  type )
+{
+  OCIError *error = (OCIError*) hndlp;
+  if ( type != OCI_HTYPE_ERROR || !error || !error->oracode )
+    return OCI_NO_DATA;
+  if ( errcodep ) *errcodep = error->oracode;
+  if ( bufp && bufsiz ) snprintf( (char*) bufp, bufsiz, "%s", error->message );
+  return OCI_SUCCESS;
+}
+
+sword OCIBreak( void *hndlp, OCIError *errhp )
+{
+  OCIServer *server = (OCIServer*) hndlp;
+  pthread_mutex_lock( &server->mutex );
+  server->broken = 1;
+  pthread_cond_broadcast( &server->cond );
+  pthread_mutex_unlock( &server->mutex );
+  return OCI_SUCCESS;
+}
+
+sword OCIReset( void *hndlp, OCIError *errhp )
+{
+  OCIServer *server = (OCIServer*) hndlp;
+  pthread_mutex_lock( &server->mutex );
+  server->broken = 0;
+  pthread_mutex_unlock( &server->mutex );
+  return OCI_SUCCESS;
+}
+
+sword OCIStmtPrepare2( OCISvcCtx  *svchp,
+                       OCIStmt    **stmtp,
+                       OCIError   *errhp,
+                       const text *stmttext,
+                       ub4        stmt_len,
+                       const text *key,
+                       ub4        keylen,
+                       ub4        language,
+                       ub4        mode )
+{
+  *stmtp = (OCIStmt*) newHandle( ( (Handle*) svchp )->env,
+                                 OCI_HTYPE_STMT,
+                                 sizeof( OCIStmt ) );
+  if ( !*stmtp ) return OCI_ERROR;
+  ( *stmtp )->service = svchp;
+  return OCI_SUCCESS;
+}
+
+sword OCIDefineByPos( OCIStmt   *stmtp,
+                      OCIDefine **defnpp,
+                      OCIError  *errhp,
+                      ub4       position,
+                      void      *valuep,
+                      sb4       value_sz,
+                      ub2       dty,
+                      void      *indp,
+                      ub2       *rlenp,
+                      ub2       *rcodep,
+                      ub4       mode )
+{
+  OCIDefine *define;
+  if ( position < 1 || position > 2 ) return oraError( errhp, 1007 );
+  define = &stmtp->define[position - 1];
+  define->value = valuep;
+  define->size = value_sz;
+  define->indicator = (sb2*) indp;
+  if ( defnpp ) *defnpp = define;
+  return OCI_SUCCESS;
+}
+
+/****************************************************************************
+the only statement opr executes is the verifier query on sys.user$, it is
+answered with the users of the attached database. verifiers are computed
+outside tablemutex, the T: verifier is slow by design.
+****************************************************************************/
+sword OCIStmtExecute( OCISvcCtx  *svchp,
+                      OCIStmt    *stmtp,
+                      OCIError   *errhp,
+                      ub4        iters,
+                      ub4        rowoff,
+                      const void *snap_in,
+                      void       *snap_out,
+                      ub4        mode )
+{
+  OCISession    *session = svchp->session;
+  unsigned long copied;
+  sword         result;
+  int           i;
+
+  if ( !session || !session->begun ) return oraError( errhp, 1012 );
+  result = inject( PHASE_QUERY, svchp->server, errhp, session->username );
+  if ( result != OCI_SUCCESS ) return result;
+
+  pthread_mutex_lock( &tablemutex );
+  loadUsers();
+  free( stmtp->rows );
+  stmtp->rows = (FakeUser*) malloc( ( userscount + 1 ) * sizeof( FakeUser ) );
+  stmtp->count = stmtp->fetched = 0;
+  for ( i = 0; stmtp->rows && i < userscount; i++ )
+    if ( strcmp( users[i].database, svchp->server->database ) == 0 )
+      stmtp->rows[stmtp->count++] = users[i];
+  copied = generation;
+  pthread_mutex_unlock( &tablemutex );
+  if ( !stmtp->rows ) return oraError( errhp, 4030 );
+
+  for ( i = 0; i < stmtp->count; i++ )
+  {
+    FakeUser *row = &stmtp->rows[i];
+    if ( row->spare4[0] || !row->verifiers ) continue;
+    makeVerifiers( row );
+    pthread_mutex_lock( &tablemutex );
+    if ( generation == copied )
+    {
+      FakeUser *user = findUser( row->database, row->schema );
+      if ( user && strcmp( user->passwd, row->passwd ) == 0 )
+        strcpy( user->spare4, row->spare4 );
+    }
+    pthread_mutex_unlock( &tablemutex );
+  }
+  return OCI_SUCCESS;
+}
+
+sword OCIStmtFetch2( OCIStmt  *stmtp,
+                     OCIError *errhp,
+                     ub4      nrows,
+                     ub2      orientation,
+                     sb4      scrolloffset,
+                     ub4      mode )
+{
+  FakeUser  *row;
+  OCIDefine *name = &stmtp->define[0];
+  OCIDefine *spare4 = &stmtp->define[1];
+  if ( stmtp->fetched >= stmtp->count ) return OCI_NO_DATA;
+  row = &stmtp->rows[stmtp->fetched++];
+  if ( name->value && name->size > 0 )
+    snprintf( (char*) name->value, name->size, "%s", row->schema );
+  if ( name->indicator ) *name->indicator = 0;
+  if ( spare4->value && spare4->size > 0 )
+    snprintf( (char*) spare4->value, spare4->size, "%s", row->spare4 );
+  if ( spare4->indicator ) *spare4->indicator = row->spare4[0] ? 0 : -1;
+  return OCI_SUCCESS;
+}
+
+sword OCIStmtRelease( OCIStmt    *stmtp,
+                      OCIError   *errhp,
+                      const text *key,
+                      ub4        keylen,
+                      ub4        mode )
+{
+  if ( stmtp ) freeHandle( (Handle*) stmtp );
+  return OCI_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#! /bin/sh
+#
+# oprbench.sh - measure opr add, crosscheck and modify throughput against
+#               the fake client library (fakeoci.c), without a database.
+#
+# usage: oprbench.sh [options] <opr> <fake oracle home>
+#
+#   -d <n>   databases (default 4)
+#   -s <n>   schemas per database (default 50)
+#   -a <ms>  attach latency (default 20)
+#   -l <ms>  login latency (default 5)
+#   -c <ms>  password change latency (default 10)
+#   -j <ms>  latency jitter, added to each of the above (default 0)
+#   -t <n>   threads for crosschecks and rotation (default 8)
+#   -m <n>   entries modified one by one with opr -m (default 20)
+#   -w       make the database calls through the worker (--worker)
+#
+# a temporary repository and users file are created and removed again. one
+# line is printed per measurement: name, operations, seconds, operations
+# per second.
+
+databases=4
+schemas=50
+attachms=20
+loginms=5
+changems=10
+jitter=0
+threads=8
+modifies=20
+worker=""
+
+usage()
+{
+  echo "usage: $0 [-d n] [-s n] [-a ms] [-l ms] [-c ms] [-j ms] [-t n] [-m n] [-w] <opr> <fake oracle home>" >&2
+  exit 1
+}
+
+while getopts "d:s:a:l:c:j:t:m:w" opt
+do
+  case $opt in
+    d) databases=$OPTARG ;;
+    s) schemas=$OPTARG ;;
+    a) attachms=$OPTARG ;;
+    l) loginms=$OPTARG ;;
+    c) changems=$OPTARG ;;
+    j) jitter=$OPTARG ;;
+    t) threads=$OPTARG ;;
+    m) modifies=$OPTARG ;;
+    w) worker="--worker --worker-idle=10" ;;
+    *) usage ;;
+  esac
+done
+shift `expr $OPTIND - 1`
+test $# -eq 2 || usage
+
+opr=$1
+home=$2
+if [ ! -x "$opr" ] || [ ! -f "$home/lib/libclntsh.so" ]; then
+  echo "$0: $opr is not executable or $home/lib/libclntsh.so is missing." >&2
+  exit 1
+fi
+
+work=`mktemp -d "${TMPDIR:-/tmp}/oprbench.XXXXXX"` || exit 1
+trap 'rm -rf "$work"' 0 1 2 15
+
+ORACLE_HOME=$home
+FAKEOCI_USERS=$work/users
+OPRREPOS=$work/bench.opr
+export ORACLE_HOME FAKEOCI_USERS OPRREPOS
+
+osuser=`id -un`
+entries=`expr $databases \* $schemas`
+
+# the users file, with every latency a fault rule on all databases
+{
+  echo "! * * attach delay=$attachms-`expr $attachms + $jitter`"
+  echo "! * * login delay=$loginms-`expr $loginms + $jitter`"
+  echo "! * * change delay=$changems-`expr $changems + $jitter`"
+  d=1
+  while [ $d -le $databases ]
+  do
+    echo "BENCH$d monitor monitor"
+    s=1
+    while [ $s -le $schemas ]
+    do
+      echo "BENCH$d user$s pw$s"
+      s=`expr $s + 1`
+    done
+    d=`expr $d + 1`
+  done
+} > "$FAKEOCI_USERS"
+
+now()
+{
+  date +%s.%N
+}
+
+# report <name> <operations> <start>
+report()
+{
+  awk -v name="$1" -v ops="$2" -v start="$3" -v end="`now`" 'BEGIN {
+    s = end - start
+    printf "%-24s %8d %10.3f %12.1f\n", name, ops, s, ( s > 0 ? ops / s : 0 )
+  }'
+}
+
+"$opr" -c > /dev/null || exit 1
+
+printf "%-24s %8s %10s %12s\n" "benchmark" "ops" "seconds" "ops/s"
+
+# add, one opr process per entry, each verified with a logon
+start=`now`
+d=1
+while [ $d -le $databases ]
+do
+  s=1
+  while [ $s -le $schemas ]
+  do
+    printf "pw$s\npw$s\n" | "$opr" -a BENCH$d user$s "$osuser" $worker > /dev/null || exit 1
+    s=`expr $s + 1`
+  done
+  d=`expr $d + 1`
+done
+report "add" $entries $start
+
+# the monitor entries are added without verification, they are not timed
+d=1
+while [ $d -le $databases ]
+do
+  printf "monitor\nmonitor\n" | "$opr" -a -f BENCH$d monitor "$osuser" > /dev/null || exit 1
+  d=`expr $d + 1`
+done
+entries=`expr $entries + $databases`
+
+start=`now`
+"$opr" -x --threads=$threads $worker > /dev/null
+report "crosscheck" $entries $start
+
+start=`now`
+"$opr" -x --threads=$threads --per-db=$threads $worker > /dev/null
+report "crosscheck per-db" $entries $start
+
+start=`now`
+"$opr" -x --threads=$threads --verifiers=monitor $worker > /dev/null
+report "crosscheck verifiers" $entries $start
+
+# modify, one opr process per entry
+start=`now`
+s=1
+while [ $s -le $modifies ] && [ $s -le $schemas ]
+do
+  printf "new$s\nnew$s\n" | "$opr" -m BENCH1 user$s $worker > /dev/null || exit 1
+  s=`expr $s + 1`
+done
+report "modify" `expr $s - 1` $start
+
+start=`now`
+"$opr" --rotate '*' 'user*' --threads=$threads $worker > /dev/null || exit 1
+report "rotate" `expr $databases \* $schemas` $start
@@ -0,0 +1,424 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+/****************************************************************************
+oprgen - generate a valid OPR repository of synthetic entries, for
+benchmarks. the entries follow skewed (zipf) distributions, as real
+repositories do: a few databases, schemas and os users hold most grants,
+with a long tail. the same seed generates the same repository.
+
+  oprgen [-n entries] [-d databases] [-s schemas] [-u osusers] [-S seed]
+         [-o owner] [-k keyfile] [-x] <file>
+  oprgen -E <file>
+
+the first os user is the owner (by default the calling user), so opr -r can
+be run against the generated repository. -k writes the database and schema
+of the owner's entries to keyfile, in random order, one per line. -x writes
+the entries in export format (see opr -e) instead of a repository. -E drops
+file from the page cache, for cold cache measurements.
+
+the on-disk format, the entry order and the encryption mirror writeHeader,
+compareEntries and cryptPassword in src/oprrepos.c, and must be kept in sync
+with them.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pwd.h>
+
+#define MAGIC "OraclePasswordRepository 1.3.0 "
+#define W_MAGIC 32
+#define W_LOGFILE 256
+#define W_DATABASE 64
+#define W_SCHEMANAME 30
+#define W_PASSWORD 30
+#define W_OSUSERNAME 32
+#define W_INTBUF 32
+#define LOG_ALL 2
+#define LOG_INTERVAL 3600
+
+typedef struct
+{
+  char database[W_DATABASE];
+  char schemaname[W_SCHEMANAME];
+  char osusername[W_OSUSERNAME];
+  char password[W_PASSWORD];
+} Entry;
+
+/* a zipf distribution over n values, sampled by a binary search of the
+   cumulative weights */
+typedef struct
+{
+  int     n;
+  double *cdf;
+} Zipf;
+
+static unsigned long long state;
+
+/****************************************************************************
+random 64 bit number (xorshift64*). rand() is not used, cryptEntry reseeds
+it for every entry.
+****************************************************************************/
+static unsigned long long random64( void )
+{
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 2685821657736338717ULL;
+}
+
+/****************************************************************************
+random number in [0,n).
+****************************************************************************/
+static int randomBelow( int n )
+{
+  return (int) ( ( random64() >> 11 ) % (unsigned long long) n );
+}
+
+/****************************************************************************
+initialize zipf to n values with exponent s.
+****************************************************************************/
+static void zipfInit( Zipf *zipf, int n, double s )
+{
+  int i;
+  double sum = 0;
+  zipf->n = n;
+  zipf->cdf = malloc( n * sizeof( double ) );
+  if ( !zipf->cdf )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    exit( 1 );
+  }
+  for ( i = 0; i < n; i++ )
+  {
+    sum += 1.0 / pow( i + 1, s );
+    zipf->cdf[i] = sum;
+  }
+  for ( i = 0; i < n; i++ )
+    zipf->cdf[i] /= sum;
+}
+
+/****************************************************************************
+sample zipf, 0 being the most frequent value.
+****************************************************************************/
+static int zipfNext( Zipf *zipf )
+{
+  double u = ( random64() >> 11 ) * ( 1.0 / 9007199254740992.0 );
+  int lo = 0, hi = zipf->n - 1;
+  while ( lo < hi )
+  {
+    int mid = ( lo + hi ) / 2;
+    if ( zipf->cdf[mid] < u ) lo = mid + 1; else hi = mid;
+  }
+  return lo;
+}
+
+/****************************************************************************
+the name of database i: the lower numbers are production databases.
+****************************************************************************/
+static void databaseName( char *name, int i )
+{
+  static const char *prefixes[] = { "PROD", "ACPT", "TEST", "DEV" };
+  snprintf( name, W_DATABASE, "%s%04d", prefixes[i % 4], i / 4 + 1 );
+}
+
+/****************************************************************************
+the name of schema i: common application schemas first, then numbered ones.
+****************************************************************************/
+static void schemaName( char *name, int i )
+{
+  static const char *common[] = { "app", "batch", "report", "etl", "api",
+    "monitor", "backup", "audit", "web", "reader", "owner", "sync", "dwh",
+    "hr", "finance", "sales", "crm", "billing", "queue", "archive" };
+  int n = sizeof( common ) / sizeof( common[0] );
+  if ( i < n ) snprintf( name, W_SCHEMANAME, "%s", common[i] );
+    else snprintf( name, W_SCHEMANAME, "app%05d", i - n + 1 );
+}
+
+/****************************************************************************
+the name of os user i, 0 being owner.
+****************************************************************************/
+static void osuserName( char *name, int i, const char *owner )
+{
+  if ( i == 0 ) snprintf( name, W_OSUSERNAME, "%s", owner );
+    else snprintf( name, W_OSUSERNAME, "user%05d", i );
+}
+
+/****************************************************************************
+the password of entry, derived from its database and schema, so all grants
+of a credential hold the same password.
+****************************************************************************/
+static void password( Entry *entry, unsigned long long seed )
+{
+  static const char chars[] = "abcdefghijklmnopqrstuvwxyz"
+                              "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_#$";
+  unsigned long long saved = state, h = 14695981039346656037ULL ^ seed;
+  const char *p;
+  int l, i;
+  for ( p = entry->database; *p; p++ )
+    h = ( h ^ (unsigned char) *p ) * 1099511628211ULL;
+  h = ( h ^ '/' ) * 1099511628211ULL;
+  for ( p = entry->schemaname; *p; p++ )
+    h = ( h ^ (unsigned char) *p ) * 1099511628211ULL;
+  state = h ? h : 1;
+  l = 8 + randomBelow( 13 );
+  for ( i = 0; i < l; i++ )
+    entry->password[i] = chars[randomBelow( sizeof( chars ) - 1 )];
+  state = saved;
+}
+
+/****************************************************************************
+as compareEntries in oprrepos.c.
+****************************************************************************/
+static int compareEntries( const void *p1, const void *p2 )
+{
+  const Entry *e1 = p1, *e2 = p2;
+  int result = strncmp( e1->database, e2->database, W_DATABASE );
+  if ( !result )
+  {
+    result = strncmp( e1->schemaname, e2->schemaname, W_SCHEMANAME );
+    if ( !result )
+      result = strncmp( e1->osusername, e2->osusername, W_OSUSERNAME );
+  }
+  return result;
+}
+
+/****************************************************************************
+as cryptPassword in oprrepos.c.
+****************************************************************************/
+static void cryptEntry( Entry *entry )
+{
+  int seed = 0, i;
+  for ( i = 0; i < W_DATABASE; i++ )
+    seed += entry->database[i];
+  for ( i = 0; i < W_SCHEMANAME; i++ )
+    seed += entry->schemaname[i];
+  for ( i = 0; i < W_OSUSERNAME; i++ )
+    seed += entry->osusername[i];
+  srand( seed );
+  for ( i = 0; i < W_PASSWORD; i++ )
+    entry->password[i] ^= (char) rand();
+}
+
+/****************************************************************************
+write number as a W_INTBUF string, as writeHeader in oprrepos.c.
+****************************************************************************/
+static void writeNumber( FILE *file, long number )
+{
+  char buf[W_INTBUF];
+  memset( buf, 0, sizeof( buf ) );
+  snprintf( buf, sizeof( buf ), "%ld", number );
+  fwrite( buf, sizeof( buf ), 1, file );
+}
+
+/****************************************************************************
+drop filename from the page cache. dirty pages are written first, as they
+cannot be dropped.
+****************************************************************************/
+static int evict( const char *filename )
+{
+  int fd = open( filename, O_RDONLY );
+  if ( fd == -1 )
+  {
+    perror( filename );
+    return 1;
+  }
+  fdatasync( fd );
+  if ( posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED ) != 0 )
+  {
+    fprintf( stderr, "unable to drop %s from the page cache.\n", filename );
+    close( fd );
+    return 1;
+  }
+  close( fd );
+  return 0;
+}
+
+static void usage( void )
+{
+  fprintf( stderr,
+    "usage: oprgen [-n entries] [-d databases] [-s schemas] [-u osusers]\n"
+    "              [-S seed] [-o owner] [-k keyfile] [-x] <file>\n"
+    "       oprgen -E <file>\n" );
+  exit( 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+  long n = 1000, count, i, keys;
+  int databases = 0, schemas = 0, osusers = 0, exportformat = 0, c;
+  unsigned long long seed = 1;
+  const char *owner = NULL, *keyfile = NULL, *filename;
+  struct passwd *pw;
+  Zipf zdatabases, zschemas, zosusers;
+  Entry *entries;
+  FILE *file;
+
+  while ( ( c = getopt( argc, argv, "n:d:s:u:S:o:k:xE:" ) ) != -1 )
+  {
+    switch ( c )
+    {
+      case 'n': n = atol( optarg ); break;
+      case 'd': databases = atoi( optarg ); break;
+      case 's': schemas = atoi( optarg ); break;
+      case 'u': osusers = atoi( optarg ); break;
+      case 'S': seed = strtoull( optarg, NULL, 10 ); break;
+      case 'o': owner = optarg; break;
+      case 'k': keyfile = optarg; break;
+      case 'x': exportformat = 1; break;
+      case 'E': return evict( optarg );
+      default : usage();
+    }
+  }
+  if ( optind != argc - 1 || n < 1 ) usage();
+  filename = argv[optind];
+
+  if ( !owner )
+  {
+    pw = getpwuid( getuid() );
+    if ( !pw )
+    {
+      fprintf( stderr, "unable to determine the calling user.\n" );
+      return 1;
+    }
+    owner = pw->pw_name;
+  }
+  if ( strlen( owner ) > W_OSUSERNAME - 1 )
+  {
+    fprintf( stderr, "owner name too long (max %d chars).\n",
+             W_OSUSERNAME - 1 );
+    return 1;
+  }
+
+  /* by default about 200 grants per database and 50 per os user */
+  if ( databases < 1 ) databases = n / 200 + 1;
+  if ( schemas < 1 ) schemas = 400;
+  if ( osusers < 1 ) osusers = n / 50 + 2;
+  if ( (double) databases * schemas * osusers < 2.0 * n )
+  {
+    fprintf( stderr, "%d databases, %d schemas and %d osusers are too few "
+             "for %ld entries.\n", databases, schemas, osusers, n );
+    return 1;
+  }
+  state = seed * 0x9E3779B97F4A7C15ULL + 1;
+  zipfInit( &zdatabases, databases, 0.8 );
+  zipfInit( &zschemas, schemas, 1.1 );
+  zipfInit( &zosusers, osusers, 1.0 );
+
+  entries = calloc( n, sizeof( Entry ) );
+  if ( !entries )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    return 1;
+  }
+
+  /* draw the missing entries, then sort and drop duplicates, until there
+     are n distinct ones */
+  count = 0;
+  while ( count < n )
+  {
+    long j;
+    for ( i = count; i < n; i++ )
+    {
+      Entry *e = entries + i;
+      memset( e, 0, sizeof( Entry ) );
+      databaseName( e->database, zipfNext( &zdatabases ) );
+      schemaName( e->schemaname, zipfNext( &zschemas ) );
+      osuserName( e->osusername, zipfNext( &zosusers ), owner );
+      password( e, seed );
+    }
+    qsort( entries, n, sizeof( Entry ), compareEntries );
+    for ( i = 1, j = 1; i < n; i++ )
+      if ( compareEntries( entries + i, entries + j - 1 ) != 0 )
+        entries[j++] = entries[i];
+    count = j;
+  }
+
+  if ( keyfile )
+  {
+    long *owned = malloc( n * sizeof( long ) );
+    if ( !owned || !( file = fopen( keyfile, "w" ) ) )
+    {
+      fprintf( stderr, "unable to open %s for writing.\n", keyfile );
+      return 1;
+    }
+    for ( i = 0, keys = 0; i < n; i++ )
+      if ( strncmp( entries[i].osusername, owner, W_OSUSERNAME ) == 0 )
+        owned[keys++] = i;
+    for ( i = keys - 1; i > 0; i-- )
+    {
+      long k = randomBelow( i + 1 ), t = owned[i];
+      owned[i] = owned[k];
+      owned[k] = t;
+    }
+    for ( i = 0; i < keys; i++ )
+      fprintf( file, "%s %s\n", entries[owned[i]].database,
+               entries[owned[i]].schemaname );
+    free( owned );
+    if ( fclose( file ) != 0 )
+    {
+      fprintf( stderr, "write failure in %s.\n", keyfile );
+      return 1;
+    }
+  }
+
+  file = fopen( filename, "wb" );
+  if ( !file )
+  {
+    fprintf( stderr, "unable to open %s for writing.\n", filename );
+    return 1;
+  }
+  if ( !exportformat )
+  {
+    char buf[W_LOGFILE];
+    memset( buf, 0, sizeof( buf ) );
+    strncpy( buf, MAGIC, W_MAGIC );
+    fwrite( buf, W_MAGIC, 1, file );
+    memset( buf, 0, sizeof( buf ) );
+    strncpy( buf, owner, W_OSUSERNAME );
+    fwrite( buf, W_OSUSERNAME, 1, file );
+    memset( buf, 0, sizeof( buf ) );
+    fwrite( buf, W_LOGFILE, 1, file );
+    writeNumber( file, n );
+    writeNumber( file, 1 );
+    writeNumber( file, LOG_ALL );
+    writeNumber( file, LOG_INTERVAL );
+  }
+  for ( i = 0; i < n; i++ )
+  {
+    cryptEntry( entries + i );
+    fwrite( entries + i, sizeof( Entry ), 1, file );
+  }
+  if ( fclose( file ) != 0 )
+  {
+    fprintf( stderr, "write failure in %s.\n", filename );
+    return 1;
+  }
+  free( entries );
+  return 0;
+}
@@ -0,0 +1,495 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+/****************************************************************************
+oprstress - run readers and writers of one repository concurrently, each a
+process running opr in a loop, for a fixed time, and report the latency of
+every operation and every result that was not the expected one.
+
+  oprstress [-r readers] [-w writers] [-t seconds] [-k keys] [-m]
+            <opr> <fake oracle home>
+
+the repository is created in a temporary directory with keys entries of
+known password. readers read them with opr -r and compare the password.
+writers add an entry of their own with opr -a -f, read it back, and delete
+it again, and with -m also change the password of an entry of their own
+with opr -m, against the fake client library (see fakeoci.c). no database
+is needed. a final pass reads every key once more.
+
+results are counted as
+  ok       the expected result
+  wrong    another password than the one expected
+  empty    no password, but no error either
+  denied   the entry was not found: it was lost, or the repository was read
+           while it was being written
+  corrupt  the repository could not be parsed
+  timeout  the lock could not be obtained
+  error    any other failure, the first message is shown
+oprstress exits with 1 if any result was not ok.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pwd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#define W_OUTPUT 4096
+#define W_MESSAGE 128
+#define BUCKETS 128
+
+enum { O_READ, O_ADD, O_VERIFY, O_DELETE, O_MODIFY, O_FINAL, OPERATIONS };
+enum { OUT_OK, OUT_WRONG, OUT_EMPTY, OUT_DENIED, OUT_CORRUPT, OUT_TIMEOUT,
+       OUT_ERROR, RESULTS };
+
+static const char *operations[] = { "read", "add -f", "read back", "delete",
+  "modify", "final read" };
+static const char *results[] = { "ok", "wrong", "empty", "denied", "corrupt",
+  "timeout", "error" };
+
+/* the counts of one operation. the latencies are counted in quarter octave
+   buckets, see bucket */
+typedef struct
+{
+  unsigned long      results[RESULTS];
+  unsigned long      buckets[BUCKETS];
+  unsigned long long total;
+  unsigned long long max;
+  char               message[RESULTS][W_MESSAGE];
+} Stats;
+
+static const char *opr;
+static char        osuser[64];
+
+/****************************************************************************
+microseconds of the monotonic clock.
+****************************************************************************/
+static unsigned long long now( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/****************************************************************************
+read fd to its end into buf of size bytes, dropping what does not fit.
+****************************************************************************/
+static void readAll( int fd, char *buf, size_t size )
+{
+  size_t n = 0;
+  ssize_t r;
+  char skip[512];
+  for ( ;; )
+  {
+    if ( n < size - 1 ) r = read( fd, buf + n, size - 1 - n );
+      else r = read( fd, skip, sizeof( skip ) );
+    if ( r < 0 && errno == EINTR ) continue;
+    if ( r <= 0 ) break;
+    if ( n < size - 1 ) n += r;
+  }
+  buf[n] = 0;
+  close( fd );
+}
+
+/****************************************************************************
+run opr with args, input on its stdin. its stdout and stderr are returned
+in out and err, the exit status is returned, -1 if opr could not be run.
+****************************************************************************/
+static int run( char *const args[], const char *input, char *out, char *err )
+{
+  int in[2], o[2], e[2], status;
+  pid_t pid;
+  if ( pipe( in ) || pipe( o ) || pipe( e ) ) return -1;
+  pid = fork();
+  if ( pid == -1 ) return -1;
+  if ( pid == 0 )
+  {
+    dup2( in[0], 0 );
+    dup2( o[1], 1 );
+    dup2( e[1], 2 );
+    close( in[0] ); close( in[1] );
+    close( o[0] ); close( o[1] );
+    close( e[0] ); close( e[1] );
+    execv( opr, args );
+    fprintf( stderr, "unable to run %s: %s\n", opr, strerror( errno ) );
+    _exit( 127 );
+  }
+  close( in[0] ); close( o[1] ); close( e[1] );
+  if ( input && write( in[1], input, strlen( input ) ) < 0 )
+    fprintf( stderr, "unable to write to opr: %s\n", strerror( errno ) );
+  close( in[1] );
+  readAll( o[0], out, W_OUTPUT );
+  readAll( e[0], err, W_OUTPUT );
+  while ( waitpid( pid, &status, 0 ) == -1 )
+    if ( errno != EINTR ) return -1;
+  return WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+}
+
+/****************************************************************************
+the bucket of a latency of us microseconds: below 4 us the value itself,
+above it 4 buckets per power of 2.
+****************************************************************************/
+static int bucket( unsigned long long us )
+{
+  int k = 2, b;
+  if ( us < 4 ) return (int) us;
+  while ( us >> ( k + 1 ) ) k++;
+  b = 4 + ( k - 2 ) * 4 + (int) ( ( us >> ( k - 2 ) ) & 3 );
+  return b < BUCKETS ? b : BUCKETS - 1;
+}
+
+/****************************************************************************
+the upper bound of bucket b, in microseconds.
+****************************************************************************/
+static unsigned long long bucketBound( int b )
+{
+  int k = ( b - 4 ) / 4 + 2;
+  if ( b < 4 ) return b + 1;
+  return ( 1ULL << k ) + ( (unsigned long long) ( ( b - 4 ) % 4 + 1 ) << ( k - 2 ) );
+}
+
+/****************************************************************************
+classify the outcome of an opr run. expected is the password opr -r should
+print, NULL for the other commands.
+****************************************************************************/
+static int classify( int status, const char *out, const char *err,
+                     const char *expected )
+{
+  if ( status == 0 )
+  {
+    if ( !expected ) return OUT_OK;
+    if ( !*out ) return OUT_EMPTY;
+    return strcmp( out, expected ) == 0 ? OUT_OK : OUT_WRONG;
+  }
+  if ( strstr( err, "locking" ) ) return OUT_TIMEOUT;
+  if ( strstr( err, "sorry" ) || strstr( err, "does not exist" ) )
+    return OUT_DENIED;
+  if ( strstr( err, "read failure" ) || strstr( err, "not a valid" ) ||
+       strstr( err, "max " ) )
+    return OUT_CORRUPT;
+  return OUT_ERROR;
+}
+
+/****************************************************************************
+run opr with args and count the result and latency in stats. returns the
+result.
+****************************************************************************/
+static int measure( Stats *stats, char *const args[], const char *input,
+                    const char *expected )
+{
+  char out[W_OUTPUT], err[W_OUTPUT];
+  unsigned long long start = now(), us;
+  int status, result;
+  status = run( args, input, out, err );
+  us = now() - start;
+  result = classify( status, out, err, expected );
+  stats->buckets[bucket( us )]++;
+  stats->results[result]++;
+  stats->total += us;
+  if ( us > stats->max ) stats->max = us;
+  if ( result != OUT_OK && !stats->message[result][0] )
+  {
+    const char *m = *err ? err : out;
+    size_t l = strcspn( m, "\n" );
+    if ( l > W_MESSAGE - 1 ) l = W_MESSAGE - 1;
+    memcpy( stats->message[result], m, l );
+    stats->message[result][l] = 0;
+  }
+  return result;
+}
+
+/****************************************************************************
+reader: read random keys until deadline.
+****************************************************************************/
+static void reader( Stats *stats, int keys, unsigned long long deadline,
+                    unsigned int seed )
+{
+  char schema[32], expected[32];
+  char *args[] = { "opr", "-r", "STRESS", schema, NULL };
+  while ( now() < deadline )
+  {
+    int k = rand_r( &seed ) % keys;
+    snprintf( schema, sizeof( schema ), "r%d", k );
+    snprintf( expected, sizeof( expected ), "p%d", k );
+    measure( stats + O_READ, args, NULL, expected );
+  }
+}
+
+/****************************************************************************
+writer w: add, read back and delete entries of its own until deadline, and
+with modify, change the password of STRESSM<w> m.
+****************************************************************************/
+static void writer( Stats *stats, int w, int modify,
+                    unsigned long long deadline )
+{
+  char database[32], schema[32], password[32], input[80];
+  char *add[] = { "opr", "-a", "-f", "STRESSW", schema, osuser, NULL };
+  char *verify[] = { "opr", "-r", "STRESSW", schema, NULL };
+  char *delete[] = { "opr", "-d", "STRESSW", schema, osuser, NULL };
+  char *change[] = { "opr", "-m", database, "m", NULL };
+  int i;
+  snprintf( database, sizeof( database ), "STRESSM%d", w );
+  for ( i = 0; now() < deadline; i++ )
+  {
+    snprintf( schema, sizeof( schema ), "w%dx%d", w, i );
+    snprintf( password, sizeof( password ), "a%dx%d", w, i );
+    snprintf( input, sizeof( input ), "%s\n%s\n", password, password );
+    if ( measure( stats + O_ADD, add, input, NULL ) == OUT_OK )
+    {
+      measure( stats + O_VERIFY, verify, NULL, password );
+      measure( stats + O_DELETE, delete, NULL, NULL );
+    }
+    if ( modify )
+    {
+      snprintf( password, sizeof( password ), "m%dx%d", w, i );
+      snprintf( input, sizeof( input ), "%s\n%s\n", password, password );
+      measure( stats + O_MODIFY, change, input, NULL );
+    }
+  }
+}
+
+/****************************************************************************
+the latency below which fraction of the runs counted in stats finished, at
+most the maximum.
+****************************************************************************/
+static unsigned long long percentile( Stats *stats, unsigned long n,
+                                      double fraction )
+{
+  unsigned long seen = 0;
+  int b;
+  for ( b = 0; b < BUCKETS; b++ )
+  {
+    seen += stats->buckets[b];
+    if ( seen && seen >= fraction * n ) break;
+  }
+  if ( b == BUCKETS || bucketBound( b ) > stats->max ) return stats->max;
+  return bucketBound( b );
+}
+
+/****************************************************************************
+add the counts of from to to.
+****************************************************************************/
+static void addStats( Stats *to, Stats *from )
+{
+  int i;
+  for ( i = 0; i < RESULTS; i++ )
+  {
+    to->results[i] += from->results[i];
+    if ( !to->message[i][0] ) strcpy( to->message[i], from->message[i] );
+  }
+  for ( i = 0; i < BUCKETS; i++ )
+    to->buckets[i] += from->buckets[i];
+  to->total += from->total;
+  if ( from->max > to->max ) to->max = from->max;
+}
+
+static void usage( void )
+{
+  fprintf( stderr, "usage: oprstress [-r readers] [-w writers] [-t seconds] "
+                   "[-k keys] [-m] <opr> <fake oracle home>\n" );
+  exit( 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+  int readers = 20, writers = 2, seconds = 10, keys = 100, modify = 0;
+  int c, i, o, failed = 0;
+  char work[256], path[300], database[32], schema[32], input[80], out[W_OUTPUT], err[W_OUTPUT];
+  char *create[] = { "opr", "-c", NULL };
+  char *add[] = { "opr", "-a", "-f", "STRESS", schema, osuser, NULL };
+  char *final[] = { "opr", "-r", "STRESS", schema, NULL };
+  const char *tmpdir = getenv( "TMPDIR" );
+  unsigned long long deadline, started;
+  struct passwd *pw;
+  Stats *stats, total[OPERATIONS];
+  pid_t *pids;
+  FILE *users;
+
+  while ( ( c = getopt( argc, argv, "r:w:t:k:m" ) ) != -1 )
+  {
+    switch ( c )
+    {
+      case 'r': readers = atoi( optarg ); break;
+      case 'w': writers = atoi( optarg ); break;
+      case 't': seconds = atoi( optarg ); break;
+      case 'k': keys = atoi( optarg ); break;
+      case 'm': modify = 1; break;
+      default : usage();
+    }
+  }
+  if ( optind != argc - 2 || readers < 0 || writers < 0 ||
+       readers + writers < 1 || seconds < 1 || keys < 1 )
+    usage();
+  opr = argv[optind];
+  if ( access( opr, X_OK ) != 0 )
+  {
+    fprintf( stderr, "%s is not executable.\n", opr );
+    return 1;
+  }
+  pw = getpwuid( getuid() );
+  if ( !pw )
+  {
+    fprintf( stderr, "unable to determine the calling user.\n" );
+    return 1;
+  }
+  snprintf( osuser, sizeof( osuser ), "%s", pw->pw_name );
+
+  snprintf( work, sizeof( work ), "%s/oprstress.XXXXXX",
+            tmpdir && *tmpdir ? tmpdir : "/tmp" );
+  if ( !mkdtemp( work ) )
+  {
+    perror( work );
+    return 1;
+  }
+  setenv( "ORACLE_HOME", argv[optind + 1], 1 );
+  snprintf( path, sizeof( path ), "%s/users", work );
+  setenv( "FAKEOCI_USERS", path, 1 );
+  users = fopen( path, "w" );
+  if ( !users )
+  {
+    perror( path );
+    return 1;
+  }
+  for ( i = 0; i < writers; i++ )
+    fprintf( users, "STRESSM%d m m%d\n", i, i );
+  fclose( users );
+  snprintf( path, sizeof( path ), "%s/stress.opr", work );
+  setenv( "OPRREPOS", path, 1 );
+  unsetenv( "OPR_TRACE" );
+
+  /* the repository, with the keys of the readers and an entry to modify
+     per writer */
+  if ( run( create, NULL, out, err ) != 0 )
+  {
+    fprintf( stderr, "opr -c failed: %s", err );
+    return 1;
+  }
+  for ( i = 0; i < keys; i++ )
+  {
+    snprintf( schema, sizeof( schema ), "r%d", i );
+    snprintf( input, sizeof( input ), "p%d\np%d\n", i, i );
+    if ( run( add, input, out, err ) != 0 )
+    {
+      fprintf( stderr, "opr -a -f failed: %s", err );
+      return 1;
+    }
+  }
+  for ( i = 0; modify && i < writers; i++ )
+  {
+    char *m[] = { "opr", "-a", "-f", database, "m", osuser, NULL };
+    snprintf( database, sizeof( database ), "STRESSM%d", i );
+    snprintf( input, sizeof( input ), "m%d\nm%d\n", i, i );
+    if ( run( m, input, out, err ) != 0 )
+    {
+      fprintf( stderr, "opr -a -f failed: %s", err );
+      return 1;
+    }
+  }
+
+  stats = mmap( NULL, ( readers + writers ) * OPERATIONS * sizeof( Stats ),
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+  pids = calloc( readers + writers, sizeof( pid_t ) );
+  if ( stats == MAP_FAILED || !pids )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    return 1;
+  }
+  memset( stats, 0, ( readers + writers ) * OPERATIONS * sizeof( Stats ) );
+
+  started = now();
+  deadline = started + seconds * 1000000ULL;
+  for ( i = 0; i < readers + writers; i++ )
+  {
+    pids[i] = fork();
+    if ( pids[i] == -1 )
+    {
+      perror( "fork" );
+      deadline = 0;
+      break;
+    }
+    if ( pids[i] == 0 )
+    {
+      if ( i < readers )
+        reader( stats + i * OPERATIONS, keys, deadline, i * 7919 + 1 );
+      else
+        writer( stats + i * OPERATIONS, i - readers, modify, deadline );
+      _exit( 0 );
+    }
+  }
+  for ( i = 0; i < readers + writers; i++ )
+    if ( pids[i] > 0 ) waitpid( pids[i], NULL, 0 );
+  started = now() - started;
+
+  memset( total, 0, sizeof( total ) );
+  for ( i = 0; i < readers + writers; i++ )
+    for ( o = 0; o < OPERATIONS; o++ )
+      addStats( total + o, stats + i * OPERATIONS + o );
+
+  /* every key must still read back */
+  for ( i = 0; i < keys; i++ )
+  {
+    char expected[32];
+    snprintf( schema, sizeof( schema ), "r%d", i );
+    snprintf( expected, sizeof( expected ), "p%d", i );
+    measure( total + O_FINAL, final, NULL, expected );
+  }
+
+  printf( "%d readers, %d writers, %d keys, %.1f seconds\n",
+          readers, writers, keys, started / 1000000.0 );
+  printf( "%-12s %8s %9s %9s %9s %9s", "operation", "runs", "ops/s",
+          "p50_us", "p99_us", "max_us" );
+  for ( i = 1; i < RESULTS; i++ ) printf( " %7s", results[i] );
+  printf( "\n" );
+  for ( o = 0; o < OPERATIONS; o++ )
+  {
+    unsigned long n = 0;
+    for ( i = 0; i < RESULTS; i++ ) n += total[o].results[i];
+    if ( !n ) continue;
+    printf( "%-12s %8lu %9.1f %9llu %9llu %9llu", operations[o], n,
+            o == O_FINAL ? 0 : n * 1000000.0 / started,
+            percentile( total + o, n, 0.50 ),
+            percentile( total + o, n, 0.99 ), total[o].max );
+    for ( i = 1; i < RESULTS; i++ )
+    {
+      printf( " %7lu", total[o].results[i] );
+      failed += total[o].results[i] != 0;
+    }
+    printf( "\n" );
+  }
+  for ( o = 0; o < OPERATIONS; o++ )
+    for ( i = 1; i < RESULTS; i++ )
+      if ( total[o].results[i] )
+        printf( "%s %s: %s\n", operations[o], results[i],
+                total[o].message[i] );
+
+  snprintf( path, sizeof( path ), "rm -rf '%s'", work );
+  if ( system( path ) != 0 ) fprintf( stderr, "unable to remove %s.\n", work );
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+#! /bin/sh
+#
+# reposbench.sh - measure the repository costs of opr: loading, lookups,
+#                 single adds and deletes, import and list, on synthetic
+#                 repositories generated by oprgen.
+#
+# usage: reposbench.sh [options] <opr> <oprgen> <fake oracle home>
+#
+#   -n <sizes>  repository sizes in entries (default "1000 10000 100000")
+#   -r <n>      lookups per size and cache state (default 200)
+#   -w <n>      adds and deletes per size (default 20)
+#   -i <n>      entries imported into an empty repository (default 1000)
+#   -l <n>      lists per size (default 3)
+#   -S <n>      seed of the generated repositories (default 1)
+#
+# timings are taken from the trace opr writes with OPR_TRACE set, so they
+# exclude starting the process. every measurement is printed as one line of
+# JSON, for example
+#
+#   {"bench":"lookup","entries":10000,"cache":"cold","runs":200,"p50_us":310,"p99_us":702}
+#
+# load is the open, lock and parse phases of the lookups, cold runs drop the
+# repository from the page cache before every lookup. opr must be built with
+# MAX_ENTRIES at least the largest size.
+
+sizes="1000 10000 100000"
+lookups=200
+writes=20
+imports=1000
+lists=3
+seed=1
+
+usage()
+{
+  echo "usage: $0 [-n sizes] [-r n] [-w n] [-i n] [-l n] [-S n] <opr> <oprgen> <fake oracle home>" >&2
+  exit 1
+}
+
+while getopts "n:r:w:i:l:S:" opt
+do
+  case $opt in
+    n) sizes=$OPTARG ;;
+    r) lookups=$OPTARG ;;
+    w) writes=$OPTARG ;;
+    i) imports=$OPTARG ;;
+    l) lists=$OPTARG ;;
+    S) seed=$OPTARG ;;
+    *) usage ;;
+  esac
+done
+shift `expr $OPTIND - 1`
+test $# -eq 3 || usage
+
+opr=$1
+oprgen=$2
+home=$3
+if [ ! -x "$opr" ] || [ ! -x "$oprgen" ] || [ ! -f "$home/lib/libclntsh.so" ]; then
+  echo "$0: $opr or $oprgen is not executable or $home/lib/libclntsh.so is missing." >&2
+  exit 1
+fi
+
+work=`mktemp -d "${TMPDIR:-/tmp}/reposbench.XXXXXX"` || exit 1
+trap 'rm -rf "$work"' 0 1 2 15
+
+ORACLE_HOME=$home
+FAKEOCI_USERS=$work/users
+OPR_TRACE=$work/trace
+export ORACLE_HOME FAKEOCI_USERS OPR_TRACE
+: > "$FAKEOCI_USERS"
+
+osuser=`id -un`
+
+# the value of phase in every line of the trace, phases summed with +
+values()
+{
+  awk -v phases="$1" '{
+    n = split( phases, p, "+" ); v = 0
+    for ( i = 4; i <= NF; i++ )
+    {
+      split( $i, f, "=" ); sub( "/.*", "", f[2] )
+      for ( j = 1; j <= n; j++ ) if ( f[1] == p[j] ) v += f[2]
+    }
+    print v
+  }' "$OPR_TRACE"
+}
+
+# percentiles <name> <entries> <cache> <phases>
+percentiles()
+{
+  values "$4" | sort -n | awk -v name="$1" -v entries="$2" -v cache="$3" '
+    { v[NR] = $1 }
+    END {
+      p50 = int( NR * 0.50 ); if ( p50 < NR * 0.50 ) p50++
+      p99 = int( NR * 0.99 ); if ( p99 < NR * 0.99 ) p99++
+      printf "{\"bench\":\"%s\",\"entries\":%d,\"cache\":\"%s\",\"runs\":%d,\"p50_us\":%d,\"p99_us\":%d}\n",
+             name, entries, cache, NR, v[p50], v[p99]
+    }'
+}
+
+# throughput <name> <entries> <operations per run>, the median run
+throughput()
+{
+  values total_us | sort -n | awk -v name="$1" -v entries="$2" -v ops="$3" '
+    { v[NR] = $1 }
+    END {
+      m = v[int( ( NR + 1 ) / 2 )]
+      printf "{\"bench\":\"%s\",\"entries\":%d,\"runs\":%d,\"median_us\":%d,\"per_s\":%.1f}\n",
+             name, entries, NR, m, ( m > 0 ? ops * 1000000 / m : 0 )
+    }'
+}
+
+for n in $sizes
+do
+  OPRREPOS=$work/bench$n.opr
+  export OPRREPOS
+  "$oprgen" -n $n -S $seed -o "$osuser" -k $work/keys "$OPRREPOS" || exit 1
+  if [ ! -s $work/keys ]; then
+    echo "$0: no entries of $osuser in $OPRREPOS." >&2
+    exit 1
+  fi
+  "$opr" -r `head -1 $work/keys` > /dev/null || exit 1
+
+  for cache in warm cold
+  do
+    rm -f "$OPR_TRACE"
+    awk -v r=$lookups '{ k[NR] = $0 } END { for ( i = 0; i < r; i++ ) print k[i % NR + 1] }' \
+      $work/keys > $work/lookups
+    while read database schema
+    do
+      test $cache = cold && "$oprgen" -E "$OPRREPOS"
+      "$opr" -r $database $schema > /dev/null || exit 1
+    done < $work/lookups
+    percentiles lookup $n $cache total_us
+    percentiles load $n $cache open+lock+parse
+    percentiles find $n $cache find
+  done
+
+  rm -f "$OPR_TRACE"
+  i=1
+  while [ $i -le $writes ]
+  do
+    printf "bench$i\nbench$i\n" | "$opr" -a -f BENCHNEW bench$i "$osuser" > /dev/null || exit 1
+    i=`expr $i + 1`
+  done
+  percentiles add $n warm total_us
+
+  rm -f "$OPR_TRACE"
+  i=1
+  while [ $i -le $writes ]
+  do
+    "$opr" -d BENCHNEW bench$i "$osuser" > /dev/null || exit 1
+    i=`expr $i + 1`
+  done
+  percentiles delete $n warm total_us
+
+  rm -f "$OPR_TRACE"
+  i=1
+  while [ $i -le $lists ]
+  do
+    "$opr" -l > /dev/null || exit 1
+    i=`expr $i + 1`
+  done
+  throughput list $n $n
+  rm -f "$OPRREPOS" "$OPRREPOS".*
+done
+
+# import into an empty repository, from an export generated with another
+# seed
+OPRREPOS=$work/import.opr
+export OPRREPOS
+"$oprgen" -x -n $imports -S `expr $seed + 1` -o "$osuser" $work/import.exp || exit 1
+"$opr" -c > /dev/null || exit 1
+rm -f "$OPR_TRACE"
+"$opr" -i $work/import.exp > /dev/null || exit 1
+throughput import $imports $imports
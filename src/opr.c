@@ -30,99 +30,148 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
+#include <fnmatch.h>
+#include <time.h>
+#include <unistd.h>
 #ifdef HAVE_CONFIG_H
   #include "config.h"
 #endif
 #include "oprora.h"
+#include "oprrepos.h"
+#include "oprhash.h"
+#include "oprlog.h"
+#include "oprmap.h"
+#include "oprmetrics.h"
+#include "oprlock.h"
+#include "oprtrace.h"
+#include "oprprobes.h"
+#include "oprworker.h"
 #include "oprdefs.h"
 
 /*
  * START CONFIGURABLE SECTION
  */
  
-/* maximum number of entries allowed in the password repository */
-#define MAX_ENTRIES 4096
-
 char* MSG_SECURITY="sorry :("; 
 
+/* names of the LOG values, as given to --log-level */
+char* LOG_LEVELS[] = { "errors", "changes", "all", "summary" };
+
 /* name of the environment variable */
 #define OPRREPOS "OPRREPOS"
 
+/* default number of concurrent database checks during a crosscheck */
+#define CHECK_THREADS 4
+
+/* length of the passwords generated by a rotation */
+#define ROTATE_LENGTH 20
+
+/* crosscheck and listing output formats, tsv is for listings only */
+#define FORMAT_TEXT 0
+#define FORMAT_JSON 1
+#define FORMAT_CSV  2
+#define FORMAT_TSV  3
+
+/* size of the stdout buffer of a listing */
+#define LIST_BUFFER 65536
+
 /*
  * END CONFIGURABLE SECTION
  */
  
-/* MAGIC is used to do a (simple) check on the repository file */
-#define MAGIC "OraclePasswordRepository 1.1.0 "
-#define W_MAGIC  32
-
-/* maximum length of the pathname to the repository file (Practical value) */
-#define W_REPOSNAME 256
-
-/* maximum length of the pathname to the log file (Practical Value) */
-#define W_LOGFILE 256 
-
 /* length of a datime entry in the logfile (see man ctime)*/
 #define W_DATETIME 26
 
-/* maximum length of a database name (TNS Name length max hard to find in the
-   Oracle manuals, so a pratical value is chosen. You can increase if needed */
-#define W_DATABASE 64
+/* suffix of the crosscheck result cache, kept next to the repository */
+#define CHECKCACHE_SUFFIX ".xcache"
 
-/* maximum length of a schemaname (Oracle defined max) */
-#define W_SCHEMANAME 30
+/* suffix of the read counters of LOG_SUMMARY, kept next to the repository */
+#define READS_SUFFIX ".reads"
 
-/* maximum length of a password (Oracle defined max) */
-#define W_PASSWORD 30 
+/* suffix of the shared metrics counters, kept next to the repository */
+#define METRICS_SUFFIX ".metrics"
 
-/* maximum length of an OSusername (Practical value)*/
-#define W_OSUSERNAME 32
- 
-/* size of int to string conversion buffers */
-#define W_INTBUF 32 
+/* suffix of the last read times and read counts of the entries */
+#define USAGE_SUFFIX ".usage"
 
-/* number of nanoseconds to wait before lock retry */
-#define LOCK_SLEEP 40000000
+/* first line of the crosscheck result cache */
+#define CHECKCACHE_MAGIC "OraclePasswordRepository crosscheck cache 1"
 
-/* number of lock retries before giving up */
-#define LOCK_RETRIES 100
+/* number of seconds between checkpoints of a running crosscheck */
+#define CHECKPOINT_INTERVAL 10
+
+/****************************************************************************
+a crosscheck result cache record, for a (database, schemaname) combination :
+  database    - the name of the database
+  schemaname  - the name of the schema
+  result      - the DBCHECK result of the last check
+  checked     - the time of the last check
+  generation  - the repository generation at the last check
+  fingerprint - hash of the (encrypted) entry at the last check
+****************************************************************************/
+typedef struct {
+  char          database[W_DATABASE];
+  char          schemaname[W_SCHEMANAME];
+  int           result;
+  long          checked;
+  int           generation;
+  unsigned long fingerprint;
+} CheckResult;
 
 /****************************************************************************
-the repository header.
-   magic      - this field is used to validate the file as being a repository.
-   reposowner - holds the osusername of the repository creator.
-   logfile    - name of the logfile. if logging not enabled, empty string.
-   entries    - holds the number of entries in the repository.
+command line options, given as --name=value anywhere after the switch :
+  threads  - number of concurrent database checks during a crosscheck
+  deadline - number of seconds a crosscheck may take, 0 is no limit
+  maxage   - age in seconds of cached crosscheck results that are trusted,
+             -1 is no cache
+  monitor  - schema that reads the password verifiers during a crosscheck,
+             empty is logon checks
+  format   - crosscheck and listing output, one of the FORMAT values
+  resume   - if set, a crosscheck continues an interrupted one
+  loglevel - the LOG value set by +g, -1 keeps the current one
+  loginterval - the summary interval set by +g, -1 keeps the current one
 ****************************************************************************/
 typedef struct {
-  char   magic[W_MAGIC];
-  char   reposowner[W_OSUSERNAME];
-  char   logfile[W_LOGFILE];
-  int    entries;
-} Header;
+  int  threads;
+  int  deadline;
+  int  maxage;
+  char monitor[W_SCHEMANAME];
+  int  format;
+  int  resume;
+  int  loglevel;
+  int  loginterval;
+} Options;
 
 /****************************************************************************
-a repository entry :
-  database   - the name of the database
-  schemaname - the name of the schema
-  osusername - the name of the osuser allowed to read the password
-  password   - the password for schemaname@database
+the cached results of a running crosscheck, shared with its checkpoints :
+  results - room for MAX_ENTRIES results
+  sorted  - the number of results read from the cache, which are sorted
+  count   - the number of results, those after sorted are new
+  started - the time the crosscheck started, or the interrupted one that it
+            resumes
+  fingerprints - the entry fingerprints of the checks that run, stored with
+            their results once they completed
 ****************************************************************************/
 typedef struct {
-  char database[W_DATABASE];
-  char schemaname[W_SCHEMANAME];
-  char osusername[W_OSUSERNAME];
-  char password[W_PASSWORD];
-} Entry;
+  CheckResult   *results;
+  int           sorted;
+  int           count;
+  long          started;
+  unsigned long *fingerprints;
+} CheckRun;
 
 /****************************************************************************
 global variables
 ****************************************************************************/
-char   reposname[W_REPOSNAME];
-char   osusername[W_OSUSERNAME];
-Header header;
-Entry  entries[MAX_ENTRIES];
+char    reposname[W_REPOSNAME];
+char    osusername[W_OSUSERNAME];
+Repos   *repos;
+Options options = { CHECK_THREADS, 0, -1, "", FORMAT_TEXT, 0, -1, -1 };
+CheckRun checkrun;
 static struct termios stored_settings;
+/* the operation of this invocation and the time it started, for metrics */
+char    *operation = "";
+unsigned long long started;
 
 
 /****************************************************************************
@@ -175,95 +224,65 @@ void strtolower( char *s )
 }
 
 /****************************************************************************
-  purpose: terminate in a controlled manner
+  purpose: end opr with status. checks abandoned at the crosscheck deadline
+           may still run in the oracle client library, which is then not
+           unloaded, and exit handlers do not run under them: the audit log
+           and the trace are written here and opr ends with _exit.
   pre    :
 ****************************************************************************/
-void terminate()
+void leave( status )
+int status;
 {
+  if ( oraAbandoned() )
+  {
+    auditFlush();
+    traceEnd();
+    fflush( NULL );
+    _exit( status );
+  }
   unloadOraLibs();
-  exit( 1 );
+  exit( status );
 }
 
 /****************************************************************************
-  purpose: encrypt the entry. only the password is encrypted. calling crypt
-           on an encrypted entry decrypts the entry. Note that encryption is
-           too strong a word for the algorithm :), the entry is just made
-           unreadable for the prowling eye. Do not rely on the encryption for
-           your password's safety, rely on the UNIX access rights on the
-           repository file.
-  pre    : 
+  purpose: terminate in a controlled manner
+  pre    :
 ****************************************************************************/
-void cryptEntry( entry )
-Entry *entry;
+void terminate()
 {
-  int seed, r, c, i;
-  seed = 0;
-  for ( i = 0; i < W_DATABASE; i++ )
-    seed += entry->database[i];
-  for ( i = 0; i < W_SCHEMANAME; i++ )
-    seed += entry->schemaname[i];
-  for ( i = 0; i < W_OSUSERNAME; i++ )
-    seed += entry->osusername[i];
-  srand( seed );
-  for ( i = 0; i < W_PASSWORD; i++ )
-  {
-    r = rand();
-    c = (char) r;
-    entry->password[i] = entry->password[i] ^ c;
-  }
-  return;
+  countOperation( operation, 1 );
+  leave( 1 );
 }
 
 /****************************************************************************
-  purpose: write a message to the log
+  purpose: write a message to the log. with LOG_ERRORS, only if error is
+           not 0.
   pre    : readRepos 
 ****************************************************************************/
 void logLine ( error, message )
 int  error;
 char *message;
 {
-  if ( strlen( header.logfile ) > 0 )
+  if ( strlen( reposLogfile( repos ) ) > 0 &&
+       ( error || reposLogLevel( repos ) != LOG_ERRORS ) &&
+       !auditRecord( reposLogfile( repos ),
+                     error,
+                     osusername,
+                     NULL,
+                     NULL,
+                     NULL,
+                     message ) )
   {
-    FILE *file = fopen( header.logfile , "a" );
-    if ( file )
-    {
-       int i;
-       time_t now = time( 0 );
-       char buffer[W_DATETIME];
-       ctime_r( &now, buffer, sizeof( buffer )  );       
-       for ( i = 0; i < W_DATETIME; i++ )
-         if ( buffer[i] == '\n' )
-         {
-           buffer[i] = 0;
-           break;
-         }
-       if ( error )
-       {
-         fprintf( file,
-                  "%s [fail] %s : %s\n",
-                  buffer,
-                  osusername,
-                  message);
-       } else
-       {
-         fprintf( file,
-                  "%s [ ok ] %s : %s\n",
-                  buffer,
-                  osusername,
-                  message);
-       }
-       fclose( file );
-    } else
-    {
-      fprintf( stderr, "unable to append to logfile %s.\n", header.logfile );
-      exit(-1);
-    }
-  } 
+    fprintf( stderr, "unable to append to logfile %s.\n",
+             reposLogfile( repos ) );
+    exit(-1);
+  }
 }
 
 /***************************************************************************
   purpose: write a message to the logfile, if a logfile is specified.
-           if error is not 0, the line contains the word 'ERROR'.
+           if error is not 0, the record has status=fail. with LOG_ERRORS,
+           only failures are written.
   pre    : readRepos
 ****************************************************************************/
 void logEntryLine( error,
@@ -277,416 +296,257 @@ char *schemaname;
 char *osuser;
 char *message;
 {
-  if ( strlen( header.logfile ) > 0 )
+  OPR_PROBE5( log__entry, error, database, schemaname, osuser, message );
+  if ( strlen( reposLogfile( repos ) ) > 0 &&
+       ( error || reposLogLevel( repos ) != LOG_ERRORS ) &&
+       !auditRecord( reposLogfile( repos ),
+                     error,
+                     osusername,
+                     osuser,
+                     database,
+                     schemaname,
+                     message ) )
   {
-    FILE *file = fopen(header.logfile,"a");
-    if ( file )
-    {
-       int i;
-       time_t now = time( 0 );
-       char buffer[W_DATETIME];
-       ctime_r( &now, buffer, sizeof( buffer ) );
-       for ( i = 0; i < W_DATETIME; i++ )
-         if ( buffer[i] == '\n' )
-         {
-           buffer[i] = 0;
-           break;
-         }
-       if ( error )
-       {
-         fprintf( file,
-                  "%s [fail] %s : (%s, %s) : %s\n",
-                  buffer,
-                  osuser,
-                  database,
-                  schemaname,
-                  message);
-       } else
-       {
-         fprintf( file,
-                  "%s [ ok ] %s : (%s, %s) : %s\n",
-                  buffer,
-                  osuser,
-                  database,
-                  schemaname,
-                  message);
-       }
-       fclose( file );
-    } else
-    {
-      fprintf( stderr, "unable to open logfile %s.", header.logfile);
-      exit(-1);
-    }
+    fprintf( stderr, "unable to append to logfile %s.\n",
+             reposLogfile( repos ) );
+    exit(-1);
   }
 }
 
 
-/****************************************************************************
-  purpose: check if the osuser is the reposowner. if not, exit program.
-  pre    : osUserName has been called, global osusername initialized and
-           readRepos has been called, so header is initialized.
+/***************************************************************************
+  purpose: write the log records collected since auditBatch.
+  pre    : readRepos
 ****************************************************************************/
-void isReposOwner()
+void logFlush()
 {
-  if ( strncmp( osusername, header.reposowner, W_OSUSERNAME ) != 0 )
+  if ( !auditFlush() )
   {
-     logLine( 1,
-              "security (not reposowner).");
-     fprintf( stderr, "%s\n", MSG_SECURITY );
-     exit(-1);
+    fprintf( stderr, "unable to append to logfile %s.\n",
+             reposLogfile( repos ) );
+    exit(-1);
   }
 }
 
-/****************************************************************************
-  purpose: compare two entries. sorted on database, schemaname,
-           osusername. comparison is case sensitive. this fucntion
-           is used by and passed to the standard qsort call.
-  pre    : p1 and p2 point to valid entries.
-  post   : returns true when entries are equal. equality is reached
-           when the database name, the schamename and the osusername
-           are equal.
+/***************************************************************************
+  purpose: log the last lock attempt if it had to wait, with the process
+           that held the lock. failed is set if the lock was not obtained.
+           with LOG_ERRORS, only failures are written.
+  pre    : readRepos, or writeRepos.
 ****************************************************************************/
-int compareEntries( p1, p2 )
-void *p1;
-void *p2;
+void logLockWait( failed )
+int failed;
 {
-  int result = strncmp( ((Entry*)p1)->database,
-                        ((Entry*)p2)->database,
-                        W_DATABASE );
-  if ( !result )
+  const LockWait *lockwait = reposLockWait( repos );
+  if ( lockwait->retries == 0 || strlen( reposLogfile( repos ) ) == 0 ||
+       ( !failed && reposLogLevel( repos ) == LOG_ERRORS ) )
+    return;
+  if ( !auditLockWait( reposLogfile( repos ),
+                       failed,
+                       osusername,
+                       lockTypeName( lockwait->type ),
+                       lockwait->waited,
+                       lockwait->retries,
+                       (long) lockwait->holder,
+                       lockTypeName( lockwait->holdertype ),
+                       lockwait->command ) )
   {
-    result = strncmp( ((Entry*)p1)->schemaname,
-                      ((Entry*)p2)->schemaname,
-                      W_SCHEMANAME );
-    if ( !result )
-    {
-      result = strncmp( ((Entry*)p1)->osusername,
-                        ((Entry*)p2)->osusername,
-                        W_OSUSERNAME );
-    }
+    fprintf( stderr, "unable to append to logfile %s.\n",
+             reposLogfile( repos ) );
+    exit(-1);
   }
-  return result;
 }
 
-/****************************************************************************
-  purpose: sort entries. use the standard quicksort function and
-           use the compareEntries function to compare.
-  pre    : header and entries are initialized by readRepos.
-  post   : entries are sorted using compareEntries criteria.
+/***************************************************************************
+  purpose: log the read counters reported by takeReadCounts, the first one
+           starts a batch so they are written together.
 ****************************************************************************/
-void qsortEntries()
+void logReadCount( const char    *osuser,
+                   const char    *database,
+                   const char    *schemaname,
+                   unsigned long count,
+                   time_t        since )
 {
-  qsort( entries, header.entries, sizeof(Entry), compareEntries );
+  auditBatch();
+  if ( !auditReads( reposLogfile( repos ),
+                    osusername,
+                    osuser,
+                    database,
+                    schemaname,
+                    count,
+                    since ) )
+  {
+    fprintf( stderr, "unable to append to logfile %s.\n",
+             reposLogfile( repos ) );
+    exit(-1);
+  }
 }
 
-/****************************************************************************
-  purpose: read the repos header from a file. all fields are stored as
-           strings thereby making the repository platform independent.
-  pre    : file is a FILE* to the repository opened for reading
-****************************************************************************/
-int readHeader( file )
-FILE *file;
-{
-  int i;
-  char intbuf[W_INTBUF];
-  for ( i = 0; i < sizeof( header.magic ); i++) 
-    header.magic[i] = fgetc( file );
-  for ( i = 0; i < sizeof( header.reposowner ); i++) 
-    header.reposowner[i] = fgetc( file );
-  for ( i = 0; i < sizeof( header.logfile ); i++) 
-    header.logfile[i] = fgetc( file );    
-  for ( i = 0; i < sizeof( intbuf ); i++) 
-    intbuf[i] = fgetc( file );        
-  if ( strlen( intbuf ) > 0 )
-    header.entries = atol( intbuf );
-  else 
-    header.entries = 0;    
-  return !ferror( file );        
-
-}
-
-/****************************************************************************
-  purpose: write the repos header to a file. all fields are stored as strings
-           making the repository platform indepenent.
-  pre    : file is a FILE* to the repository opened for writing
-  post   :
+/***************************************************************************
+  purpose: with LOG_SUMMARY, log the successful reads counted since the
+           last summary, if that is loginterval seconds ago or force is set.
+  pre    : readRepos
 ****************************************************************************/
-int writeHeader( file )
-FILE *file;
+void logReadSummary( force )
+int force;
 {
-  int i;
-  char number[W_INTBUF];
-  sprintf( number, "%d", header.entries );
-  for ( i = 0; i < sizeof( header.magic  ); i++ )
-    fputc( header.magic[i], file );
-  for ( i = 0; i < sizeof( header.reposowner ); i++ )
-    fputc( header.reposowner[i], file );    
-  for ( i = 0; i < sizeof( header.logfile  ); i++ )
-    fputc( header.logfile[i], file );    
-  for ( i = 0; i < sizeof( number  ); i++ )
-    fputc( number[i], file );      
-  return !ferror( file );
+  char name[W_REPOSNAME + sizeof( READS_SUFFIX )];
+  if ( strlen( reposLogfile( repos ) ) == 0 ||
+       reposLogLevel( repos ) != LOG_SUMMARY )
+    return;
+  snprintf( name, sizeof( name ), "%s%s", reposname, READS_SUFFIX );
+  takeReadCounts( name,
+                  force ? 0 : reposLogInterval( repos ),
+                  logReadCount );
+  logFlush();
 }
 
-
-/****************************************************************************
-  purpose: write the entry at index to a file. all fields are stored as 
-           strings making the repository platform independent.
-  pre    : file is a FILE* to the repository opened for writing
-  post   :
+/***************************************************************************
+  purpose: log a successful read. with LOG_SUMMARY the read is counted in
+           the read counters, and summarized every loginterval seconds.
+           denied reads are logged by logEntryLine, at every level.
+  pre    : readRepos
 ****************************************************************************/
-int writeEntry( file , index)
-FILE *file;
-int  index;
+void logRead( database, schemaname )
+char *database;
+char *schemaname;
 {
-  int i;
-  for ( i = 0; i < sizeof( entries[index].database ); i++ )
-    fputc( entries[index].database[i], file );
-  for ( i = 0; i < sizeof( entries[index].schemaname ); i++ )
-    fputc( entries[index].schemaname[i], file );    
-  for ( i = 0; i < sizeof( entries[index].osusername ); i++ )
-    fputc( entries[index].osusername[i], file );    
-  for ( i = 0; i < sizeof( entries[index].password ); i++ )
-    fputc( entries[index].password[i], file );    
-  return !ferror( file );
-}
-
-/****************************************************************************
-  purpose: read the entry at index from file. all fields are stored as 
-           strings making the repository platform independent.
-  pre    : file is a FILE* to the repository opened for reading
-  post   :
-****************************************************************************/
-int readEntry( file, index )
-FILE *file;
-int index;
-{ 
-  int i;
-  for ( i = 0; i < sizeof( entries[index].database ); i++ )  
-    entries[index].database[i] = fgetc( file );
-  for ( i = 0; i < sizeof( entries[index].schemaname ); i++ )
-    entries[index].schemaname[i] = fgetc( file );    
-  for ( i = 0; i < sizeof( entries[index].osusername ); i++ )
-    entries[index].osusername[i] = fgetc( file );    
-  for ( i = 0; i < sizeof( entries[index].password ); i++ )
-    entries[index].password[i] = fgetc( file );    
-  return !ferror( file );    
+  char name[W_REPOSNAME + sizeof( READS_SUFFIX )];
+  if ( strlen( reposLogfile( repos ) ) == 0 ||
+       reposLogLevel( repos ) < LOG_ALL )
+    return;
+  snprintf( name, sizeof( name ), "%s%s", reposname, READS_SUFFIX );
+  if ( reposLogLevel( repos ) == LOG_SUMMARY &&
+       countRead( name, osusername, database, schemaname ) )
+    logReadSummary( 0 );
+  else
+    logEntryLine( 0, database, schemaname, osusername, "request ok" );
 }
 
 /****************************************************************************
-  purpose: lock repository file for read.
-  pre    : file is a FILE* to the repository opened for reading
-  post   :
+  purpose: check if the osuser is the reposowner. if not, exit program.
+  pre    : osUserName has been called, global osusername initialized and
+           readRepos has been called, so repos is loaded.
 ****************************************************************************/
-int readLock( FILE *file )
+void isReposOwner()
 {
-  int r = -1;
-  int c = 0;
-  struct flock all;
-  struct timespec req;
-  req.tv_sec = 0;
-  req.tv_nsec = LOCK_SLEEP;
-  all.l_type = F_RDLCK;
-  all.l_whence = SEEK_SET;
-  all.l_start = 0;
-  all.l_len = 10;
-  r = fcntl( fileno( file ),
-             F_SETLK,
-             &all );
-  while( r == -1 && ( errno == EAGAIN || errno == EACCES ) && c < LOCK_RETRIES )
-  {
-    nanosleep( &req, NULL );
-    r = fcntl( fileno( file ),
-                F_SETLK,
-                &all );
-    fprintf( stdout, "sleeping %i\n", c );
-    c++;
+  if ( strncmp( osusername, reposOwner( repos ), W_OSUSERNAME ) != 0 )
+  {
+     logLine( 1,
+              "security (not reposowner).");
+     fprintf( stderr, "%s\n", MSG_SECURITY );
+     exit(-1);
   }
-  return r;
-         
 }
 
 /****************************************************************************
-  purpose: lock repository file for write.
-  pre    : file is a FILE* to the repository opened for writing
-  post   :
+  purpose: open the repository file as repos, loaded, or with stream set
+           for a single pass with reposNext.
+  pre    : reposname filled
+  post   : opr terminates if it cannot be read.
 ****************************************************************************/
-int writeLock( FILE *file )
+void openRepos( stream )
+int stream;
 {
-  int r = -1;
-  int c = 0;
-  struct flock all;
-  struct timespec req;
-  req.tv_sec = 0;
-  req.tv_nsec = LOCK_SLEEP;
-  all.l_type = F_WRLCK;
-  all.l_whence = SEEK_SET;
-  all.l_start = 0;
-  all.l_len = 10;
-  r = fcntl( fileno( file ),
-             F_SETLK,
-             &all );
-  while( r == -1 && ( errno == EAGAIN || errno == EACCES ) && c < LOCK_RETRIES )
-  {
-    nanosleep( &req, NULL );
-    r = fcntl( fileno( file ),
-                F_SETLK,
-                &all );
-    c++;
+  int r = stream ? reposOpenStream( reposname, &repos ) :
+                   reposOpen( reposname, &repos );
+  if ( r == REPOS_OK )
+  {
+    logLockWait( 0 );
+    return;
   }
-  return r;
-}
-
-/****************************************************************************
-  purpose: unlock repository.
-  pre    : file is a opened FILE* to the repository
-  post   :
-****************************************************************************/
-int unLock( FILE *file )
-{
-  int r = -1;
-  struct flock all;
-  all.l_type = F_UNLCK;
-  all.l_whence = SEEK_SET;
-  all.l_start = 0;
-  all.l_len = 10;
-  return fcntl( fileno( file ),
-                F_SETLK,
-                &all );
+  switch ( r )
+  {
+    case REPOS_EOPEN :
+      fprintf( stderr, "unable to open %s for reading.\n", reposname );
+      break;
+    case REPOS_ELOCK :
+      fprintf( stderr, "error %d locking %s.\n", reposErrno( repos ),
+               reposname );
+      break;
+    case REPOS_EFORMAT :
+      fprintf( stderr, "%s is not a valid OPR repository.\n", reposname );
+      break;
+    case REPOS_EFULL :
+      fprintf( stderr, "%s holds more than %d entries.\n",
+               reposname, MAX_ENTRIES );
+      break;
+    case REPOS_EREAD :
+      fprintf( stderr, "read failure in %s (entry).\n", reposname );
+      break;
+    default :
+      fprintf( stderr, "%s: %s.\n", reposname, reposError( r ) );
+  }
+  terminate();
 }
 
 /****************************************************************************
-  purpose: read in the repository file into memory. the globals header and 
-           entries are filled.
+  purpose: load the repository file into repos.
   pre    : reposname filled
-  post   : the password file is read into memory.
+  post   : the password file is read into memory. opr terminates if it
+           cannot be read.
 ****************************************************************************/
 void readRepos()
 {
-  FILE *file = fopen( reposname, "rb");
-  if ( file )
-  {
-    // obtain read (shared) lock on the file, blocking
-    int r = readLock( file );
-    if ( r == -1 )
-    {
-      fprintf( stderr, "error %d locking %s.\n", errno, reposname );
-      terminate();      
-    }    
-    if ( readHeader( file ) )
-    {
-      if ( strncmp( header.magic, MAGIC, W_MAGIC ) != 0 )
-      {
-        unLock( file );              
-        fprintf( stderr, "%s is not a valid OPR repository.\n", reposname);
-        terminate();
-      }
-      if ( header.entries )
-      {
-        int i;
-        for ( i = 0; i < header.entries; i++ )
-          if ( !readEntry( file, i ) )
-          {
-            unLock( file );                  
-            fprintf( stderr, "read failure in %s (entry).\n", reposname);
-            terminate();
-          }
-      }
-    } else
-    {
-      fprintf( stderr, "read failure in %s (header).\n", reposname);
-      terminate();
-    }
-    unLock( file );          
-    fclose( file );
-  } else
-  {
-    fprintf( stderr, "unable to open %s for reading.\n", reposname);
-    terminate();
-  }
+  openRepos( 0 );
 }
 
 /****************************************************************************
-  purpose: write the repository from memory to file.
-  pre    :
-  post   : repository is written to file.
+  purpose: write the changes made to repos to the repository file.
+  pre    : readRepos
+  post   : repository is written to file. changes written by another opr
+           since readRepos are kept.
 ****************************************************************************/
 void writeRepos()
 {
-  FILE *file = fopen( reposname, "w+b" );
-  if ( file )
-  {    
-    int r;
-    qsortEntries();
-    // obtain write lock on the file, blocking
-    r = writeLock( file );
-    if ( r == -1 )
-    {
-      fprintf( stderr, "error %d locking %s.\n", errno, reposname );
-      terminate();      
-    }
-    if ( writeHeader( file) )
-    {
-      if ( header.entries )
-      {
-        int i;
-        for ( i = 0; i < header.entries; i++ )
-          if ( !writeEntry( file, i ) )
-          {
-            unLock( file );            
-            fprintf( stderr, "write failure in %s (entry).\n", reposname );
-            terminate();
-          }
-      }
-    } else
-    {
-      unLock( file );      
-      fprintf( stderr, "write failure in %s (header).\n", reposname );
-      terminate();
-    }
-    unLock( file );    
-    fclose( file );
-  } else
+  int r = reposCommit( repos );
+  logLockWait( r == REPOS_ELOCK );
+  switch ( r )
   {
-    fprintf( stderr, "unable to open %s for writing.\n", reposname );
-    terminate();
+    case REPOS_OK :
+      return;
+    case REPOS_EOPEN :
+      fprintf( stderr, "unable to open %s for writing.\n", reposname );
+      break;
+    case REPOS_ELOCK :
+      fprintf( stderr, "error %d locking %s.\n", reposErrno( repos ),
+               reposname );
+      break;
+    case REPOS_EWRITE :
+      fprintf( stderr, "write failure in %s (entry).\n", reposname );
+      break;
+    case REPOS_EVIEWS :
+      fprintf( stderr, "unable to write the views of %s, error %d.\n",
+               reposname, reposErrno( repos ) );
+      break;
+    default :
+      fprintf( stderr, "%s: %s.\n", reposname, reposError( r ) );
   }
+  terminate();
 }
 
 /****************************************************************************
-  purpose: search the repository for a database, schemaname,
-           osusername combination. the entries are sorted so a
-           binary search can be used.
-  pre    : the repository is read into memory by the readRepos function.
-  post   : if an entry is found return its index, return -1 otherwise.
+  purpose: load the view of the invoking osuser into repos, see opr +v,
+           the repository itself if there is none.
+  pre    : reposname filled
+  post   : repos holds at least the entries of the osuser. opr terminates
+           if the repository cannot be read.
 ****************************************************************************/
-int findEntry( database, schemaname, osusername )
-char *database;
-char *schemaname;
-char *osusername;
-{
-  int m, r, l, cmp, result;
-  Entry lookfor;
-  result = -1;
-
-  strncpy( lookfor.database, database, sizeof( lookfor.database ) );
-  strncpy( lookfor.schemaname, schemaname, sizeof( lookfor.schemaname ) );
-  strncpy( lookfor.osusername, osusername, sizeof( lookfor.osusername ) );
-  l = 0;
-  r = header.entries - 1;
-  while ( r >= l )
-  {
-    m = ( l + r ) / 2;
-    cmp = compareEntries( &lookfor, &entries[m] );
-    if ( cmp < 0 ) r = m - 1;
-    else if ( cmp > 0 ) l = m + 1;
-    else
+void readView()
+{
+  char name[W_REPOSNAME + sizeof( VIEWS_SUFFIX ) + W_OSUSERNAME + 1];
+  if ( osusername[0] != '.' && !strchr( osusername, '/' ) )
+  {
+    snprintf( name, sizeof( name ), "%s%s/%s",
+              reposname, VIEWS_SUFFIX, osusername );
+    if ( reposOpen( name, &repos ) == REPOS_OK )
     {
-      result=m;
-      break;
+      logLockWait( 0 );
+      return;
     }
+    reposClose( repos );
   }
-  return result;
+  readRepos();
 }
 
 /****************************************************************************
@@ -703,7 +563,15 @@ void printHelp()
   fprintf( stdout, "- create repository                    : "
                    "opr -c\n" );  
   fprintf( stdout, "- list contents of repository          : "
-                   "opr -l\n\n" );                       
+                   "opr -l [<database> [<schemaname> [<osuser>]]]\n" );
+  fprintf( stdout, "                                         "
+                   "(names ending in * are prefixes, --format=tsv|csv|json\n"
+                   "                                          "
+                   "prints the entries only, for scripts)\n" );
+  fprintf( stdout, "- list entries by last read            : "
+                   "opr --usage\n" );
+  fprintf( stdout, "- show repository statistics           : "
+                   "opr --stats\n\n" );                       
   fprintf( stdout, "- add (grant) password                 : "
                    "opr -a (-f) <database> <schemaname> <osuser>\n" );  
   fprintf( stdout, "                                         "
@@ -712,20 +580,73 @@ void printHelp()
                    "opr -r <database> <schemaname>\n" );                   
   fprintf( stdout, "- modify password                      : "
                    "opr -m <database> <schemaname>\n" );                     
+  fprintf( stdout, "- modify password on several databases : "
+                   "opr -M <schemaname> <database> [<database> ...]\n" );
+  fprintf( stdout, "- rotate passwords                     : "
+                   "opr --rotate <database> [<schemaname>]\n" );
+  fprintf( stdout, "                                         "
+                   "(shell patterns, '*' for all; --threads=<n> changes n\n" );
+  fprintf( stdout, "                                         "
+                   " passwords concurrently)\n" );
   fprintf( stdout, "- delete (revoke) password             : "
-                   "opr -d <database> <schemaname> <osuser>\n\n" );  
+                   "opr -d <database> <schemaname> <osuser>\n" );
+  fprintf( stdout, "- delete all passwords of an osuser    : "
+                   "opr -D <osuser>\n" );
+  fprintf( stdout, "- delete entries not read for n days   : "
+                   "opr --prune <n>\n\n" );  
   fprintf( stdout, "- enable logging                       : "
                    "opr +g <logfile>\n" );
+  fprintf( stdout, "                                         "
+                   "(--log-level=errors|changes|all|summary, summary\n"
+                   "                                          "
+                   "counts successful reads and logs them every\n"
+                   "                                          "
+                   "--log-interval=<s>, default 3600)\n" );
   fprintf( stdout, "- disable logging                      : "
-                   "opr -g\n\n" );                     
+                   "opr -g\n\n" );
+  fprintf( stdout, "- enable per osuser views (faster -r)  : "
+                   "opr +v\n" );
+  fprintf( stdout, "- disable per osuser views             : "
+                   "opr -v\n\n" );                     
   fprintf( stdout, "- crosscheck repository with all dbs   : "
                    "opr -x \n" );  
   fprintf( stdout, "- crosscheck repository with single db : "
-                   "opr -x <database>\n\n" );  
+                   "opr -x <database>\n" );  
+  fprintf( stdout, "                                         "
+                   "(--threads=<n> checks n databases concurrently)\n" );
+  fprintf( stdout, "                                         "
+                   "(--deadline=<s> ends the crosscheck after s seconds)\n" );
+  fprintf( stdout, "                                         "
+                   "(--max-age=<s> trusts valid results up to s seconds old)\n" );
+  fprintf( stdout, "                                         "
+                   "(--per-db=<k> uses k concurrent logins per database)\n" );
+  fprintf( stdout, "                                         "
+                   "(--rate=<n> begins at most n logins per second)\n" );
+  fprintf( stdout, "                                         "
+                   "(--resume continues an interrupted crosscheck)\n" );
+  fprintf( stdout, "                                         "
+                   "(--verifiers=<schema> checks password verifiers read\n" );
+  fprintf( stdout, "                                         "
+                   " as schema instead of logging on as every schema)\n" );
+  fprintf( stdout, "                                         "
+                   "(--format=json|csv prints a record per check and per\n" );
+  fprintf( stdout, "                                         "
+                   " database, with the oracle error code and timings)\n\n" );
+  fprintf( stdout, "- limit database calls (-a, -m, -x)    : "
+                   "--attach-timeout=<s> --login-timeout=<s>\n" );
+  fprintf( stdout, "                                         "
+                   "--change-timeout=<s> (0 is no limit)\n" );
+  fprintf( stdout, "- database calls by worker (-a, -m, -x): "
+                   "--worker (--worker-idle=<s>, default %d)\n\n",
+                   WORKER_IDLE );
   fprintf( stdout, "- export repository to file            : "
                    "opr -e <filename> \n" );
   fprintf( stdout, "- import repository from file          : "
                    "opr -i <filename> \n\n" );
+  fprintf( stdout, "- print metrics (prometheus text)      : "
+                   "opr --metrics\n" );
+  fprintf( stdout, "- show repository lock holders/waiters : "
+                   "opr --lock-status\n\n" );
 }
 
 /****************************************************************************
@@ -781,6 +702,50 @@ void getEnvironment()
   }
 }
 
+/****************************************************************************
+  purpose: map the metrics counters of the repository, so this invocation
+           is counted. if they cannot be mapped, nothing is counted.
+  pre    : getEnvironment
+****************************************************************************/
+void openRepositoryMetrics()
+{
+  char name[W_REPOSNAME + sizeof( METRICS_SUFFIX )];
+  snprintf( name, sizeof( name ), "%s%s", reposname, METRICS_SUFFIX );
+  openMetrics( name );
+}
+
+/****************************************************************************
+  purpose: print the metrics counters of the repository to stdout, in the
+           prometheus text format.
+  pre    : getEnvironment
+****************************************************************************/
+void printRepositoryMetrics()
+{
+  char name[W_REPOSNAME + sizeof( METRICS_SUFFIX )];
+  snprintf( name, sizeof( name ), "%s%s", reposname, METRICS_SUFFIX );
+  if ( !printMetrics( name, stdout ) )
+  {
+    fprintf( stderr, "unable to map %s.\n", name );
+    terminate();
+  }
+}
+
+/****************************************************************************
+  purpose: print the processes holding and waiting for the repository lock
+           to stdout, with the lock wait times.
+  pre    : getEnvironment
+****************************************************************************/
+void printLockHolders()
+{
+  char name[W_REPOSNAME + sizeof( LOCKS_SUFFIX )];
+  snprintf( name, sizeof( name ), "%s%s", reposname, LOCKS_SUFFIX );
+  if ( !printLockStatus( reposname, name, stdout ) )
+  {
+    fprintf( stderr, "unable to open %s for reading.\n", reposname );
+    terminate();
+  }
+}
+
 /****************************************************************************
   purpose: fetch the operating system username of the invoker of
            this executable. the uid is examined.
@@ -812,45 +777,54 @@ void osUserName()
 ****************************************************************************/
 void createRepos()
 {
-  FILE * file = fopen( reposname, "r");
-  if ( file )
+  int r = reposCreate( reposname, osusername );
+  if ( r == REPOS_EEXIST )
   {
-    fclose( file );
     fprintf( stderr, "file %s already exists.\n", reposname );
     terminate();
   }
-  file = fopen( reposname, "w" );
-  if ( file )
-  {
-    memset( &header, 0, sizeof( header ) );   
-    strncpy( header.magic, MAGIC, sizeof( header.magic ) );
-    strncpy( header.reposowner, osusername, sizeof( header.reposowner) );
-    if ( !writeHeader( file ) )
-    {
-      fprintf( stderr, "failure writing to %s (header).\n", reposname );
-      exit( -1 );
-    }
-    fclose( file );
-    if ( chmod( reposname,  S_IRUSR | S_IWUSR ) )
-    {
-      fprintf( stderr,
-               "chmod failed on repository %s with errno %d.\n",
-               reposname,
-               errno);
-      terminate();
-    }
-    fprintf( stdout, "repository %s created.\n", reposname );
-  } else
+  if ( r != REPOS_OK )
   {
     fprintf( stderr, "unable to open %s for writing.\n", reposname );
     exit( -1 );
   }
+  fprintf( stdout, "repository %s created.\n", reposname );
+}
+
+/****************************************************************************
+  purpose: record a read of schemaname@database by the invoker in the usage
+           sidecar, for opr --usage and opr --prune. a read that cannot be
+           recorded for lack of room marks the sidecar, see pruneEntries.
+****************************************************************************/
+void touchEntry( database, schemaname )
+char *database;
+char *schemaname;
+{
+  char name[W_REPOSNAME + sizeof( USAGE_SUFFIX )];
+  snprintf( name, sizeof( name ), "%s%s", reposname, USAGE_SUFFIX );
+  touchUsage( name, osusername, database, schemaname );
+}
+
+/****************************************************************************
+  purpose: free the usage of a deleted entry in the usage sidecar, so its
+           room is used again.
+  pre    : the entry is deleted and the repository written.
+****************************************************************************/
+void forgetEntry( database, schemaname, osuser )
+char *database;
+char *schemaname;
+char *osuser;
+{
+  char name[W_REPOSNAME + sizeof( USAGE_SUFFIX )];
+  snprintf( name, sizeof( name ), "%s%s", reposname, USAGE_SUFFIX );
+  forgetUsage( name, osuser, database, schemaname );
 }
 
 /****************************************************************************
   purpose: find the password for the given ( database, schemaname, osusername) 
            tuple.
-  pre    : the password file is read into memory by readRepos.
+  pre    : the view of the osuser, or the password file, is read into
+           memory by readView.
   post   : if the entry is found, and the osuser is allowed to,
            then the password is echoed to sdtout.
            The MSG_SECURITY is printed to stderr otherwise.
@@ -859,59 +833,30 @@ void readPassword( database,schemaname )
 char* database;
 char* schemaname;
 {
-  int e;
-  readRepos();
+  char pwd[W_PASSWORD + 1];
+  readView();
 
   strtoupper( database );
   strtolower( schemaname );
 
-  e=findEntry( database, schemaname, osusername );
-  if ( e == -1 ) 
+  if ( reposLookup( repos, database, schemaname, osusername,
+                    pwd, sizeof( pwd ) ) != REPOS_OK )
   {
     logEntryLine( 1, database, schemaname, osusername, MSG_SECURITY);
     fprintf( stderr, "%s\n", MSG_SECURITY );
+    countMetric( M_READS_DENIED, 1 );
+    timeMetric( H_READ, metricsClock() - started );
     terminate();
   } else {
-    cryptEntry( &entries[e] );
-    printf( entries[e].password );
-    logEntryLine( 0, database, schemaname, osusername, "request ok");    
+    printf( "%s", pwd );
+    memset( pwd, 0, sizeof( pwd ) );
+    logRead( database, schemaname );
+    touchEntry( database, schemaname );
+    countMetric( M_READS_OK, 1 );
+    timeMetric( H_READ, metricsClock() - started );
   }
 }
 
-/****************************************************************************
-  purpose: find the first entry for a ( database, schemaname) tuple.
-  pre    : readRepos
-  post   : return -1 when entry not found, index of the entry otherwise.
-****************************************************************************/
-int schemaPassword( database, schemaname )
-char *database;
-char *schemaname;
-{
-  int l, r, m, found;
-  l = 0;
-  r = header.entries - 1;
-  found = -1;
-  while ( r >= l )
-  {
-    m = ( l + r ) / 2 ;
-    if ( strncmp( database, entries[m].database, W_DATABASE ) < 0 ) r = m - 1;
-    else
-    if ( strncmp( database, entries[m].database, W_DATABASE ) > 0 ) l = m + 1;
-    else
-    if ( strncmp( schemaname, entries[m].schemaname, W_SCHEMANAME ) < 0 ) 
-      r = m - 1;
-    else
-    if ( strncmp( schemaname, entries[m].schemaname, W_SCHEMANAME ) > 0 ) 
-      l = m + 1;
-    else 
-    {
-      found = m;
-      break;
-    }
-  }   
-  return found;
-}
-
 /****************************************************************************
   purpose: add a new entry to the password file.
   pre    : readRepos
@@ -925,12 +870,12 @@ char *schemaname;
 char *osuser;
 int noverify;
 {
-  char pwd[W_PASSWORD];
-  int existpwd;
+  char pwd[W_PASSWORD + 1];
+  int existpwd, r;
 
   readRepos();
   isReposOwner();
-  loadOraLibs();
+  if ( !useworker ) loadOraLibs();
 
   strtoupper( database );
   strtolower( schemaname );
@@ -949,65 +894,43 @@ int noverify;
              W_SCHEMANAME-1 );    
     terminate();             
   }
-  if ( header.entries == MAX_ENTRIES )
+  if ( reposCount( repos ) == MAX_ENTRIES )
   {
     fprintf( stderr,
              "max_entries reached (max %d entries).\n",
              MAX_ENTRIES );
     terminate();             
   }
-  if ( findEntry( database, schemaname, osuser ) != -1 )
+  if ( reposFind( repos, database, schemaname, osuser ) != -1 )
   {
     fprintf( stderr, "entry exists.\n" );
     terminate();
   }
-  existpwd = schemaPassword( database, schemaname );
+  existpwd = reposFindCredential( repos, database, schemaname );
   if ( existpwd != -1 )
-  {
-    cryptEntry( &entries[existpwd] );
-    strncpy( entries[header.entries].database,
-             database,
-             sizeof( entries[header.entries].database ) );
-    strncpy( entries[header.entries].schemaname,
-             schemaname,
-             sizeof( entries[header.entries].schemaname ) );
-    strncpy( entries[header.entries].osusername,
-             osuser,
-             sizeof( entries[header.entries].osusername ) );  
-    strncpy( entries[header.entries].password,
-             entries[existpwd].password,
-             sizeof( entries[header.entries].password ) );  
-    cryptEntry( &entries[existpwd] );                                
-    cryptEntry( &entries[header.entries] );         
-  } else
+    reposDecrypt( reposEntry( repos, existpwd ), pwd );
+  else
   if ( askPassword( pwd ) )
   {
-    if ( noverify != 1 && !checkDBPassword( database,
+    if ( noverify != 1 && !workerCheckDBPassword( database,
                                             schemaname,
                                             pwd ) )
     {
       fprintf( stderr, "entry not added.\n" );
       terminate();
     }
-    strncpy( entries[header.entries].database,
-             database,
-             sizeof( entries[header.entries].database) );
-    strncpy( entries[header.entries].schemaname,
-             schemaname,
-             sizeof( entries[header.entries].schemaname ) );
-    strncpy( entries[header.entries].osusername,
-             osuser,
-             sizeof( entries[header.entries].osusername) );
-    strncpy( entries[header.entries].password,
-             pwd,
-             sizeof( entries[header.entries].password) );
-    cryptEntry( &entries[header.entries] );             
   } else
   {
     printf( "password not entered correctly.\n" );
     terminate();
   }
-  header.entries++;
+  r = reposAdd( repos, database, schemaname, osuser, pwd );
+  if ( r != REPOS_OK )
+  {
+    fprintf( stderr, "entry not added (%s).\n", reposError( r ) );
+    terminate();
+  }
+  memset( pwd, 0, sizeof( pwd ) );
   writeRepos();
 
   fprintf( stdout,
@@ -1033,26 +956,20 @@ char *database;
 char *schemaname;
 char *osuser;
 {
-  int e, i;
   readRepos();
   isReposOwner();
 
   strtoupper( database );
   strtolower( schemaname );
 
-  e = findEntry( database, schemaname, osuser );
-  if ( e == -1 )
+  if ( reposDelete( repos, database, schemaname, osuser ) != REPOS_OK )
   {
     fprintf( stderr, "entry does not exist.\n" );
     terminate();
   } else
   {
-    for ( i = e + 1; i < header.entries; i++ )
-    {
-      entries[i-1]=entries[i];
-    }
-    header.entries--;
     writeRepos();
+    forgetEntry( database, schemaname, osuser );
     fprintf( stdout,
              "entry (%s,%s,%s) deleted.\n",
              database,
@@ -1063,53 +980,102 @@ char *osuser;
 }
 
 /****************************************************************************
-  purpose: modify an entry in the password file.
+  purpose: delete all entries of an osuser from the password file, with one
+           write of the repository.
   pre    : readRepos.
-  post   : if the invoking osuser is the repository owner and the
-           entry exists, the given entry is modified.
+  post   : if the invoking osuser is the repository owner and osuser has
+           entries, they are deleted. the deletions are printed and logged
+           once the repository is written.
 ****************************************************************************/
-void modifyEntry( database, schemaname )
-char *database;
-char *schemaname;
+void deleteUser( osuser )
+char *osuser;
 {
-  int e, c, i;
-  char pwd[W_PASSWORD];
-  int synced = 0;
+  char  database[W_DATABASE + 1];
+  char  schemaname[W_SCHEMANAME + 1];
+  char  name[W_OSUSERNAME + 1];
+  Entry *deleted;
+  int   first, last, i, n;
+
+  readRepos();
+  isReposOwner();
+
+  snprintf( name, sizeof( name ), "%s", osuser );
+  n = reposUserRange( repos, name, &first, &last );
+  if ( n < 0 )
+  {
+    fprintf( stderr, "entries not deleted (%s).\n", reposError( n ) );
+    terminate();
+  }
+  if ( n == 0 )
+  {
+    fprintf( stderr, "no entries for osuser %s.\n", name );
+    terminate();
+  }
+  deleted = (Entry*) malloc( n * sizeof( Entry ) );
+  if ( !deleted )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    terminate();
+  }
+  for ( i = first; i < last; i++ )
+    deleted[i - first] = *reposUserEntry( repos, i );
+  reposDeleteUser( repos, name );
+  writeRepos();
+  auditBatch();
+  for ( i = 0; i < n; i++ )
+  {
+    snprintf( database, sizeof( database ), "%.*s",
+              W_DATABASE, deleted[i].database );
+    snprintf( schemaname, sizeof( schemaname ), "%.*s",
+              W_SCHEMANAME, deleted[i].schemaname );
+    forgetEntry( database, schemaname, name );
+    printf( "entry (%s,%s,%s) deleted.\n", database, schemaname, name );
+    logEntryLine( 0, database, schemaname, name, "entry deleted" );
+  }
+  logFlush();
+  memset( deleted, 0, n * sizeof( Entry ) );
+  free( deleted );
+  printf( "%d entries deleted.\n", n );
+}
+
+/****************************************************************************
+  purpose: modify an entry in the password file.
+  pre    : readRepos.
+  post   : if the invoking osuser is the repository owner and the
+           entry exists, the given entry is modified.
+****************************************************************************/
+void modifyEntry( database, schemaname )
+char *database;
+char *schemaname;
+{
+  int e, c;
+  char pwd[W_PASSWORD];
+  char old[W_PASSWORD + 1];
 
   strtoupper( database );
   strtolower( schemaname );
 
   readRepos();
   isReposOwner();
-  loadOraLibs();
+  if ( !useworker ) loadOraLibs();
   if ( askPassword( pwd ) )
   {
-    c=0;
-    for ( i = 0; i < header.entries; i++ )
+    e = reposFindCredential( repos, database, schemaname );
+    if ( e != -1 )
     {
-      if ( strncmp( entries[i].database, database, W_DATABASE ) == 0 &&
-           strncmp( entries[i].schemaname, schemaname, W_SCHEMANAME ) == 0 )
+      reposDecrypt( reposEntry( repos, e ), old );
+      if ( !workerChangeDBPassword( database, schemaname, old, pwd ) )
       {
-        if ( !synced )
-        {
-          cryptEntry( &entries[i] );
-          if ( changeDBPassword( entries[i].database,
-                                 entries[i].schemaname,
-                                 entries[i].password,
-                                 pwd ) )
-             synced = 1;
-           else
-           {
-             fprintf( stderr, "nothing modified.\n");
-             terminate();
-           }  
-         }                   
-        strncpy( entries[i].password,
-                 pwd,
-                 sizeof( entries[i].password ) );
-        cryptEntry( &entries[i] );                 
-        c++;
+        fprintf( stderr, "nothing modified.\n");
+        terminate();
       }
+      memset( old, 0, sizeof( old ) );
+    }
+    c = reposSetPassword( repos, database, schemaname, pwd );
+    if ( c < 0 )
+    {
+      fprintf( stderr, "%s.\n", reposError( c ) );
+      terminate();
     }
     writeRepos();
     fprintf( stdout, "%d entries modified.\n",
@@ -1123,52 +1089,1061 @@ char *schemaname;
 }
 
 /****************************************************************************
-  purpose : list the contents of the repository
+  purpose: settle the count changes that timed out, whose password may or
+           may not have been changed, by logging on: first with the new
+           passwords, then with the old passwords of those still unsettled.
+           checks has room for count checks.
+  post   : a change whose new password logs on is DBCHECK_OK, one whose old
+           password logs on is DBCHECK_INVALID, the others are still
+           DBCHECK_TIMEOUT.
+****************************************************************************/
+void verifyChanges( changes, count, checks )
+DBChange *changes;
+int      count;
+DBCheck  *checks;
+{
+  int i, k, t, old;
+
+  for ( old = 0; old < 2; old++ )
+  {
+    t = 0;
+    for ( k = 0; k < count; k++ )
+    {
+      if ( changes[k].result != DBCHECK_TIMEOUT ) continue;
+      checks[t].database = changes[k].database;
+      checks[t].schema = changes[k].schema;
+      checks[t].passwd = old ? changes[k].oldpasswd : changes[k].newpasswd;
+      checks[t].monitor = NULL;
+      t++;
+    }
+    if ( t == 0 ) return;
+    workerCheckDBPasswords( checks, t, options.threads, 0 );
+    for ( i = 0, k = 0; k < count; k++ )
+    {
+      if ( changes[k].result != DBCHECK_TIMEOUT ) continue;
+      if ( checks[i].result == DBCHECK_OK )
+      {
+        changes[k].result = old ? DBCHECK_INVALID : DBCHECK_OK;
+        if ( old )
+          snprintf( changes[k].message,
+                    sizeof( changes[k].message ),
+                    "password change timed out, the old password still"
+                    " logs on.\n" );
+      }
+      i++;
+    }
+  }
+}
+
+/****************************************************************************
+  purpose: change the password of a schema on several databases at once,
+           to a single new password. the changes run concurrently. if any
+           of them fails, the databases already changed are changed back to
+           the old password, which is still in the repository. the
+           repository is written once, with the new password for all
+           databases if every change succeeded, otherwise only for those
+           databases that could not be changed back. when a change timed
+           out and changing it back failed too, a logon tells which
+           password the database has. the changes are made by the worker
+           with --worker.
+  pre    : count > 0
+****************************************************************************/
+void modifyEntries( schemaname, databases, count )
+char *schemaname;
+char *databases[];
+int count;
+{
+  DBChange *changes;
+  DBCheck  *checks;
+  char     pwd[W_PASSWORD];
+  char     (*oldpw)[W_PASSWORD + 1];
+  int      *keep, *result;
+  int      i, k, e, failed, reverted, unsettled, modified;
+
+  strtolower( schemaname );
+  for ( k = 0; k < count; k++ ) strtoupper( databases[k] );
+
+  readRepos();
+  isReposOwner();
+  if ( !useworker ) loadOraLibs();
+  auditBatch();
+
+  changes = (DBChange*) malloc( count * sizeof( DBChange ) );
+  checks = (DBCheck*) malloc( count * sizeof( DBCheck ) );
+  oldpw = malloc( count * sizeof( *oldpw ) );
+  keep = (int*) malloc( count * sizeof( int ) );
+  result = (int*) malloc( count * sizeof( int ) );
+  if ( !changes || !checks || !oldpw || !keep || !result )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    terminate();
+  }
+  for ( k = 0; k < count; k++ )
+  {
+    for ( i = 0; i < k; i++ )
+      if ( strncmp( databases[i], databases[k], W_DATABASE ) == 0 )
+      {
+        fprintf( stderr, "database %s given twice.\n", databases[k] );
+        terminate();
+      }
+    e = reposFindCredential( repos, databases[k], schemaname );
+    if ( e == -1 )
+    {
+      fprintf( stderr,
+               "entry %s@%s does not exist, nothing modified.\n",
+               schemaname,
+               databases[k] );
+      terminate();
+    }
+    reposDecrypt( reposEntry( repos, e ), oldpw[k] );
+  }
+
+  if ( !askPassword( pwd ) )
+  {
+    fprintf( stderr, "password not entered correctly.\n" );
+    terminate();
+  }
+
+  for ( k = 0; k < count; k++ )
+  {
+    changes[k].database = databases[k];
+    changes[k].schema = schemaname;
+    changes[k].oldpasswd = oldpw[k];
+    changes[k].newpasswd = pwd;
+  }
+  workerChangeDBPasswords( changes, count, count );
+
+  failed = 0;
+  for ( k = 0; k < count; k++ )
+  {
+    result[k] = changes[k].result;
+    keep[k] = result[k] == DBCHECK_OK;
+    if ( !keep[k] )
+    {
+      failed++;
+      fflush( stdout );
+      fprintf( stderr, "%s", changes[k].message );
+      fprintf( stdout,
+               "ERROR: password of %s@%s not changed.\n",
+               schemaname,
+               databases[k] );
+    }
+  }
+
+  /* change back the databases that were changed, and those that may have
+     been changed by a change that timed out */
+  if ( failed )
+  {
+    reverted = 0;
+    for ( k = 0; k < count; k++ )
+    {
+      if ( result[k] == DBCHECK_INVALID ) continue;
+      changes[reverted].database = databases[k];
+      changes[reverted].schema = schemaname;
+      changes[reverted].oldpasswd = pwd;
+      changes[reverted].newpasswd = oldpw[k];
+      reverted++;
+    }
+    workerChangeDBPasswords( changes, reverted, reverted );
+    unsettled = 0;
+    for ( i = 0, k = 0; k < count; k++ )
+    {
+      if ( result[k] == DBCHECK_INVALID ) continue;
+      if ( changes[i].result == DBCHECK_OK )
+      {
+        keep[k] = 0;
+        fprintf( stdout,
+                 "password of %s@%s changed back.\n",
+                 schemaname,
+                 databases[k] );
+      } else
+      if ( keep[k] && changes[i].result == DBCHECK_INVALID )
+      {
+        fflush( stdout );
+        fprintf( stderr, "%s", changes[i].message );
+        fprintf( stdout,
+                 "ERROR: password of %s@%s could not be changed back, the"
+                 " repository keeps the new password.\n",
+                 schemaname,
+                 databases[k] );
+      } else
+      {
+        /* the change or the change back timed out, the database may
+           have either password */
+        fflush( stdout );
+        fprintf( stderr, "%s", changes[i].message );
+        result[k] = DBCHECK_PENDING;
+        unsettled++;
+      }
+      i++;
+    }
+
+    /* a logon with the new, then the old password tells which it has */
+    if ( unsettled )
+    {
+      for ( i = 0, k = 0; k < count; k++ )
+      {
+        if ( result[k] != DBCHECK_PENDING ) continue;
+        changes[i].database = databases[k];
+        changes[i].schema = schemaname;
+        changes[i].oldpasswd = oldpw[k];
+        changes[i].newpasswd = pwd;
+        changes[i].result = DBCHECK_TIMEOUT;
+        i++;
+      }
+      verifyChanges( changes, unsettled, checks );
+      for ( i = 0, k = 0; k < count; k++ )
+      {
+        if ( result[k] != DBCHECK_PENDING ) continue;
+        keep[k] = changes[i].result == DBCHECK_OK;
+        if ( changes[i].result == DBCHECK_OK )
+          fprintf( stdout,
+                   "ERROR: password of %s@%s could not be changed back, the"
+                   " repository keeps the new password.\n",
+                   schemaname,
+                   databases[k] );
+        else
+        if ( changes[i].result == DBCHECK_INVALID )
+          fprintf( stdout,
+                   "password of %s@%s is unchanged.\n",
+                   schemaname,
+                   databases[k] );
+        else
+          fprintf( stdout,
+                   "ERROR: password of %s@%s is unknown, either the old or"
+                   " the new one, the repository keeps the old password.\n",
+                   schemaname,
+                   databases[k] );
+        i++;
+      }
+    }
+  }
+
+  modified = 0;
+  for ( k = 0; k < count; k++ )
+    if ( keep[k] )
+      modified += reposSetPassword( repos, databases[k], schemaname, pwd );
+  if ( modified > 0 ) writeRepos();
+  for ( k = 0; k < count; k++ )
+    logEntryLine( !keep[k], databases[k], schemaname, "",
+                  keep[k] ? "entry modified" : "entry not modified" );
+  logFlush();
+  fprintf( stdout, "%d entries modified.\n", modified );
+
+  memset( pwd, 0, sizeof( pwd ) );
+  memset( oldpw, 0, count * sizeof( *oldpw ) );
+  free( result );
+  free( keep );
+  free( oldpw );
+  free( checks );
+  free( changes );
+  if ( failed ) terminate();
+}
+
+/****************************************************************************
+  purpose: fill pwd with a random password of ROTATE_LENGTH letters and
+           digits from /dev/urandom. the password starts with a letter and
+           holds at least one lowercase letter, uppercase letter and digit.
+  post   : returns 0 if no random data could be read.
+****************************************************************************/
+int randomPassword( pwd )
+char *pwd;
+{
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz"
+                                 "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "0123456789";
+  unsigned char byte;
+  int           fd, i, lower, upper, digit;
+
+  fd = open( "/dev/urandom", O_RDONLY );
+  if ( fd < 0 ) return 0;
+  do
+  {
+    lower = upper = digit = 0;
+    for ( i = 0; i < ROTATE_LENGTH; )
+    {
+      if ( read( fd, &byte, 1 ) != 1 )
+      {
+        close( fd );
+        return 0;
+      }
+      /* 248 is the largest multiple of 62, larger bytes would bias */
+      if ( byte >= 248 ) continue;
+      pwd[i] = alphabet[byte % 62];
+      if ( i == 0 && byte % 62 >= 52 ) continue;
+      if ( byte % 62 < 26 ) lower = 1;
+      else if ( byte % 62 < 52 ) upper = 1;
+      else digit = 1;
+      i++;
+    }
+    pwd[i] = 0;
+  } while ( !lower || !upper || !digit );
+  close( fd );
+  return 1;
+}
+
+/****************************************************************************
+  purpose: rotate the password of every distinct (database, schemaname)
+           combination matching the database and schemaname patterns, which
+           are shell wildcard patterns. a NULL schemaname pattern matches
+           all schemas. each combination gets a generated
+           password. the changes run concurrently, options.threads at a
+           time, by the worker with --worker. the successful changes are
+           written to the repository at once, the failed ones are reported
+           and left unchanged. a change that timed out is settled by
+           logging on; if neither password logs on, the generated one is
+           printed, so it is not lost.
+  post   : exits with 1 if any rotation failed.
+****************************************************************************/
+void rotatePasswords( database, schemaname )
+char *database;
+char *schemaname;
+{
+  DBChange *changes;
+  DBCheck  *checks;
+  const Entry *e;
+  char     (*oldpw)[W_PASSWORD + 1];
+  char     (*newpw)[W_PASSWORD + 1];
+  char     (*databases)[W_DATABASE + 1];
+  char     (*schemas)[W_SCHEMANAME + 1];
+  int      i, c, k, n, rotated, modified;
+
+  strtoupper( database );
+  if ( schemaname ) strtolower( schemaname );
+
+  readRepos();
+  isReposOwner();
+  auditBatch();
+
+  /* the names are copied, the entries move when the repository is
+     written */
+  n = reposCount( repos );
+  changes = (DBChange*) malloc( ( n + 1 ) * sizeof( DBChange ) );
+  checks = (DBCheck*) malloc( ( n + 1 ) * sizeof( DBCheck ) );
+  oldpw = malloc( ( n + 1 ) * sizeof( *oldpw ) );
+  newpw = malloc( ( n + 1 ) * sizeof( *newpw ) );
+  databases = malloc( ( n + 1 ) * sizeof( *databases ) );
+  schemas = malloc( ( n + 1 ) * sizeof( *schemas ) );
+  if ( !changes || !checks || !oldpw || !newpw || !databases || !schemas )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    terminate();
+  }
+
+  c = 0;
+  for ( i = 0; i < n; i++ )
+  {
+    e = reposEntry( repos, i );
+    if ( fnmatch( database, e->database, 0 ) ||
+         ( schemaname && fnmatch( schemaname, e->schemaname, 0 ) ) )
+      continue;
+    if ( c > 0 &&
+         strncmp( changes[c-1].database, e->database, W_DATABASE ) == 0 &&
+         strncmp( changes[c-1].schema, e->schemaname, W_SCHEMANAME ) == 0 )
+      continue;
+    reposDecrypt( e, oldpw[c] );
+    if ( !randomPassword( newpw[c] ) )
+    {
+      fprintf( stderr, "unable to read /dev/urandom.\n" );
+      terminate();
+    }
+    snprintf( databases[c], sizeof( *databases ), "%.*s",
+              W_DATABASE, e->database );
+    snprintf( schemas[c], sizeof( *schemas ), "%.*s",
+              W_SCHEMANAME, e->schemaname );
+    changes[c].database = databases[c];
+    changes[c].schema = schemas[c];
+    changes[c].oldpasswd = oldpw[c];
+    changes[c].newpasswd = newpw[c];
+    c++;
+  }
+  if ( c == 0 ) printf( "nothing to rotate.\n" );
+  else
+  {
+    fprintf( stdout, "rotating %d passwords.\n", c );
+    workerChangeDBPasswords( changes, c, options.threads );
+    /* a change that timed out may have been done, which a logon tells */
+    verifyChanges( changes, c, checks );
+  }
+
+  modified = 0;
+  for ( k = 0; k < c; k++ )
+    if ( changes[k].result == DBCHECK_OK )
+      modified += reposSetPassword( repos, changes[k].database,
+                                    changes[k].schema, newpw[k] );
+  if ( modified > 0 ) writeRepos();
+
+  rotated = 0;
+  for ( k = 0; k < c; k++ )
+  {
+    if ( changes[k].result == DBCHECK_OK )
+    {
+      rotated++;
+      logEntryLine( 0, changes[k].database, changes[k].schema, "",
+                    "password rotated" );
+      continue;
+    }
+    fflush( stdout );
+    fprintf( stderr, "%s", changes[k].message );
+    if ( changes[k].result == DBCHECK_TIMEOUT )
+      fprintf( stdout,
+               "ERROR: entry %s@%s timed out, its password is either"
+               " unchanged or %s.\n",
+               changes[k].schema,
+               changes[k].database,
+               newpw[k] );
+    else
+      fprintf( stdout,
+               "ERROR: entry %s@%s not rotated.\n",
+               changes[k].schema,
+               changes[k].database );
+    logEntryLine( 1, changes[k].database, changes[k].schema, "",
+                  "password rotation failed" );
+  }
+  logFlush();
+  if ( c > 0 )
+    fprintf( stdout,
+             "%d of %d passwords rotated, %d entries modified.\n",
+             rotated,
+             c,
+             modified );
+
+  memset( oldpw, 0, ( n + 1 ) * sizeof( *oldpw ) );
+  memset( newpw, 0, ( n + 1 ) * sizeof( *newpw ) );
+  free( schemas );
+  free( databases );
+  free( newpw );
+  free( oldpw );
+  free( checks );
+  free( changes );
+  if ( rotated < c ) terminate();
+}
+
+/****************************************************************************
+  purpose : print s as a quoted json or csv string. a trailing newline is
+            left out.
+****************************************************************************/
+void printQuoted( s )
+char *s;
+{
+  size_t l = strlen( s );
+  if ( l > 0 && s[l-1] == '\n' ) l--;
+  fputc( '"', stdout );
+  for ( ; l > 0; s++, l-- )
+  {
+    if ( options.format == FORMAT_CSV )
+    {
+      if ( *s == '"' ) fputc( '"', stdout );
+      fputc( *s, stdout );
+    } else
+    if ( *s == '"' || *s == '\\' ) fprintf( stdout, "\\%c", *s );
+    else
+    if ( (unsigned char) *s < 0x20 ) fprintf( stdout, "\\u%04x", *s );
+    else fputc( *s, stdout );
+  }
+  fputc( '"', stdout );
+}
+
+/****************************************************************************
+  purpose: tell if name, a field of width bytes, matches filter: equal to it,
+           or starting with it if prefix is set. a NULL filter matches any
+           name.
+****************************************************************************/
+int matchName( name, width, filter, prefix )
+const char *name;
+int        width;
+const char *filter;
+int        prefix;
+{
+  if ( !filter ) return 1;
+  return strncmp( name, filter, prefix ? strlen( filter ) : width ) == 0;
+}
+
+/****************************************************************************
+  purpose: make a name filter of opr -l from arg. a name ending in * is a
+           prefix, the * is removed and *prefix set.
+  post   : returns the filter, NULL if arg is NULL or "*", matching any name.
+****************************************************************************/
+char *nameFilter( arg, prefix )
+char *arg;
+int  *prefix;
+{
+  size_t l;
+  *prefix = 0;
+  if ( !arg || strcmp( arg, "*" ) == 0 ) return NULL;
+  l = strlen( arg );
+  if ( l > 0 && arg[l-1] == '*' )
+  {
+    arg[l-1] = 0;
+    *prefix = 1;
+  }
+  return arg;
+}
+
+/****************************************************************************
+  purpose: print a listed entry in the format of options.format.
+****************************************************************************/
+void printEntry( entry )
+const Entry *entry;
+{
+  char database[W_DATABASE + 1];
+  char schemaname[W_SCHEMANAME + 1];
+  char osuser[W_OSUSERNAME + 1];
+  /* the names fill their fields without a terminating 0 at full width */
+  snprintf( database, sizeof( database ), "%.*s",
+            W_DATABASE, entry->database );
+  snprintf( schemaname, sizeof( schemaname ), "%.*s",
+            W_SCHEMANAME, entry->schemaname );
+  snprintf( osuser, sizeof( osuser ), "%.*s",
+            W_OSUSERNAME, entry->osusername );
+  switch ( options.format )
+  {
+    case FORMAT_TSV :
+      fprintf( stdout, "%s\t%s\t%s\n", database, schemaname, osuser );
+      break;
+    case FORMAT_CSV :
+      printQuoted( database );
+      fputc( ',', stdout );
+      printQuoted( schemaname );
+      fputc( ',', stdout );
+      printQuoted( osuser );
+      fputc( '\n', stdout );
+      break;
+    case FORMAT_JSON :
+      fprintf( stdout, "{\"database\":" );
+      printQuoted( database );
+      fprintf( stdout, ",\"schemaname\":" );
+      printQuoted( schemaname );
+      fprintf( stdout, ",\"osuser\":" );
+      printQuoted( osuser );
+      fprintf( stdout, "}\n" );
+      break;
+    default :
+      fprintf( stdout, "%-20s%-20s%-20s\n", database, schemaname, osuser );
+  }
+}
+
+/****************************************************************************
+  purpose : list the entries of database, schemaname and osuser, a NULL
+            name or "*" matching any name, a name ending in * any name
+            starting with it. with an exact database or a database prefix,
+            only that range of the sorted entries is scanned, for a single
+            osuser, or a user other than the owner, only the entries of
+            that osuser are, through the osuser index. with
+            --format=tsv, csv or json only the entries are printed, one per
+            line. the output is written through one large buffer.
   pre     : the password file is read into memory
-  post    : entries are printed to stdout
+  post    : entries are printed to stdout. the repository owner can list all
+            entries, other UNIX users only the entries granted to them.
 ****************************************************************************/
-void listEntries()
+void listEntries( database, schemaname, osuser )
+char *database;
+char *schemaname;
+char *osuser;
 {
-  int i;
+  static char buffer[LIST_BUFFER];
+  const Entry *e;
+  int dbprefix, schemaprefix, userprefix, owner, byuser, first, last, i;
+  int c = 0;
+
+  setvbuf( stdout, buffer, _IOFBF, sizeof( buffer ) );
   readRepos();
-  if ( strncmp( header.reposowner, osusername, W_OSUSERNAME ) == 0 )
+  if ( database ) strtoupper( database );
+  if ( schemaname ) strtolower( schemaname );
+  database = nameFilter( database, &dbprefix );
+  schemaname = nameFilter( schemaname, &schemaprefix );
+  osuser = nameFilter( osuser, &userprefix );
+  owner = strncmp( reposOwner( repos ), osusername, W_OSUSERNAME ) == 0;
+
+  if ( options.format == FORMAT_TEXT )
   {
-    if ( strlen( header.logfile ) > 0 )
-      printf( "logfile is %s. \n", header.logfile );
+    if ( owner && strlen( reposLogfile( repos ) ) > 0 )
+      printf( "logfile is %s (level %s). \n",
+              reposLogfile( repos ),
+              LOG_LEVELS[reposLogLevel( repos )] );
     else
+    if ( owner )
       printf( "logging disabled. \n" );
     printf( "contents of repository %s: \n", reposname );
     printf( "------------------------------------------------------------\n" );
     printf( "%-20s%-20s%-20s\n","database","schemaname","osuser" );
     printf( "------------------------------------------------------------\n" );
-    for ( i = 0; i < header.entries; i++ )
+  } else
+  if ( options.format == FORMAT_CSV )
+    printf( "database,schemaname,osuser\n" );
+
+  /* an exact database range is usually the smaller one */
+  byuser = !owner || ( osuser && !userprefix && ( !database || dbprefix ) );
+  if ( byuser )
+  {
+    if ( reposUserRange( repos, owner ? osuser : osusername,
+                         &first, &last ) < 0 )
     {
-      printf( "%-20s%-20s%-20s\n",
-              entries[i].database,
-              entries[i].schemaname,
-              entries[i].osusername );
+      fprintf( stderr, "out of memory.\n" );
+      terminate();
     }
-    printf( "%d entries.\n", header.entries );
   } else
+    reposRange( repos, database, dbprefix, schemaname, schemaprefix,
+                &first, &last );
+  for ( i = first; i < last; i++ )
+  {
+    e = byuser ? reposUserEntry( repos, i ) : reposEntry( repos, i );
+    if ( ( byuser &&
+           !matchName( e->database, W_DATABASE, database, dbprefix ) ) ||
+         !matchName( e->schemaname, W_SCHEMANAME, schemaname, schemaprefix ) ||
+         !matchName( e->osusername, W_OSUSERNAME, osuser, userprefix ) ||
+         ( !owner &&
+           !matchName( e->osusername, W_OSUSERNAME, osusername, 0 ) ) )
+      continue;
+    printEntry( e );
+    c++;
+  }
+  if ( options.format == FORMAT_TEXT ) printf( "%d entries.\n", c );
+}
+
+/****************************************************************************
+the usage of an entry, as recorded by touchEntry.
+   entry - the index of the entry.
+   last  - time of the last read, 0 if it was not read.
+   count - number of reads, up to 2^32-1.
+****************************************************************************/
+typedef struct {
+  int           entry;
+  time_t        last;
+  unsigned long count;
+} Usage;
+
+/****************************************************************************
+  purpose: compare two usages on their last read, least recent first. this
+           function is passed to qsort.
+****************************************************************************/
+int compareUsage( const void *a, const void *b )
+{
+  const Usage *x = (const Usage*) a;
+  const Usage *y = (const Usage*) b;
+  if ( x->last != y->last ) return x->last < y->last ? -1 : 1;
+  return x->entry - y->entry;
+}
+
+/****************************************************************************
+  purpose: look up the usage of every entry, sorted least recently read
+           first. since is set to when usage tracking started.
+  pre    : readRepos
+  post   : usage holds reposCount usages. overflow is set if some reads
+           could not be recorded. opr terminates if the usage sidecar
+           cannot be mapped.
+****************************************************************************/
+void readUsage( usage, since, overflow )
+Usage  *usage;
+time_t *since;
+int    *overflow;
+{
+  char name[W_REPOSNAME + sizeof( USAGE_SUFFIX )];
+  char database[W_DATABASE + 1];
+  char schemaname[W_SCHEMANAME + 1];
+  char osuser[W_OSUSERNAME + 1];
+  int  i;
+
+  snprintf( name, sizeof( name ), "%s%s", reposname, USAGE_SUFFIX );
+  if ( !usageOverflow( name, overflow ) )
+  {
+    fprintf( stderr, "unable to map %s.\n", name );
+    terminate();
+  }
+  for ( i = 0; i < reposCount( repos ); i++ )
+  {
+    const Entry *e = reposEntry( repos, i );
+    /* the names fill their fields without a terminating 0 at full width */
+    snprintf( database, sizeof( database ), "%.*s",
+              W_DATABASE, e->database );
+    snprintf( schemaname, sizeof( schemaname ), "%.*s",
+              W_SCHEMANAME, e->schemaname );
+    snprintf( osuser, sizeof( osuser ), "%.*s",
+              W_OSUSERNAME, e->osusername );
+    usage[i].entry = i;
+    if ( !entryUsage( name, osuser, database, schemaname,
+                      &usage[i].last, &usage[i].count, since ) )
+    {
+      fprintf( stderr, "unable to map %s.\n", name );
+      terminate();
+    }
+  }
+  qsort( usage, reposCount( repos ), sizeof( Usage ), compareUsage );
+}
+
+/****************************************************************************
+  purpose: format a time as local "YYYY-MM-DD HH:MM" into buffer, "never"
+           for 0.
+****************************************************************************/
+char *formatTime( t, buffer, size )
+time_t t;
+char   *buffer;
+size_t size;
+{
+  struct tm tm;
+  if ( t == 0 ) snprintf( buffer, size, "never" );
+  else strftime( buffer, size, "%Y-%m-%d %H:%M", localtime_r( &t, &tm ) );
+  return buffer;
+}
+
+/****************************************************************************
+  purpose: print the entries with their last read time and read count,
+           least recently read first.
+  pre    :
+  post   : only the repository owner is allowed to do this.
+****************************************************************************/
+void listUsage()
+{
+  static Usage usage[MAX_ENTRIES];
+  char   last[W_DATETIME];
+  time_t since = 0;
+  int    i, overflow;
+
+  readRepos();
+  isReposOwner();
+  readUsage( usage, &since, &overflow );
+  printf( "usage of repository %s, tracked since %s: \n",
+          reposname,
+          formatTime( since, last, sizeof( last ) ) );
+  printf( "------------------------------------------------------------"
+          "--------------------\n" );
+  printf( "%-18s%10s  %-20s%-20s%-20s\n",
+          "last read", "reads", "database", "schemaname", "osuser" );
+  printf( "------------------------------------------------------------"
+          "--------------------\n" );
+  for ( i = 0; i < reposCount( repos ); i++ )
+  {
+    const Entry *e = reposEntry( repos, usage[i].entry );
+    printf( "%-18s%10lu  %-20.*s%-20.*s%-20.*s\n",
+            formatTime( usage[i].last, last, sizeof( last ) ),
+            usage[i].count,
+            W_DATABASE, e->database,
+            W_SCHEMANAME, e->schemaname,
+            W_OSUSERNAME, e->osusername );
+  }
+  printf( "%d entries.\n", reposCount( repos ) );
+  if ( overflow )
+    printf( "some reads were not recorded, the sidecar was full.\n" );
+}
+
+/****************************************************************************
+  purpose: revoke every grant not read for days days, with a single write
+           of the repository. a grant never read counts as unused since
+           usage tracking started, so nothing is revoked until it has run
+           for days days. nothing is revoked if a read could not be
+           recorded, the grant read may seem unused. the deletions are
+           printed and logged once the repository is written.
+  pre    :
+  post   : only the repository owner is allowed to do this.
+****************************************************************************/
+void pruneEntries( days )
+char *days;
+{
+  static Usage usage[MAX_ENTRIES];
+  static char  revoke[MAX_ENTRIES];
+  time_t since = 0;
+  time_t limit;
+  Entry  *revoked;
+  char   database[W_DATABASE + 1];
+  char   schemaname[W_SCHEMANAME + 1];
+  char   osuser[W_OSUSERNAME + 1];
+  char   *end;
+  long   n = strtol( days, &end, 10 );
+  int    i, k, count, overflow, pruned = 0;
+
+  if ( *days == 0 || *end != 0 || n < 1 )
+  {
+    fprintf( stderr, "invalid number of days %s.\n", days );
+    terminate();
+  }
+  readRepos();
+  isReposOwner();
+  readUsage( usage, &since, &overflow );
+  if ( overflow )
+  {
+    fprintf( stderr,
+             "some reads could not be recorded in %s%s, entries in use may "
+             "seem unused.\nremove it to track usage anew.\n",
+             reposname, USAGE_SUFFIX );
+    terminate();
+  }
+  limit = time( 0 ) - n * 86400;
+  memset( revoke, 0, sizeof( revoke ) );
+  count = reposCount( repos );
+  for ( i = 0; i < count; i++ )
+    if ( ( usage[i].last ? usage[i].last : since ) < limit )
+    {
+      revoke[usage[i].entry] = 1;
+      pruned++;
+    }
+  if ( pruned == 0 )
+  {
+    printf( "no entries unused for %ld days.\n", n );
+    return;
+  }
+  revoked = (Entry*) malloc( pruned * sizeof( Entry ) );
+  if ( !revoked )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    terminate();
+  }
+  for ( i = 0, k = 0; i < count; i++ )
+  {
+    /* the entries after the ones deleted moved up */
+    const Entry *e = reposEntry( repos, i - ( count - reposCount( repos ) ) );
+    if ( !revoke[i] ) continue;
+    revoked[k++] = *e;
+    snprintf( database, sizeof( database ), "%.*s", W_DATABASE, e->database );
+    snprintf( schemaname, sizeof( schemaname ), "%.*s",
+              W_SCHEMANAME, e->schemaname );
+    snprintf( osuser, sizeof( osuser ), "%.*s", W_OSUSERNAME, e->osusername );
+    reposDelete( repos, database, schemaname, osuser );
+  }
+  writeRepos();
+  auditBatch();
+  for ( k = 0; k < pruned; k++ )
+  {
+    snprintf( database, sizeof( database ), "%.*s",
+              W_DATABASE, revoked[k].database );
+    snprintf( schemaname, sizeof( schemaname ), "%.*s",
+              W_SCHEMANAME, revoked[k].schemaname );
+    snprintf( osuser, sizeof( osuser ), "%.*s",
+              W_OSUSERNAME, revoked[k].osusername );
+    forgetEntry( database, schemaname, osuser );
+    printf( "entry (%s,%s,%s) deleted.\n", database, schemaname, osuser );
+    logEntryLine( 0, database, schemaname, osuser, "entry deleted (unused)" );
+  }
+  logFlush();
+  memset( revoked, 0, pruned * sizeof( Entry ) );
+  free( revoked );
+  printf( "%d entries unused for %ld days deleted.\n", pruned, n );
+}
+
+/****************************************************************************
+  purpose: compare two names of opr --stats, passed to qsort.
+****************************************************************************/
+int compareStatNames( const void *a, const void *b )
+{
+  return strcmp( (const char*) a, (const char*) b );
+}
+
+/****************************************************************************
+  purpose: compare two password hashes of opr --stats, passed to qsort.
+****************************************************************************/
+int compareStatHashes( const void *a, const void *b )
+{
+  unsigned long long x = *(const unsigned long long*) a;
+  unsigned long long y = *(const unsigned long long*) b;
+  return x < y ? -1 : x > y;
+}
+
+/****************************************************************************
+  purpose: print the distribution of the grants over the n names of a
+           dimension, one name per grant in fields of width bytes: the
+           number of distinct names, the least, average and most grants per
+           name, the number of names per power of two grants, and the names
+           with the most grants.
+****************************************************************************/
+void printGrantDistribution( title, names, width, n )
+char *title;
+char *names;
+int  width;
+int  n;
+{
+  int  buckets[32];
+  int  top[3] = { -1, -1, -1 };
+  int  topgrants[3] = { 0, 0, 0 };
+  int  i, j, b, run, distinct = 0, least = 0, most = 0;
+
+  memset( buckets, 0, sizeof( buckets ) );
+  qsort( names, n, width, compareStatNames );
+  for ( i = 0; i < n; i += run )
+  {
+    for ( run = 1; i + run < n &&
+                   strcmp( names + i * width,
+                           names + ( i + run ) * width ) == 0;
+          run++ ) ;
+    distinct++;
+    if ( least == 0 || run < least ) least = run;
+    if ( run > most ) most = run;
+    for ( b = 0; ( 1 << b ) < run; b++ ) ;
+    buckets[b]++;
+    for ( j = 0; j < 3; j++ )
+      if ( run > topgrants[j] )
+      {
+        memmove( top + j + 1, top + j, ( 2 - j ) * sizeof( int ) );
+        memmove( topgrants + j + 1, topgrants + j, ( 2 - j ) * sizeof( int ) );
+        top[j] = i;
+        topgrants[j] = run;
+        break;
+      }
+  }
+  printf( "grants per %s: %d distinct, least %d, average %.1f, most %d\n",
+          title, distinct, least, distinct ? (double) n / distinct : 0.0,
+          most );
+  for ( b = 0; b < 32; b++ )
+  {
+    char range[W_INTBUF];
+    if ( buckets[b] == 0 ) continue;
+    if ( b < 2 ) snprintf( range, sizeof( range ), "%d", 1 << b );
+    else snprintf( range, sizeof( range ), "%d-%d",
+                   ( 1 << ( b - 1 ) ) + 1, 1 << b );
+    printf( "  %11s grants: %d\n", range, buckets[b] );
+  }
+  for ( j = 0; j < 3 && top[j] >= 0; j++ )
+    printf( "%s%s (%d)", j ? ", " : "  most: ", names + top[j] * width,
+            topgrants[j] );
+  if ( top[0] >= 0 ) printf( "\n" );
+}
+
+/****************************************************************************
+  purpose: print the shape of the repository, read in a single pass without
+           loading it: file size, entries against MAX_ENTRIES, the bytes
+           taken by fixed width padding, the distribution of the grants per
+           database, schema and osuser, the passwords copied to several
+           grantees, and the distinct credentials a crosscheck logs on as.
+           the names and hashes it keeps grow with the entries read.
+  pre    :
+  post   : only the repository owner is allowed to do this.
+****************************************************************************/
+void printStats()
+{
+  char               (*databases)[W_DATABASE + 1] = NULL;
+  char               (*schemas)[W_SCHEMANAME + 1] = NULL;
+  char               (*osusers)[W_OSUSERNAME + 1] = NULL;
+  unsigned long long *hashes = NULL;
+  Entry         entry, previous;
+  struct stat   st;
+  long          headerbytes, padding, used[4];
+  long          values[4];
+  int           i, n, r, ints, credentials = 0, copies = 0, differ = 0;
+  int           shared = 0, allocated = 0;
+
+  openRepos( 1 );
+  isReposOwner();
+  if ( stat( reposname, &st ) != 0 )
+  {
+    fprintf( stderr, "unable to open %s for reading.\n", reposname );
+    terminate();
+  }
+  headerbytes = reposHeaderSize( repos );
+
+  memset( used, 0, sizeof( used ) );
+  memset( &previous, 0, sizeof( previous ) );
+  for ( n = 0; ( r = reposNext( repos, &entry ) ) == REPOS_OK; n++ )
   {
-    int c = 0;
-    printf( "contents of repository %s: \n", reposname );
-    printf( "------------------------------------------------------------\n" );
-    printf( "%-20s%-20s%-20s\n","database","schemaname","osuser" );
-    printf( "------------------------------------------------------------\n" );
-    for ( i = 0; i < header.entries; i++ )
+    if ( n == allocated )
     {
-      if ( strncmp( osusername, entries[i].osusername, W_OSUSERNAME ) == 0 )    
+      allocated = allocated ? 2 * allocated : 1024;
+      databases = realloc( databases, allocated * sizeof( *databases ) );
+      schemas = realloc( schemas, allocated * sizeof( *schemas ) );
+      osusers = realloc( osusers, allocated * sizeof( *osusers ) );
+      hashes = realloc( hashes, allocated * sizeof( *hashes ) );
+      if ( !databases || !schemas || !osusers || !hashes )
       {
-        printf( "%-20s%-20s%-20s\n",
-                entries[i].database,
-                entries[i].schemaname,
-                entries[i].osusername );
-        c++;
-      }         
+        fprintf( stderr, "out of memory.\n" );
+        terminate();
+      }
     }
-    printf( "%d entries.\n", c );  
-  }  
+    used[0] += strnlen( entry.database, W_DATABASE );
+    used[1] += strnlen( entry.schemaname, W_SCHEMANAME );
+    used[2] += strnlen( entry.osusername, W_OSUSERNAME );
+    snprintf( databases[n], sizeof( *databases ), "%.*s",
+              W_DATABASE, entry.database );
+    snprintf( schemas[n], sizeof( *schemas ), "%.*s",
+              W_SCHEMANAME, entry.schemaname );
+    snprintf( osusers[n], sizeof( *osusers ), "%.*s",
+              W_OSUSERNAME, entry.osusername );
+    reposCrypt( &entry );
+    used[3] += strnlen( entry.password, W_PASSWORD );
+    /* the entries are sorted, the grants of a credential are adjacent */
+    if ( n > 0 &&
+         strncmp( entry.database, previous.database, W_DATABASE ) == 0 &&
+         strncmp( entry.schemaname, previous.schemaname, W_SCHEMANAME ) == 0 )
+    {
+      copies++;
+      if ( memcmp( entry.password, previous.password, W_PASSWORD ) != 0 )
+        differ++;
+    } else
+    {
+      unsigned long long h = 14695981039346656037ULL;
+      for ( i = 0; i < W_PASSWORD && entry.password[i]; i++ )
+        h = ( h ^ (unsigned char) entry.password[i] ) * 1099511628211ULL;
+      hashes[credentials++] = h;
+      previous = entry;
+    }
+  }
+  memset( &entry, 0, sizeof( entry ) );
+  memset( &previous, 0, sizeof( previous ) );
+  if ( r != REPOS_ENOENT )
+  {
+    fprintf( stderr, "read failure in %s (entry).\n", reposname );
+    terminate();
+  }
+
+  qsort( hashes, credentials, sizeof( hashes[0] ), compareStatHashes );
+  for ( i = 0; i < credentials; i++ )
+    if ( ( i > 0 && hashes[i] == hashes[i - 1] ) ||
+         ( i + 1 < credentials && hashes[i] == hashes[i + 1] ) )
+      shared++;
+
+  /* the header holds the entry count, generation, log level and interval,
+     as far as its version has them, each as a string of W_INTBUF bytes */
+  values[0] = n;
+  values[1] = reposGeneration( repos );
+  values[2] = reposLogLevel( repos );
+  values[3] = reposLogInterval( repos );
+  ints = ( headerbytes - W_MAGIC - W_OSUSERNAME - W_LOGFILE ) / W_INTBUF;
+  padding = W_OSUSERNAME - strnlen( reposOwner( repos ), W_OSUSERNAME ) +
+            W_LOGFILE - strnlen( reposLogfile( repos ), W_LOGFILE );
+  for ( i = 0; i < ints && i < 4; i++ )
+    padding += W_INTBUF - snprintf( NULL, 0, "%ld", values[i] );
+
+  printf( "repository %s (%.*s)\n", reposname, W_MAGIC, reposMagic( repos ) );
+  printf( "file size          : %ld bytes\n", (long) st.st_size );
+  printf( "entries            : %d of %d (%.1f%%)\n",
+          n, MAX_ENTRIES, 100.0 * n / MAX_ENTRIES );
+  printf( "header             : %ld bytes, %ld padding\n",
+          headerbytes, padding );
+  printf( "entry              : %d bytes, %.1f padding on average\n",
+          (int) sizeof( Entry ),
+          n ? sizeof( Entry ) - (double) ( used[0] + used[1] + used[2] +
+                                           used[3] ) / n : 0.0 );
+  printf( "  database         : %.1f of %d bytes used on average\n",
+          n ? (double) used[0] / n : 0.0, W_DATABASE );
+  printf( "  schemaname       : %.1f of %d bytes used on average\n",
+          n ? (double) used[1] / n : 0.0, W_SCHEMANAME );
+  printf( "  osuser           : %.1f of %d bytes used on average\n",
+          n ? (double) used[2] / n : 0.0, W_OSUSERNAME );
+  printf( "  password         : %.1f of %d bytes used on average\n",
+          n ? (double) used[3] / n : 0.0, W_PASSWORD );
+  printf( "padding            : %ld of %ld bytes (%.1f%%)\n",
+          padding + (long) n * sizeof( Entry ) - used[0] - used[1] -
+          used[2] - used[3],
+          headerbytes + (long) n * sizeof( Entry ),
+          100.0 * ( padding + (long) n * sizeof( Entry ) - used[0] -
+                    used[1] - used[2] - used[3] ) /
+          ( headerbytes + (long) n * sizeof( Entry ) ) );
+  printf( "credentials        : %d distinct (database, schema), the logons "
+          "of opr -x\n", credentials );
+  printf( "password copies    : %d grants copy the password of an earlier "
+          "grantee (%ld bytes)\n", copies, (long) copies * sizeof( Entry ) );
+  if ( differ )
+    printf( "                     %d of them differ from it\n", differ );
+  printf( "shared passwords   : %d credentials have the same password as "
+          "another one\n", shared );
+  printGrantDistribution( "database", (char*) databases,
+                          (int) sizeof( *databases ), n );
+  printGrantDistribution( "schema", (char*) schemas,
+                          (int) sizeof( *schemas ), n );
+  printGrantDistribution( "osuser", (char*) osusers,
+                          (int) sizeof( *osusers ), n );
+  free( hashes );
+  free( osusers );
+  free( schemas );
+  free( databases );
+  reposClose( repos );
+  repos = NULL;
 }
 
 /****************************************************************************
@@ -1180,24 +2155,25 @@ char *filename;
 {
   readRepos();
   isReposOwner();
-  if ( header.entries > 0 )
+  if ( reposCount( repos ) > 0 )
   {
     int i;
     FILE *file;
     file = fopen( filename, "w" );
     if ( file )
     {
-      for ( i = 0; i < header.entries; i++ )
+      for ( i = 0; i < reposCount( repos ); i++ )
       {
+        const Entry *e = reposEntry( repos, i );
         int j;
         for ( j = 0; j < W_DATABASE; j++ ) 
-          fputc( entries[i].database[j], file );
+          fputc( e->database[j], file );
         for ( j = 0; j < W_SCHEMANAME; j++ )  
-          fputc( entries[i].schemaname[j], file );
+          fputc( e->schemaname[j], file );
         for ( j = 0; j < W_OSUSERNAME; j++ ) 
-          fputc( entries[i].osusername[j], file );          
+          fputc( e->osusername[j], file );          
         for ( j = 0; j < W_PASSWORD; j++ ) 
-          fputc( entries[i].password[j], file );          
+          fputc( e->password[j], file );          
       }
   
       fclose( file );
@@ -1227,16 +2203,20 @@ char *filename;
 {
   FILE *file;
   Entry entry;
+  char  database[W_DATABASE + 1];
+  char  schemaname[W_SCHEMANAME + 1];
+  char  osuser[W_OSUSERNAME + 1];
+  char  pwd[W_PASSWORD + 1];
   readRepos();
   isReposOwner();
   file = fopen( filename, "r");
   if ( file )
   {
-    int c;  
+    int c, r;
     c = 0;
     while ( !feof( file ) )
     {
-      int j, i;    
+      int j;
       char t;
       long int p;
       t = fgetc( file );
@@ -1252,18 +2232,33 @@ char *filename;
       for ( j = 0; j < W_PASSWORD; j++ ) 
         entry.password[j] = fgetc( file );        
         
-      i = findEntry( entry.database, entry.schemaname, entry.osusername );
-      if ( i == -1 )
-      {                           
-        c++;              
-        entries[header.entries] = entry;
-        header.entries++;
-        qsortEntries();
-      } else printf( "entry (%s, %s, %s ) exists.\n",
-                      entry.database,
-                      entry.schemaname,
-                      entry.osusername );
+      snprintf( database, sizeof( database ), "%.*s",
+                W_DATABASE, entry.database );
+      snprintf( schemaname, sizeof( schemaname ), "%.*s",
+                W_SCHEMANAME, entry.schemaname );
+      snprintf( osuser, sizeof( osuser ), "%.*s",
+                W_OSUSERNAME, entry.osusername );
+      reposDecrypt( &entry, pwd );
+      r = reposAdd( repos, database, schemaname, osuser, pwd );
+      if ( r == REPOS_OK ) c++;
+      else
+      if ( r == REPOS_EDUP )
+        printf( "entry (%s, %s, %s ) exists.\n",
+                database,
+                schemaname,
+                osuser );
+      else
+      {
+        fprintf( stderr, "entry (%s, %s, %s) not imported (%s).\n",
+                 database,
+                 schemaname,
+                 osuser,
+                 reposError( r ) );
+        terminate();
+      }
     }
+    memset( &entry, 0, sizeof( entry ) );
+    memset( pwd, 0, sizeof( pwd ) );
     fclose( file );
     writeRepos();
     fprintf( stdout, "%d entries imported.\n", c );
@@ -1274,6 +2269,541 @@ char *filename;
   }
 }
 
+/****************************************************************************
+  purpose : compute the fingerprint of an (encrypted) entry, used to detect
+            that an entry changed since it was last crosschecked. this is a
+            32 bit FNV-1a hash over database, schemaname and password.
+****************************************************************************/
+unsigned long entryFingerprint( entry )
+const Entry *entry;
+{
+  unsigned long h = 2166136261UL;
+  int i;
+  for ( i = 0; i < W_DATABASE; i++ )
+    h = ( ( h ^ (unsigned char) entry->database[i] ) * 16777619UL ) & 0xffffffffUL;
+  for ( i = 0; i < W_SCHEMANAME; i++ )
+    h = ( ( h ^ (unsigned char) entry->schemaname[i] ) * 16777619UL ) & 0xffffffffUL;
+  for ( i = 0; i < W_PASSWORD; i++ )
+    h = ( ( h ^ (unsigned char) entry->password[i] ) * 16777619UL ) & 0xffffffffUL;
+  return h;
+}
+
+/****************************************************************************
+  purpose : compare two crosscheck results on database and schemaname, used
+            by qsort and bsearch.
+****************************************************************************/
+int compareCheckResults( p1, p2 )
+const void *p1;
+const void *p2;
+{
+  int result = strncmp( ((CheckResult*)p1)->database,
+                        ((CheckResult*)p2)->database,
+                        W_DATABASE );
+  if ( !result )
+    result = strncmp( ((CheckResult*)p1)->schemaname,
+                      ((CheckResult*)p2)->schemaname,
+                      W_SCHEMANAME );
+  return result;
+}
+
+/****************************************************************************
+  purpose : read the crosscheck result cache, one line per result :
+            <database> <schemaname> <result> <checked> <generation>
+            <fingerprint>, after a line "run <started> <complete>" that
+            tells when the last crosscheck started and whether it completed.
+  pre     : results points to room for MAX_ENTRIES results.
+  post    : returns the number of results read, sorted. a missing or
+            unreadable cache has no results. started is 0 if unknown.
+****************************************************************************/
+int readCheckCache( results, started, complete )
+CheckResult *results;
+long *started;
+int *complete;
+{
+  char filename[W_REPOSNAME + sizeof( CHECKCACHE_SUFFIX )];
+  char line[W_DATABASE + W_SCHEMANAME + 4 * W_INTBUF];
+  FILE *file;
+  int  c = 0;
+
+  *started = 0;
+  *complete = 1;
+  snprintf( filename, sizeof( filename ), "%s%s", reposname, CHECKCACHE_SUFFIX );
+  file = fopen( filename, "r" );
+  if ( !file ) return 0;
+  if ( !fgets( line, sizeof( line ), file ) ||
+       strncmp( line, CHECKCACHE_MAGIC, strlen( CHECKCACHE_MAGIC ) ) != 0 )
+  {
+    fclose( file );
+    fprintf( stderr, "ignoring invalid crosscheck cache %s.\n", filename );
+    return 0;
+  }
+  while ( c < MAX_ENTRIES && fgets( line, sizeof( line ), file ) )
+  {
+    if ( sscanf( line, "run %ld %d", started, complete ) == 2 ) continue;
+    memset( &results[c], 0, sizeof( CheckResult ) );
+    if ( sscanf( line,
+                 "%63s %29s %d %ld %d %lx",
+                 results[c].database,
+                 results[c].schemaname,
+                 &results[c].result,
+                 &results[c].checked,
+                 &results[c].generation,
+                 &results[c].fingerprint ) == 6 ) c++;
+  }
+  fclose( file );
+  qsort( results, c, sizeof( CheckResult ), compareCheckResults );
+  return c;
+}
+
+/****************************************************************************
+  purpose : write the crosscheck result cache. results of combinations that
+            are no longer in the repository are dropped. the cache is
+            replaced atomically, a failure to write it is not fatal.
+            started and complete describe the running crosscheck.
+  pre     : readRepos
+****************************************************************************/
+void writeCheckCache( results, count, started, complete )
+CheckResult *results;
+int         count;
+long        started;
+int         complete;
+{
+  char filename[W_REPOSNAME + sizeof( CHECKCACHE_SUFFIX )];
+  char tempname[W_REPOSNAME + sizeof( CHECKCACHE_SUFFIX ) + 4];
+  FILE *file;
+  int  i, fd;
+
+  snprintf( filename, sizeof( filename ), "%s%s", reposname, CHECKCACHE_SUFFIX );
+  snprintf( tempname, sizeof( tempname ), "%s.new", filename );
+  fd = open( tempname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+  file = fd == -1 ? NULL : fdopen( fd, "w" );
+  if ( !file )
+  {
+    fprintf( stderr, "unable to open %s for writing.\n", tempname );
+    return;
+  }
+  fprintf( file, "%s\n", CHECKCACHE_MAGIC );
+  fprintf( file, "run %ld %d\n", started, complete );
+  for ( i = 0; i < count; i++ )
+    if ( reposFindCredential( repos, results[i].database,
+                              results[i].schemaname ) != -1 )
+      fprintf( file,
+               "%s %s %d %ld %d %lx\n",
+               results[i].database,
+               results[i].schemaname,
+               results[i].result,
+               results[i].checked,
+               results[i].generation,
+               results[i].fingerprint );
+  if ( fclose( file ) != 0 || rename( tempname, filename ) != 0 )
+  {
+    fprintf( stderr, "unable to write %s.\n", filename );
+    unlink( tempname );
+  }
+}
+
+/****************************************************************************
+  purpose : find the cached result of a (database, schemaname) combination
+            of the running crosscheck.
+  post    : returns NULL if there is none.
+****************************************************************************/
+CheckResult *findCheckResult( database, schemaname )
+char *database;
+char *schemaname;
+{
+  CheckResult lookfor, *found;
+  memset( &lookfor, 0, sizeof( lookfor ) );
+  strncpy( lookfor.database, database, W_DATABASE );
+  strncpy( lookfor.schemaname, schemaname, W_SCHEMANAME );
+  found = (CheckResult*) bsearch( &lookfor,
+                                  checkrun.results,
+                                  checkrun.sorted,
+                                  sizeof( CheckResult ),
+                                  compareCheckResults );
+  if ( found ) return found;
+  /* new results are appended unsorted */
+  for ( found = &checkrun.results[checkrun.sorted];
+        found < &checkrun.results[checkrun.count];
+        found++ )
+    if ( compareCheckResults( found, &lookfor ) == 0 ) return found;
+  return NULL;
+}
+
+/****************************************************************************
+  purpose : store the results of the completed checks in the cached
+            results of the running crosscheck, with the fingerprints of the
+            entries they checked. pending checks keep their cached result.
+****************************************************************************/
+void storeCheckResults( checks, fingerprints, count, checked )
+DBCheck *checks;
+unsigned long *fingerprints;
+int count;
+long checked;
+{
+  CheckResult *cached;
+  int         i;
+  for ( i = 0; i < count; i++ )
+  {
+    if ( checks[i].result == DBCHECK_PENDING ) continue;
+    cached = findCheckResult( checks[i].database, checks[i].schema );
+    if ( !cached ) continue;
+    cached->result = checks[i].result;
+    cached->checked = checked;
+    cached->generation = reposGeneration( repos );
+    cached->fingerprint = fingerprints[i];
+  }
+}
+
+/****************************************************************************
+  purpose : checkpoint of a running crosscheck, called by checkDBPasswords.
+            the results so far are written to the cache, so that an
+            interrupted crosscheck can be resumed.
+****************************************************************************/
+void checkpointCrossCheck( DBCheck *checks, int count )
+{
+  storeCheckResults( checks, checkrun.fingerprints, count, (long) time( 0 ) );
+  writeCheckCache( checkrun.results,
+                   checkrun.count,
+                   checkrun.started,
+                   0 );
+}
+
+/****************************************************************************
+  purpose : print the crosscheck results as text, an "ok" line per valid
+            combination, the oracle message and an "ERROR" line otherwise.
+****************************************************************************/
+void reportChecksText( checks, fromcache, count )
+DBCheck *checks;
+char *fromcache;
+int count;
+{
+  int i;
+  for ( i = 0; i < count; i++ )
+  {
+    if ( checks[i].result == DBCHECK_OK )
+      fprintf( stdout,
+               "entry %s@%s ok%s.\n",
+               checks[i].schema,
+               checks[i].database,
+               fromcache[i] ? " (cached)" : "" );
+    else
+    {
+      fflush( stdout );
+      fprintf( stderr, "%s", checks[i].message );
+      fprintf( stdout,
+               "ERROR: entry %s@%s %s.\n",
+               checks[i].schema,
+               checks[i].database,
+               checks[i].result == DBCHECK_TIMEOUT ? "timed out" :
+               checks[i].result == DBCHECK_UNVERIFIED ? "not verified" :
+               "invalid" );
+    }
+  }
+}
+
+/****************************************************************************
+  purpose : print a json member or csv field holding a number of
+            milliseconds, preceded by a separator. a negative number is
+            printed as json null or an empty csv field.
+****************************************************************************/
+void printMillis( name, ms )
+char *name;
+double ms;
+{
+  if ( options.format == FORMAT_CSV ) fprintf( stdout, "," );
+  else fprintf( stdout, ",\"%s\":", name );
+  if ( ms >= 0 ) fprintf( stdout, "%.3f", ms );
+  else
+  if ( options.format == FORMAT_JSON ) fprintf( stdout, "null" );
+}
+
+/****************************************************************************
+  purpose : print the crosscheck results as json lines or csv, one "check"
+            record per combination, followed by one "database" record per
+            database. the database record counts the checks per status and
+            adds up the time spent on that database : the attach, which is
+            shared, and the session begin and end of every check, or of the
+            monitor session when checked against verifiers. csv records all
+            have the same columns, those not applicable to a record are
+            empty.
+****************************************************************************/
+void reportChecks( checks, fromcache, count )
+DBCheck *checks;
+char *fromcache;
+int count;
+{
+  static char *status[] = { "invalid", "ok", "timeout", "unverified" };
+  static char *phase[] = { "env_ms", "attach_ms", "begin_ms", "end_ms" };
+  int    i, j, p, failed, cached;
+  double attach, begin, maxbegin, end;
+
+  if ( options.format == FORMAT_CSV )
+    fprintf( stdout,
+             "record,database,schema,status,oracode,message,"
+             "env_ms,attach_ms,begin_ms,end_ms,"
+             "checks,failed,cached,begin_max_ms,total_ms\n" );
+  for ( i = 0; i < count; i++ )
+  {
+    char *s = fromcache[i] ? "cached" :
+              checks[i].result >= DBCHECK_INVALID &&
+              checks[i].result <= DBCHECK_UNVERIFIED ?
+              status[checks[i].result] : "pending";
+    if ( options.format == FORMAT_CSV )
+    {
+      fprintf( stdout, "check," );
+      printQuoted( checks[i].database );
+      fprintf( stdout, "," );
+      printQuoted( checks[i].schema );
+      fprintf( stdout, ",%s,%d,", s, checks[i].oracode );
+      printQuoted( fromcache[i] ? "" : checks[i].message );
+    } else
+    {
+      fprintf( stdout, "{\"record\":\"check\",\"database\":" );
+      printQuoted( checks[i].database );
+      fprintf( stdout, ",\"schema\":" );
+      printQuoted( checks[i].schema );
+      fprintf( stdout,
+               ",\"status\":\"%s\",\"oracode\":%d,\"message\":",
+               s,
+               checks[i].oracode );
+      printQuoted( fromcache[i] ? "" : checks[i].message );
+    }
+    for ( p = 0; p < DBPHASES; p++ )
+      printMillis( phase[p], fromcache[i] ? -1 : checks[i].timing[p] );
+    if ( options.format == FORMAT_CSV ) fprintf( stdout, ",,,,,\n" );
+    else fprintf( stdout, "}\n" );
+  }
+
+  /* the checks are ordered by database */
+  for ( i = 0; i < count; i = j )
+  {
+    failed = 0;
+    cached = 0;
+    attach = -1;
+    begin = 0;
+    maxbegin = 0;
+    end = 0;
+    for ( j = i;
+          j < count && strcmp( checks[j].database, checks[i].database ) == 0;
+          j++ )
+    {
+      if ( fromcache[j] )
+      {
+        cached++;
+        continue;
+      }
+      if ( checks[j].result != DBCHECK_OK ) failed++;
+      if ( checks[j].timing[DBPHASE_ATTACH] >= 0 )
+        attach = checks[j].timing[DBPHASE_ATTACH];
+      if ( checks[j].timing[DBPHASE_BEGIN] > maxbegin )
+        maxbegin = checks[j].timing[DBPHASE_BEGIN];
+      /* checks against verifiers share the timing of the monitor session */
+      if ( checks[j].monitor )
+      {
+        begin = maxbegin;
+        end = checks[j].timing[DBPHASE_END] >= 0 ?
+              checks[j].timing[DBPHASE_END] : 0;
+        continue;
+      }
+      if ( checks[j].timing[DBPHASE_BEGIN] >= 0 )
+        begin += checks[j].timing[DBPHASE_BEGIN];
+      if ( checks[j].timing[DBPHASE_END] >= 0 )
+        end += checks[j].timing[DBPHASE_END];
+    }
+    if ( options.format == FORMAT_CSV )
+    {
+      fprintf( stdout, "database," );
+      printQuoted( checks[i].database );
+      fprintf( stdout, ",,,,," );
+      printMillis( phase[DBPHASE_ATTACH], attach );
+      fprintf( stdout, ",%.3f,%.3f,%d,%d,%d,%.3f,%.3f\n",
+               begin,
+               end,
+               j - i,
+               failed,
+               cached,
+               maxbegin,
+               ( attach >= 0 ? attach : 0 ) + begin + end );
+    } else
+    {
+      fprintf( stdout, "{\"record\":\"database\",\"database\":" );
+      printQuoted( checks[i].database );
+      fprintf( stdout,
+               ",\"checks\":%d,\"failed\":%d,\"cached\":%d",
+               j - i,
+               failed,
+               cached );
+      printMillis( phase[DBPHASE_ATTACH], attach );
+      fprintf( stdout,
+               ",\"begin_ms\":%.3f,\"begin_max_ms\":%.3f,\"end_ms\":%.3f"
+               ",\"total_ms\":%.3f}\n",
+               begin,
+               maxbegin,
+               end,
+               ( attach >= 0 ? attach : 0 ) + begin + end );
+    }
+  }
+}
+
+/****************************************************************************
+  purpose : check the distinct (database, schemaname) combinations of the
+            repository against the databases. if database is not NULL, only
+            that database is checked. the checks run concurrently, but are
+            reported in repository order. the results are kept in the
+            crosscheck cache. if options.maxage is not -1, a combination is
+            only checked when its cached result failed, is older than maxage
+            seconds, or when the entry changed since. the results are
+            checkpointed to the cache while the checks run; with
+            options.resume, combinations checked since the start of an
+            interrupted crosscheck are not checked again. if options.monitor is
+            set, databases for which the repository holds the password of
+            that schema are checked against their password verifiers.
+  pre     : readRepos, loadOraLibs unless useworker
+****************************************************************************/
+void crossCheck( database )
+char *database;
+{
+  static CheckResult results[MAX_ENTRIES];
+  CheckResult        *cached;
+  DBCheck            *checks, *todo;
+  const Entry        *e;
+  char               (*monitorpw)[W_PASSWORD + 1];
+  char               (*passwords)[W_PASSWORD + 1];
+  char               *curmonitor = NULL;
+  int                *origin;
+  unsigned long      *fingerprints;
+  char               *fromcache;
+  int                i, c, t, n, complete, resume;
+  long               started;
+  long               now = (long) time( 0 );
+
+  n = reposCount( repos );
+  checks = (DBCheck*) malloc( n * sizeof( DBCheck ) );
+  todo = (DBCheck*) malloc( n * sizeof( DBCheck ) );
+  origin = (int*) malloc( n * sizeof( int ) );
+  fingerprints = (unsigned long*) malloc( n * sizeof( unsigned long ) );
+  fromcache = (char*) malloc( n );
+  monitorpw = malloc( n * sizeof( *monitorpw ) );
+  passwords = malloc( n * sizeof( *passwords ) );
+  if ( !checks || !todo || !origin || !fingerprints || !fromcache ||
+       !monitorpw || !passwords )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    terminate();
+  }
+  checkrun.results = results;
+  checkrun.sorted = readCheckCache( results, &started, &complete );
+  checkrun.count = checkrun.sorted;
+  resume = options.resume && started > 0 && !complete;
+  checkrun.started = resume ? started : now;
+  checkrun.fingerprints = fingerprints;
+  c = 0;
+  t = 0;
+  for ( i = 0; i < n; i++ )
+  {
+    unsigned long fingerprint;
+    e = reposEntry( repos, i );
+    if ( database && strncmp( database, e->database, W_DATABASE ) )
+      continue;
+    if ( c > 0 &&
+         strncmp( checks[c-1].database, e->database, W_DATABASE ) == 0 &&
+         strncmp( checks[c-1].schema, e->schemaname, W_SCHEMANAME ) == 0 )
+      continue;
+    /* the monitor password is looked up at the first entry of a database */
+    if ( options.monitor[0] &&
+         ( c == 0 ||
+           strncmp( checks[c-1].database, e->database, W_DATABASE ) ) )
+    {
+      char monitordb[W_DATABASE + 1];
+      int  m;
+      snprintf( monitordb, sizeof( monitordb ), "%.*s",
+                W_DATABASE, e->database );
+      m = reposFindCredential( repos, monitordb, options.monitor );
+      curmonitor = NULL;
+      if ( m != -1 )
+      {
+        reposDecrypt( reposEntry( repos, m ), monitorpw[c] );
+        curmonitor = monitorpw[c];
+      }
+    }
+    fingerprint = entryFingerprint( e );
+    cached = findCheckResult( e->database, e->schemaname );
+    checks[c].database = (char*) e->database;
+    checks[c].schema = (char*) e->schemaname;
+    checks[c].passwd = passwords[c];
+    checks[c].monitor = curmonitor ? options.monitor : NULL;
+    checks[c].monitorpasswd = curmonitor;
+    checks[c].oracode = 0;
+    checks[c].message[0] = 0;
+    fromcache[c] = 0;
+    if ( resume && cached &&
+         cached->checked >= checkrun.started &&
+         cached->fingerprint == fingerprint )
+    {
+      /* checked by the interrupted crosscheck */
+      checks[c].result = cached->result;
+      if ( cached->result != DBCHECK_OK )
+        snprintf( checks[c].message,
+                  sizeof( checks[c].message ),
+                  "result of the interrupted crosscheck.\n" );
+      fromcache[c] = 1;
+    } else
+    if ( options.maxage >= 0 && cached &&
+         cached->result == DBCHECK_OK &&
+         now - cached->checked <= options.maxage &&
+         cached->fingerprint == fingerprint )
+    {
+      checks[c].result = DBCHECK_OK;
+      fromcache[c] = 1;
+    } else
+    {
+      if ( !cached && checkrun.count < MAX_ENTRIES )
+      {
+        cached = &results[checkrun.count++];
+        memset( cached, 0, sizeof( CheckResult ) );
+        strncpy( cached->database, e->database, W_DATABASE );
+        strncpy( cached->schemaname, e->schemaname, W_SCHEMANAME );
+      }
+      reposDecrypt( e, passwords[c] );
+      todo[t] = checks[c];
+      origin[t] = c;
+      fingerprints[t] = fingerprint;
+      t++;
+    }
+    c++;
+  }
+
+  if ( options.monitor[0] && !hashSelfTest() )
+  {
+    fprintf( stderr, "password verifier self test failed.\n" );
+    terminate();
+  }
+  /* the start of the crosscheck is recorded, then its progress */
+  writeCheckCache( results, checkrun.count, checkrun.started, 0 );
+  checkpoint = checkpointCrossCheck;
+  checkpointinterval = CHECKPOINT_INTERVAL;
+  workerCheckDBPasswords( todo, t, options.threads, options.deadline );
+  checkpoint = NULL;
+  memset( monitorpw, 0, n * sizeof( *monitorpw ) );
+  memset( passwords, 0, n * sizeof( *passwords ) );
+
+  for ( i = 0; i < t; i++ ) checks[origin[i]] = todo[i];
+  storeCheckResults( todo, fingerprints, t, now );
+  writeCheckCache( results, checkrun.count, checkrun.started, 1 );
+
+  if ( options.format == FORMAT_TEXT )
+    reportChecksText( checks, fromcache, c );
+  else
+    reportChecks( checks, fromcache, c );
+  free( passwords );
+  free( monitorpw );
+  free( fromcache );
+  free( fingerprints );
+  free( origin );
+  free( todo );
+  free( checks );
+}
+
 /****************************************************************************
   purpose : do a crosscheck between repository and database.
 ****************************************************************************/
@@ -1281,49 +2811,16 @@ void crossCheckAllDB( )
 {
   readRepos();
   isReposOwner();
-  loadOraLibs();
-  if ( header.entries > 0 )
+  if ( !useworker ) loadOraLibs();
+  if ( reposCount( repos ) > 0 )
   {
-    int i;
-
-    char prevdatabase[W_DATABASE];
-    char prevschemaname[W_SCHEMANAME];    
-    
-    fprintf( stdout, 
-             "checking repository %s.\n",
-             reposname );
-      
-    strncpy( prevdatabase, "", sizeof( prevdatabase ) );
-    strncpy( prevschemaname, "", sizeof( prevschemaname ) );        
-     
-    for (i = 0 ; i < header.entries ; i++ )
-    {
-      if ( strncmp( prevdatabase, entries[i].database, W_DATABASE ) != 0 ||
-           strncmp( prevdatabase, entries[i].database, W_DATABASE ) == 0 &&
-           strncmp( prevschemaname, entries[i].schemaname, W_SCHEMANAME ) != 0 )
-      {
-        strncpy( prevdatabase, 
-                 entries[i].database, 
-                 sizeof( prevdatabase ) );
-        strncpy( prevschemaname, 
-                 entries[i].schemaname, 
-                 sizeof( prevschemaname ) );              
-        cryptEntry( &entries[i] );                
-        if ( checkDBPassword( entries[i].database,
-                              entries[i].schemaname,
-                              entries[i].password )  )
-          fprintf( stdout,
-                   "entry %s@%s ok.\n",
-                   entries[i].schemaname,
-                   entries[i].database );
-        else                      
-          fprintf( stdout, 
-                   "ERROR: entry %s@%s invalid.\n",
-                   entries[i].schemaname,
-                   entries[i].database );
-      }  
-    }  
-  } else printf( "nothing to crosscheck.\n" );
+    if ( options.format == FORMAT_TEXT )
+      fprintf( stdout, 
+               "checking repository %s.\n",
+               reposname );
+    crossCheck( NULL );
+  } else
+  if ( options.format == FORMAT_TEXT ) printf( "nothing to crosscheck.\n" );
 }
 
 /****************************************************************************
@@ -1334,48 +2831,19 @@ char *database;
 {
   readRepos();
   isReposOwner();
-  loadOraLibs();
+  if ( !useworker ) loadOraLibs();
 
   strtoupper( database );
 
-  if ( header.entries > 0 )
+  if ( reposCount( repos ) > 0 )
   {
-    int i;
-
-    char prevschemaname[W_SCHEMANAME];    
-    
-    fprintf( stdout, 
-             "checking repository %s for database %s.\n",
-             reposname, database );
-      
-    strncpy( prevschemaname, "", sizeof( prevschemaname ) );        
-     
-    for (i = 0 ; i < header.entries ; i++ )
-    {
-      if ( strncmp( database, entries[i].database, W_DATABASE ) == 0 )
-      {
-	if ( strncmp( prevschemaname, entries[i].schemaname, W_SCHEMANAME ) != 0 )
-	{
-          strncpy( prevschemaname, 
-                   entries[i].schemaname, 
-                   sizeof( prevschemaname ) );              
-          cryptEntry( &entries[i] );                
-          if ( checkDBPassword( entries[i].database,
-                                entries[i].schemaname,
-                                entries[i].password )  )
-            fprintf( stdout,
-                     "entry %s@%s ok.\n",
-                     entries[i].schemaname,
-                     entries[i].database );
-          else               
-            fprintf( stdout, 
-                     "ERROR: entry %s@%s invalid.\n",
-                     entries[i].schemaname,
-                     entries[i].database );
-        }
-      }  
-    }  
-  } else printf( "nothing to crosscheck.\n" );
+    if ( options.format == FORMAT_TEXT )
+      fprintf( stdout, 
+               "checking repository %s for database %s.\n",
+               reposname, database );
+    crossCheck( database );
+  } else
+  if ( options.format == FORMAT_TEXT ) printf( "nothing to crosscheck.\n" );
 }
 
 /****************************************************************************
@@ -1399,10 +2867,22 @@ char *filename;
                errno );
       terminate();
     }
-    strncpy( header.logfile, filename, sizeof( header.logfile ) );
+    logReadSummary( 1 );
+    if ( reposSetLog( repos,
+                      filename,
+                      options.loglevel,
+                      options.loginterval ) != REPOS_OK )
+    {
+      fprintf( stderr,
+               "log file name too long (max %d chars).\n",
+               W_LOGFILE - 1 );
+      terminate();
+    }
     logLine( 0, "logging enabled" );    
     writeRepos();
-    printf( "logging enabled to %s.\n", header.logfile );
+    printf( "logging enabled to %s (level %s).\n",
+            reposLogfile( repos ),
+            LOG_LEVELS[reposLogLevel( repos )] );
   } else
   {
     fprintf( stderr, "unable to open %s for append.\n", filename );
@@ -1417,12 +2897,173 @@ void disableLog()
 {
   readRepos();
   isReposOwner();
+  logReadSummary( 1 );
   logLine( 0, "logging disabled." );  
-  strncpy( header.logfile , "", 1 );
-  printf( "logging disabled.\n", header.logfile );  
+  reposSetLog( repos, "", -1, -1 );
+  printf( "logging disabled.\n" );  
+  writeRepos();
+}
+
+
+/****************************************************************************
+  purpose : enable the views of the repository: a file per osuser next to
+            the repository, with only the entries of that osuser, that
+            opr -r reads instead of the repository.
+  post    : the views are written, and kept up to date by every write of
+            the repository from now on.
+****************************************************************************/
+void enableViews()
+{
+  readRepos();
+  isReposOwner();
+  reposSetViews( repos, 1 );
+  writeRepos();
+  logLine( 0, "views enabled" );
+  printf( "views enabled in %s%s.\n", reposname, VIEWS_SUFFIX );
+}
+
+/****************************************************************************
+  purpose : disable the views of the repository, removing them.
+****************************************************************************/
+void disableViews()
+{
+  readRepos();
+  isReposOwner();
+  reposSetViews( repos, 0 );
   writeRepos();
+  logLine( 0, "views disabled" );
+  printf( "views disabled.\n" );
+}
+
+/****************************************************************************
+  purpose : remove the --name=value options from argv and store them in
+            the global options.
+  post    : returns the number of remaining arguments, -1 if an option is
+            unknown or has an invalid value.
+****************************************************************************/
+int parseOptions( argc, argv )
+int argc;
+char *argv[];
+{
+  int i, n;
+  n = 2;
+  for ( i = 2; i < argc; i++ )
+  {
+    if ( strncmp( argv[i], "--", 2 ) != 0 )
+    {
+      argv[n++] = argv[i];
+      continue;
+    }
+    if ( strncmp( argv[i], "--threads=", 10 ) == 0 )
+    {
+      options.threads = atoi( argv[i] + 10 );
+      if ( options.threads < 1 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--deadline=", 11 ) == 0 )
+    {
+      options.deadline = atoi( argv[i] + 11 );
+      if ( options.deadline < 0 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--max-age=", 10 ) == 0 )
+    {
+      options.maxage = atoi( argv[i] + 10 );
+      if ( options.maxage < 0 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--format=", 9 ) == 0 )
+    {
+      if ( strcmp( argv[i] + 9, "text" ) == 0 ) options.format = FORMAT_TEXT;
+      else
+      if ( strcmp( argv[i] + 9, "json" ) == 0 ) options.format = FORMAT_JSON;
+      else
+      if ( strcmp( argv[i] + 9, "csv" ) == 0 ) options.format = FORMAT_CSV;
+      else
+      if ( strcmp( argv[i] + 9, "tsv" ) == 0 ) options.format = FORMAT_TSV;
+      else return -1;
+    } else
+    if ( strncmp( argv[i], "--verifiers=", 12 ) == 0 )
+    {
+      if ( strlen( argv[i] + 12 ) < 1 ||
+           strlen( argv[i] + 12 ) >= W_SCHEMANAME ) return -1;
+      strncpy( options.monitor, argv[i] + 12, W_SCHEMANAME );
+      strtolower( options.monitor );
+    } else
+    if ( strncmp( argv[i], "--per-db=", 9 ) == 0 )
+    {
+      dbthreads = atoi( argv[i] + 9 );
+      if ( dbthreads < 1 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--rate=", 7 ) == 0 )
+    {
+      loginrate = atof( argv[i] + 7 );
+      if ( loginrate <= 0 ) return -1;
+    } else
+    if ( strcmp( argv[i], "--resume" ) == 0 )
+    {
+      options.resume = 1;
+    } else
+    if ( strcmp( argv[i], "--worker" ) == 0 )
+    {
+      useworker = 1;
+    } else
+    if ( strncmp( argv[i], "--worker-idle=", 14 ) == 0 )
+    {
+      workeridle = atoi( argv[i] + 14 );
+      if ( workeridle < 1 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--attach-timeout=", 17 ) == 0 )
+    {
+      attachtimeout = atoi( argv[i] + 17 );
+      if ( attachtimeout < 0 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--login-timeout=", 16 ) == 0 )
+    {
+      logintimeout = atoi( argv[i] + 16 );
+      if ( logintimeout < 0 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--change-timeout=", 17 ) == 0 )
+    {
+      changetimeout = atoi( argv[i] + 17 );
+      if ( changetimeout < 0 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--log-level=", 12 ) == 0 )
+    {
+      for ( options.loglevel = LOG_SUMMARY;
+            options.loglevel >= 0 &&
+            strcmp( argv[i] + 12, LOG_LEVELS[options.loglevel] ) != 0;
+            options.loglevel-- );
+      if ( options.loglevel < 0 ) return -1;
+    } else
+    if ( strncmp( argv[i], "--log-interval=", 15 ) == 0 )
+    {
+      options.loginterval = atoi( argv[i] + 15 );
+      if ( options.loginterval < 1 ) return -1;
+    } else return -1;
+  }
+  argv[n] = NULL;
+  return n;
 }
 
+/****************************************************************************
+  purpose : the name of the operation of a command line switch, for the log.
+            returns an empty string for unknown switches.
+****************************************************************************/
+char *operationName( option )
+char *option;
+{
+  static char *names[][2] = {
+    { "-c", "create" }, { "-r", "read" }, { "-a", "add" },
+    { "-d", "delete" }, { "-D", "delete" }, { "-m", "modify" }, { "-M", "modify" },
+    { "--rotate", "rotate" }, { "-e", "export" }, { "-i", "import" },
+    { "-x", "crosscheck" }, { "-g", "log" }, { "+g", "log" },
+    { "-v", "views" }, { "+v", "views" },
+    { "-l", "list" }, { "--metrics", "metrics" },
+    { "--lock-status", "lock-status" }, { "--usage", "usage" },
+    { "--prune", "prune" }, { "--stats", "stats" } };
+  int i;
+  for ( i = 0; i < sizeof( names ) / sizeof( names[0] ); i++ )
+    if ( strcmp( option, names[i][0] ) == 0 ) return names[i][1];
+  return "";
+}
 
 /****************************************************************************
   purpose : main function.
@@ -1431,10 +3072,29 @@ int main(argc,argv)
 int argc;
 char *argv[];
 {
+  unsigned long long t;
+  traceStart();
+  started = metricsClock();
+  t = traceClock();
   getEnvironment();
+  traceSince( T_ENV, t );
+  openRepositoryMetrics();
+  t = traceClock();
   osUserName();
+  traceSince( T_OSUSER, t );
+  workerprogram = argv[0];
+  if ( argc > 1 ) argc = parseOptions( argc, argv );
   if ( argc > 1 )
   {
+    operation = operationName( argv[1] );
+    auditOperation( operation );
+    traceOperation( operation );
+    /* opr --worker-serve, started by --worker */
+    if ( strcmp( argv[1], "--worker-serve" ) == 0 )
+    {
+      if ( argc == 2 ) runWorker();
+        else printHelp();
+    } else
     /* opr -c */
     if ( strncmp( argv[1], "-c", 2 ) == 0 )
     {
@@ -1465,6 +3125,25 @@ char *argv[];
       if ( argc == 5 ) deleteEntry( argv[2], argv[3], argv[4] );
         else printHelp();
     } else
+    /* opr -D <osuser> */
+    if ( strncmp( argv[1], "-D", 2 ) == 0 )
+    {
+      if ( argc == 3 ) deleteUser( argv[2] );
+        else printHelp();
+    } else
+    /* opr -M <schemaname> <database> [<database> ...] */
+    if ( strncmp( argv[1], "-M", 2 ) == 0 )
+    {
+      if ( argc >= 4 ) modifyEntries( argv[2], argv + 3, argc - 3 );
+        else printHelp();
+    } else
+    /* opr --rotate <database> [<schemaname>] */
+    if ( strcmp( argv[1], "--rotate" ) == 0 )
+    {
+      if ( argc == 3 ) rotatePasswords( argv[2], NULL );
+      else if ( argc == 4 ) rotatePasswords( argv[2], argv[3] );
+        else printHelp();
+    } else
     /* opr -m <database> <schemaname> */
     if ( strncmp( argv[1], "-m", 2 ) == 0 )
     {
@@ -1486,6 +3165,8 @@ char *argv[];
     /* opr -x <filename> */
     if ( strncmp( argv[1], "-x", 2 ) == 0 )
     {
+      if ( options.format == FORMAT_TSV ) printHelp();
+      else
       if ( argc == 2 ) crossCheckAllDB();
       else if ( argc == 3 ) crossCheckSingleDB( argv[2] );
         else printHelp();
@@ -1502,13 +3183,59 @@ char *argv[];
       if ( argc == 3 ) enableLog(argv[2]);
         else printHelp();
     } else
-    /* opr -l */
+    /* opr -v */
+    if ( strncmp( argv[1], "-v", 2 ) == 0 )
+    {
+      if ( argc == 2 ) disableViews();
+        else printHelp();
+    } else
+    /* opr +v */
+    if ( strncmp( argv[1], "+v", 2 ) == 0 )
+    {
+      if ( argc == 2 ) enableViews();
+        else printHelp();
+    } else
+    /* opr -l [<database> [<schemaname> [<osuser>]]] */
     if ( strncmp( argv[1], "-l", 2 ) == 0 )
     {
-      if ( argc == 2 ) listEntries();
+      if ( argc <= 5 ) listEntries( argc > 2 ? argv[2] : NULL,
+                                    argc > 3 ? argv[3] : NULL,
+                                    argc > 4 ? argv[4] : NULL );
+        else printHelp();
+    } else
+    /* opr --metrics */
+    if ( strcmp( argv[1], "--metrics" ) == 0 )
+    {
+      if ( argc == 2 ) printRepositoryMetrics();
+        else printHelp();
+    } else
+    /* opr --lock-status */
+    if ( strcmp( argv[1], "--lock-status" ) == 0 )
+    {
+      if ( argc == 2 ) printLockHolders();
+        else printHelp();
+    } else
+    /* opr --usage */
+    if ( strcmp( argv[1], "--usage" ) == 0 )
+    {
+      if ( argc == 2 ) listUsage();
+        else printHelp();
+    } else
+    /* opr --prune <days> */
+    if ( strcmp( argv[1], "--prune" ) == 0 )
+    {
+      if ( argc == 3 ) pruneEntries( argv[2] );
+        else printHelp();
+    } else
+    /* opr --stats */
+    if ( strcmp( argv[1], "--stats" ) == 0 )
+    {
+      if ( argc == 2 ) printStats();
         else printHelp();
     } else printHelp();
   } else printHelp();
+  countOperation( operation, 0 );
+  leave( 0 );
   return 0;
 }
 
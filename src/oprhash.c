@@ -0,0 +1,522 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <strings.h>
+#include "oprhash.h"
+
+/* maximum length of a password that is checked against a verifier */
+#define MAX_PASSWD 128
+
+/* salt sizes of the 11g (S:) and 12c (T:) verifiers */
+#define S_SALT 10
+#define T_SALT 16
+
+/* PBKDF2 iteration count and salt suffix of the 12c (T:) verifier */
+#define T_ITERATIONS 4096
+#define T_SALT_SUFFIX "AUTH_PBKDF2_SPEEDY_KEY"
+
+/****************************************************************************
+SHA-1 (FIPS 180-4) state.
+****************************************************************************/
+typedef struct {
+  uint32_t      h[5];
+  uint64_t      length;
+  unsigned char block[64];
+  size_t        used;
+} Sha1;
+
+/****************************************************************************
+SHA-512 (FIPS 180-4) state.
+****************************************************************************/
+typedef struct {
+  uint64_t      h[8];
+  uint64_t      length;
+  unsigned char block[128];
+  size_t        used;
+} Sha512;
+
+static const uint64_t k512[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+  0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+  0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+  0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+  0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+  0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+  0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+  0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+  0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+  0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+  0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+  0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+  0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+  0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+  0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+  0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+  0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+  0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+  0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+  0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+  0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+#define ROL32( x, n ) ( ( (x) << (n) ) | ( (x) >> ( 32 - (n) ) ) )
+#define ROR64( x, n ) ( ( (x) >> (n) ) | ( (x) << ( 64 - (n) ) ) )
+
+/****************************************************************************
+process one 64 byte block.
+****************************************************************************/
+static void sha1Block( Sha1                *ctx,
+                       const unsigned char *p )
+{
+  uint32_t w[80], a, b, c, d, e, t;
+  int      i;
+  for ( i = 0; i < 16; i++ )
+    w[i] = (uint32_t) p[4*i] << 24 | (uint32_t) p[4*i+1] << 16 |
+           (uint32_t) p[4*i+2] << 8 | (uint32_t) p[4*i+3];
+  for ( i = 16; i < 80; i++ )
+    w[i] = ROL32( w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1 );
+  a = ctx->h[0]; b = ctx->h[1]; c = ctx->h[2]; d = ctx->h[3]; e = ctx->h[4];
+  for ( i = 0; i < 80; i++ )
+  {
+    if ( i < 20 )
+      t = ( ( b & c ) | ( ~b & d ) ) + 0x5a827999;
+    else if ( i < 40 )
+      t = ( b ^ c ^ d ) + 0x6ed9eba1;
+    else if ( i < 60 )
+      t = ( ( b & c ) | ( b & d ) | ( c & d ) ) + 0x8f1bbcdc;
+    else
+      t = ( b ^ c ^ d ) + 0xca62c1d6;
+    t += ROL32( a, 5 ) + e + w[i];
+    e = d; d = c; c = ROL32( b, 30 ); b = a; a = t;
+  }
+  ctx->h[0] += a; ctx->h[1] += b; ctx->h[2] += c; ctx->h[3] += d; ctx->h[4] += e;
+}
+
+static void sha1Init( Sha1 *ctx )
+{
+  ctx->h[0] = 0x67452301;
+  ctx->h[1] = 0xefcdab89;
+  ctx->h[2] = 0x98badcfe;
+  ctx->h[3] = 0x10325476;
+  ctx->h[4] = 0xc3d2e1f0;
+  ctx->length = 0;
+  ctx->used = 0;
+}
+
+static void sha1Update( Sha1                *ctx,
+                        const unsigned char *data,
+                        size_t              len )
+{
+  ctx->length += len;
+  while ( len > 0 )
+  {
+    size_t n = sizeof( ctx->block ) - ctx->used;
+    if ( n > len ) n = len;
+    memcpy( ctx->block + ctx->used, data, n );
+    ctx->used += n;
+    data += n;
+    len -= n;
+    if ( ctx->used == sizeof( ctx->block ) )
+    {
+      sha1Block( ctx, ctx->block );
+      ctx->used = 0;
+    }
+  }
+}
+
+static void sha1Final( Sha1          *ctx,
+                       unsigned char *digest )
+{
+  uint64_t bits = ctx->length * 8;
+  int      i;
+  ctx->block[ctx->used++] = 0x80;
+  if ( ctx->used > 56 )
+  {
+    memset( ctx->block + ctx->used, 0, 64 - ctx->used );
+    sha1Block( ctx, ctx->block );
+    ctx->used = 0;
+  }
+  memset( ctx->block + ctx->used, 0, 56 - ctx->used );
+  for ( i = 0; i < 8; i++ )
+    ctx->block[56+i] = (unsigned char) ( bits >> ( 56 - 8 * i ) );
+  sha1Block( ctx, ctx->block );
+  for ( i = 0; i < 20; i++ )
+    digest[i] = (unsigned char) ( ctx->h[i/4] >> ( 24 - 8 * ( i % 4 ) ) );
+}
+
+/****************************************************************************
+process one 128 byte block.
+****************************************************************************/
+static void sha512Block( Sha512              *ctx,
+                         const unsigned char *p )
+{
+  uint64_t w[80], a, b, c, d, e, f, g, h, t1, t2;
+  int      i, j;
+  for ( i = 0; i < 16; i++ )
+  {
+    w[i] = 0;
+    for ( j = 0; j < 8; j++ )
+      w[i] = ( w[i] << 8 ) | p[8*i+j];
+  }
+  for ( i = 16; i < 80; i++ )
+    w[i] = ( ROR64( w[i-2], 19 ) ^ ROR64( w[i-2], 61 ) ^ ( w[i-2] >> 6 ) ) +
+           w[i-7] +
+           ( ROR64( w[i-15], 1 ) ^ ROR64( w[i-15], 8 ) ^ ( w[i-15] >> 7 ) ) +
+           w[i-16];
+  a = ctx->h[0]; b = ctx->h[1]; c = ctx->h[2]; d = ctx->h[3];
+  e = ctx->h[4]; f = ctx->h[5]; g = ctx->h[6]; h = ctx->h[7];
+  for ( i = 0; i < 80; i++ )
+  {
+    t1 = h + ( ROR64( e, 14 ) ^ ROR64( e, 18 ) ^ ROR64( e, 41 ) ) +
+         ( ( e & f ) ^ ( ~e & g ) ) + k512[i] + w[i];
+    t2 = ( ROR64( a, 28 ) ^ ROR64( a, 34 ) ^ ROR64( a, 39 ) ) +
+         ( ( a & b ) ^ ( a & c ) ^ ( b & c ) );
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  ctx->h[0] += a; ctx->h[1] += b; ctx->h[2] += c; ctx->h[3] += d;
+  ctx->h[4] += e; ctx->h[5] += f; ctx->h[6] += g; ctx->h[7] += h;
+}
+
+static void sha512Init( Sha512 *ctx )
+{
+  ctx->h[0] = 0x6a09e667f3bcc908ULL;
+  ctx->h[1] = 0xbb67ae8584caa73bULL;
+  ctx->h[2] = 0x3c6ef372fe94f82bULL;
+  ctx->h[3] = 0xa54ff53a5f1d36f1ULL;
+  ctx->h[4] = 0x510e527fade682d1ULL;
+  ctx->h[5] = 0x9b05688c2b3e6c1fULL;
+  ctx->h[6] = 0x1f83d9abfb41bd6bULL;
+  ctx->h[7] = 0x5be0cd19137e2179ULL;
+  ctx->length = 0;
+  ctx->used = 0;
+}
+
+static void sha512Update( Sha512              *ctx,
+                          const unsigned char *data,
+                          size_t              len )
+{
+  ctx->length += len;
+  while ( len > 0 )
+  {
+    size_t n = sizeof( ctx->block ) - ctx->used;
+    if ( n > len ) n = len;
+    memcpy( ctx->block + ctx->used, data, n );
+    ctx->used += n;
+    data += n;
+    len -= n;
+    if ( ctx->used == sizeof( ctx->block ) )
+    {
+      sha512Block( ctx, ctx->block );
+      ctx->used = 0;
+    }
+  }
+}
+
+static void sha512Final( Sha512        *ctx,
+                         unsigned char *digest )
+{
+  uint64_t bits = ctx->length * 8;
+  int      i;
+  ctx->block[ctx->used++] = 0x80;
+  if ( ctx->used > 112 )
+  {
+    memset( ctx->block + ctx->used, 0, 128 - ctx->used );
+    sha512Block( ctx, ctx->block );
+    ctx->used = 0;
+  }
+  /* the upper 64 bits of the 128 bit length are always 0 here */
+  memset( ctx->block + ctx->used, 0, 120 - ctx->used );
+  for ( i = 0; i < 8; i++ )
+    ctx->block[120+i] = (unsigned char) ( bits >> ( 56 - 8 * i ) );
+  sha512Block( ctx, ctx->block );
+  for ( i = 0; i < 64; i++ )
+    digest[i] = (unsigned char) ( ctx->h[i/8] >> ( 56 - 8 * ( i % 8 ) ) );
+}
+
+/****************************************************************************
+  purpose: compute the SHA-1 digest of data.
+****************************************************************************/
+void sha1( const unsigned char *data,
+           size_t              len,
+           unsigned char       *digest )
+{
+  Sha1 ctx;
+  sha1Init( &ctx );
+  sha1Update( &ctx, data, len );
+  sha1Final( &ctx, digest );
+}
+
+/****************************************************************************
+  purpose: compute the SHA-512 digest of data.
+****************************************************************************/
+void sha512( const unsigned char *data,
+             size_t              len,
+             unsigned char       *digest )
+{
+  Sha512 ctx;
+  sha512Init( &ctx );
+  sha512Update( &ctx, data, len );
+  sha512Final( &ctx, digest );
+}
+
+/****************************************************************************
+  purpose: derive outlen bytes from pass and salt with PBKDF2 (RFC 8018),
+           using HMAC-SHA512. the inner and outer HMAC states are computed
+           once, so that each iteration costs two block operations.
+****************************************************************************/
+void pbkdf2Sha512( const unsigned char *pass,
+                   size_t              passlen,
+                   const unsigned char *salt,
+                   size_t              saltlen,
+                   unsigned long       iterations,
+                   unsigned char       *out,
+                   size_t              outlen )
+{
+  Sha512        inner, outer, ctx;
+  unsigned char key[128], pad[128], u[SHA512_SIZE], t[SHA512_SIZE];
+  unsigned char counter[4];
+  unsigned long block, i;
+  size_t        j, n;
+
+  memset( key, 0, sizeof( key ) );
+  if ( passlen > sizeof( key ) )
+    sha512( pass, passlen, key );
+  else
+    memcpy( key, pass, passlen );
+  for ( j = 0; j < sizeof( pad ); j++ ) pad[j] = key[j] ^ 0x36;
+  sha512Init( &inner );
+  sha512Update( &inner, pad, sizeof( pad ) );
+  for ( j = 0; j < sizeof( pad ); j++ ) pad[j] = key[j] ^ 0x5c;
+  sha512Init( &outer );
+  sha512Update( &outer, pad, sizeof( pad ) );
+
+  for ( block = 1; outlen > 0; block++ )
+  {
+    counter[0] = (unsigned char) ( block >> 24 );
+    counter[1] = (unsigned char) ( block >> 16 );
+    counter[2] = (unsigned char) ( block >> 8 );
+    counter[3] = (unsigned char) block;
+    ctx = inner;
+    sha512Update( &ctx, salt, saltlen );
+    sha512Update( &ctx, counter, sizeof( counter ) );
+    sha512Final( &ctx, u );
+    ctx = outer;
+    sha512Update( &ctx, u, sizeof( u ) );
+    sha512Final( &ctx, u );
+    memcpy( t, u, sizeof( t ) );
+    for ( i = 1; i < iterations; i++ )
+    {
+      ctx = inner;
+      sha512Update( &ctx, u, sizeof( u ) );
+      sha512Final( &ctx, u );
+      ctx = outer;
+      sha512Update( &ctx, u, sizeof( u ) );
+      sha512Final( &ctx, u );
+      for ( j = 0; j < sizeof( t ); j++ ) t[j] ^= u[j];
+    }
+    n = outlen < sizeof( t ) ? outlen : sizeof( t );
+    memcpy( out, t, n );
+    out += n;
+    outlen -= n;
+  }
+}
+
+/****************************************************************************
+  purpose: decode len bytes from hexadecimal.
+  post   : returns 1 if hex holds 2 * len valid hex digits, 0 otherwise.
+****************************************************************************/
+static int unhex( const char    *hex,
+                  unsigned char *bytes,
+                  size_t        len )
+{
+  size_t i;
+  int    hi, lo;
+  for ( i = 0; i < len; i++ )
+  {
+    if ( sscanf( hex + 2 * i, "%1x%1x", &hi, &lo ) != 2 ) return 0;
+    bytes[i] = (unsigned char) ( hi << 4 | lo );
+  }
+  return 1;
+}
+
+/****************************************************************************
+  purpose: check passwd against an 11g verifier, the hex encoded
+           SHA1( passwd || salt ) followed by the hex encoded salt.
+****************************************************************************/
+static int checkS( const char *verifier,
+                   const char *passwd )
+{
+  unsigned char expect[SHA1_SIZE], digest[SHA1_SIZE];
+  unsigned char buffer[MAX_PASSWD + S_SALT];
+  size_t        len = strlen( passwd );
+  if ( len > MAX_PASSWD ||
+       !unhex( verifier, expect, SHA1_SIZE ) ||
+       !unhex( verifier + 2 * SHA1_SIZE, buffer + len, S_SALT ) )
+    return VERIFIER_NONE;
+  memcpy( buffer, passwd, len );
+  sha1( buffer, len + S_SALT, digest );
+  return memcmp( expect, digest, SHA1_SIZE ) == 0 ? VERIFIER_MATCH
+                                                  : VERIFIER_MISMATCH;
+}
+
+/****************************************************************************
+  purpose: check passwd against a 12c verifier, the hex encoded
+           SHA512( PBKDF2( passwd, salt || T_SALT_SUFFIX ) || salt )
+           followed by the hex encoded salt.
+****************************************************************************/
+static int checkT( const char *verifier,
+                   const char *passwd )
+{
+  unsigned char expect[SHA512_SIZE], digest[SHA512_SIZE];
+  unsigned char salt[T_SALT + sizeof( T_SALT_SUFFIX )];
+  unsigned char buffer[SHA512_SIZE + T_SALT];
+  if ( !unhex( verifier, expect, SHA512_SIZE ) ||
+       !unhex( verifier + 2 * SHA512_SIZE, salt, T_SALT ) )
+    return VERIFIER_NONE;
+  memcpy( salt + T_SALT, T_SALT_SUFFIX, strlen( T_SALT_SUFFIX ) );
+  pbkdf2Sha512( (const unsigned char*) passwd,
+                strlen( passwd ),
+                salt,
+                T_SALT + strlen( T_SALT_SUFFIX ),
+                T_ITERATIONS,
+                buffer,
+                SHA512_SIZE );
+  memcpy( buffer + SHA512_SIZE, salt, T_SALT );
+  sha512( buffer, sizeof( buffer ), digest );
+  return memcmp( expect, digest, SHA512_SIZE ) == 0 ? VERIFIER_MATCH
+                                                    : VERIFIER_MISMATCH;
+}
+
+/****************************************************************************
+  purpose: check a password against the verifiers of a database user, as
+           stored in sys.user$.spare4, for example "S:...;T:...". the 12c
+           (T:) verifier is preferred over the 11g (S:) verifier.
+  post   : returns VERIFIER_MATCH, VERIFIER_MISMATCH, or VERIFIER_NONE when
+           there is no usable verifier.
+****************************************************************************/
+int checkVerifier( const char *verifiers,
+                   const char *passwd )
+{
+  const char *s = NULL;
+  const char *t = NULL;
+  const char *p;
+  for ( p = verifiers; p && *p; )
+  {
+    if ( strncmp( p, "T:", 2 ) == 0 ) t = p + 2;
+    if ( strncmp( p, "S:", 2 ) == 0 ) s = p + 2;
+    p = strchr( p, ';' );
+    if ( p ) p++;
+  }
+  if ( t ) return checkT( t, passwd );
+  if ( s ) return checkS( s, passwd );
+  return VERIFIER_NONE;
+}
+
+/****************************************************************************
+  purpose: compare a digest with its expected hex encoding.
+****************************************************************************/
+static int sameHex( const unsigned char *digest,
+                    size_t              len,
+                    const char          *hex )
+{
+  unsigned char expect[SHA512_SIZE];
+  return unhex( hex, expect, len ) && memcmp( digest, expect, len ) == 0;
+}
+
+/****************************************************************************
+  purpose: check the hash functions against known test vectors: FIPS 180
+           for SHA-1 and SHA-512, the common PBKDF2-HMAC-SHA512 vectors, and
+           verifiers for the password "tiger".
+  post   : returns 1 if all vectors pass, 0 otherwise.
+****************************************************************************/
+int hashSelfTest()
+{
+  unsigned char digest[SHA512_SIZE];
+  const char    *abc = "abc";
+  const char    *long512 = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklm"
+                           "ghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrs"
+                           "mnopqrstnopqrstu";
+  int           ok = 1;
+
+  sha1( (const unsigned char*) abc, 3, digest );
+  ok = ok && sameHex( digest, SHA1_SIZE,
+                      "a9993e364706816aba3e25717850c26c9cd0d89d" );
+  sha512( (const unsigned char*) abc, 3, digest );
+  ok = ok && sameHex( digest, SHA512_SIZE,
+                      "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                      "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" );
+  sha512( (const unsigned char*) long512, strlen( long512 ), digest );
+  ok = ok && sameHex( digest, SHA512_SIZE,
+                      "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+                      "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" );
+  pbkdf2Sha512( (const unsigned char*) "password", 8,
+                (const unsigned char*) "salt", 4, 1, digest, SHA512_SIZE );
+  ok = ok && sameHex( digest, SHA512_SIZE,
+                      "867f70cf1ade02cff3752599a3a53dc4af34c7a669815ae5d513554e1c8cf252"
+                      "c02d470a285a0501bad999bfe943c08f050235d7d68b1da55e63f73b60a57fce" );
+  pbkdf2Sha512( (const unsigned char*) "password", 8,
+                (const unsigned char*) "salt", 4, 2, digest, SHA512_SIZE );
+  ok = ok && sameHex( digest, SHA512_SIZE,
+                      "e1d9c16aa681708a45f5c7c4e215ceb66e011a2e9f0040713f18aefdb866d53c"
+                      "f76cab2868a39b9f7840edce4fef5a82be67335c77a6068e04112754f27ccf4e" );
+  ok = ok && checkVerifier( "S:C0F4D97D5494ED963959861158A60F7A5469E67D"
+                            "4C5E8B2F1A9D3E7B6C01", "tiger" ) == VERIFIER_MATCH;
+  ok = ok && checkVerifier( "S:C0F4D97D5494ED963959861158A60F7A5469E67D"
+                            "4C5E8B2F1A9D3E7B6C01", "Tiger" ) == VERIFIER_MISMATCH;
+  ok = ok && checkVerifier( "S:C0F4D97D5494ED963959861158A60F7A5469E67D"
+                            "4C5E8B2F1A9D3E7B6C01;T:6BF1DDD7DF3AF404E6A6EE7AC"
+                            "86B43EB52464C456F20C83785369D45E27B20D486A43E07CFF"
+                            "8E1E2D43DA972119F522F1974F71E5BA6BD5C922749A6064BF"
+                            "6F99A1B2C3D4E5F60718293A4B5C6D7E8F9",
+                            "tiger" ) == VERIFIER_MATCH;
+  ok = ok && checkVerifier( "H:0123456789ABCDEF", "tiger" ) == VERIFIER_NONE;
+  return ok;
+}
@@ -0,0 +1,60 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRHASH_H
+#define _OPRHASH_H 1
+
+#include <stddef.h>
+
+/* digest sizes in bytes */
+#define SHA1_SIZE   20
+#define SHA512_SIZE 64
+
+/* results of checkVerifier */
+#define VERIFIER_NONE     -1
+#define VERIFIER_MISMATCH  0
+#define VERIFIER_MATCH     1
+
+void sha1( const unsigned char *data,
+           size_t              len,
+           unsigned char       *digest );
+
+void sha512( const unsigned char *data,
+             size_t              len,
+             unsigned char       *digest );
+
+void pbkdf2Sha512( const unsigned char *pass,
+                   size_t              passlen,
+                   const unsigned char *salt,
+                   size_t              saltlen,
+                   unsigned long       iterations,
+                   unsigned char       *out,
+                   size_t              outlen );
+
+int checkVerifier( const char *verifiers,
+                   const char *passwd );
+
+int hashSelfTest();
+
+#endif // !_OPRHASH_H
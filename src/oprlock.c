@@ -0,0 +1,313 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysmacros.h>
+#include "oprmap.h"
+#include "oprmetrics.h"
+#include "oprlock.h"
+
+/* first bytes of the lock waiters sidecar */
+#define WAITERS_MAGIC "OraclePasswordRepository locks 1"
+
+/* number of processes that can be listed as waiting at the same time */
+#define WAITER_SLOTS 64
+
+/* the list of lock holders kept by the kernel, on linux */
+#define PROC_LOCKS "/proc/locks"
+
+/****************************************************************************
+a process waiting for the repository lock. a slot is free while pid is 0
+or the pid of a process that no longer exists, a waiter claims it by setting
+pid. since is on the monotonic clock, in
+microseconds.
+****************************************************************************/
+typedef struct {
+  int32_t  pid;
+  int32_t  type;
+  int32_t  retries;
+  int32_t  holder;
+  int32_t  holdertype;
+  int32_t  unused;
+  uint64_t since;
+  char     command[W_LOCKCOMMAND];
+} Waiter;
+
+/****************************************************************************
+the lock waiters sidecar.
+****************************************************************************/
+typedef struct {
+  char   magic[32];
+  Waiter slots[WAITER_SLOTS];
+} Waiters;
+
+/* the waiters sidecar and the slot of this process, while waiting */
+static Waiters *waiters = NULL;
+static Waiter  *waiting = NULL;
+
+/****************************************************************************
+  purpose: the name of a lock type, for messages.
+****************************************************************************/
+const char* lockTypeName( short type )
+{
+  switch ( type )
+  {
+    case F_RDLCK : return "read";
+    case F_WRLCK : return "write";
+    default      : return "none";
+  }
+}
+
+/****************************************************************************
+read the command line of process pid into command, with blanks between the
+arguments. returns 0 if it cannot be read.
+****************************************************************************/
+static int processCommand( pid_t pid, char *command, size_t size )
+{
+  char   name[64];
+  size_t n, i;
+  FILE   *file;
+
+  command[0] = 0;
+  if ( pid <= 0 ) return 0;
+  snprintf( name, sizeof( name ), "/proc/%ld/cmdline", (long) pid );
+  file = fopen( name, "r" );
+  if ( !file ) return 0;
+  n = fread( command, 1, size - 1, file );
+  fclose( file );
+  for ( i = 0; i < n; i++ )
+    if ( command[i] == 0 || command[i] == '\n' || command[i] == '\t' )
+      command[i] = ' ';
+  while ( n > 0 && command[n - 1] == ' ' ) n--;
+  command[n] = 0;
+  return n > 0;
+}
+
+/****************************************************************************
+  purpose: find out who holds the lock that conflicts with lock on fd, and
+           keep it in wait. the command line of a new holder is read once.
+  post   : returns 0 if no conflicting lock is held (any more).
+****************************************************************************/
+int lockHolder( int fd, struct flock *lock, LockWait *wait )
+{
+  struct flock holder = *lock;
+  if ( fcntl( fd, F_GETLK, &holder ) == -1 || holder.l_type == F_UNLCK )
+    return 0;
+  if ( holder.l_pid != wait->holder || holder.l_pid <= 0 )
+  {
+    wait->holder = holder.l_pid > 0 ? holder.l_pid : -1;
+    processCommand( holder.l_pid, wait->command, sizeof( wait->command ) );
+  }
+  wait->holdertype = holder.l_type;
+  return 1;
+}
+
+/****************************************************************************
+  purpose: claim the waiter slot slot, if its pid is still *pid. otherwise
+           *pid is set to the pid in the slot.
+  post   : returns 1 if the slot was claimed.
+****************************************************************************/
+static int claimSlot( Waiter *slot, int32_t *pid )
+{
+  return __atomic_compare_exchange_n( &slot->pid,
+                                      pid,
+                                      (int32_t) getpid(),
+                                      0,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_RELAXED );
+}
+
+/****************************************************************************
+  purpose: list this process as waiting for the lock in the waiters sidecar
+           filename, or update its entry. the slot of a waiter that was
+           killed is taken over. nothing happens if the sidecar cannot be
+           mapped or is full.
+****************************************************************************/
+void showWaiting( const char *filename, LockWait *wait )
+{
+  int i;
+  if ( !waiting )
+  {
+    if ( !waiters )
+      waiters = (Waiters*) mapSidecar( filename,
+                                       WAITERS_MAGIC,
+                                       sizeof( Waiters ),
+                                       NULL );
+    if ( !waiters ) return;
+    for ( i = 0; i < WAITER_SLOTS && !waiting; i++ )
+    {
+      int32_t pid = 0;
+      if ( claimSlot( &waiters->slots[i], &pid ) ||
+           ( pid > 0 && kill( pid, 0 ) == -1 && errno == ESRCH &&
+             claimSlot( &waiters->slots[i], &pid ) ) )
+        waiting = &waiters->slots[i];
+    }
+    if ( !waiting ) return;
+    waiting->type = wait->type;
+    waiting->since = metricsClock();
+    processCommand( getpid(), waiting->command, sizeof( waiting->command ) );
+  }
+  waiting->retries = wait->retries;
+  waiting->holder = wait->holder;
+  waiting->holdertype = wait->holdertype;
+}
+
+/****************************************************************************
+  purpose: remove this process from the waiters sidecar.
+****************************************************************************/
+void stopWaiting()
+{
+  if ( !waiting ) return;
+  __atomic_store_n( &waiting->pid, 0, __ATOMIC_RELEASE );
+  waiting = NULL;
+}
+
+/****************************************************************************
+print the locks on the file with device dev and inode ino listed in
+/proc/locks, a line per lock. locks still waiting ("->") are marked as
+blocked. returns 0 if /proc/locks cannot be read.
+****************************************************************************/
+static int printProcLocks( dev_t dev, ino_t ino, FILE *out )
+{
+  char          line[256];
+  char          kind[16], mode[16], type[16];
+  char          command[W_LOCKCOMMAND];
+  unsigned int  major, minor;
+  unsigned long inode;
+  long          pid;
+  int           found = 0;
+  FILE          *file = fopen( PROC_LOCKS, "r" );
+
+  if ( !file ) return 0;
+  while ( fgets( line, sizeof( line ), file ) )
+  {
+    char *p = strchr( line, ':' );
+    int  blocked;
+    if ( !p ) continue;
+    p++;
+    while ( *p == ' ' ) p++;
+    blocked = strncmp( p, "->", 2 ) == 0;
+    if ( blocked ) p += 2;
+    if ( sscanf( p, "%15s %15s %15s %ld %x:%x:%lu",
+                 kind, mode, type, &pid, &major, &minor, &inode ) != 7 ||
+         major != major( dev ) || minor != minor( dev ) || inode != ino )
+      continue;
+    processCommand( (pid_t) pid, command, sizeof( command ) );
+    fprintf( out, "  %-8ld %-6s %-7s %s%s\n",
+             pid,
+             strcmp( type, "READ" ) == 0 ? "read" : "write",
+             kind,
+             blocked ? "(blocked) " : "",
+             command );
+    found = 1;
+  }
+  fclose( file );
+  if ( !found ) fprintf( out, "  none\n" );
+  return 1;
+}
+
+/****************************************************************************
+  purpose: print the processes holding a lock on the repository filename
+           and the opr processes waiting for one, as listed in the waiters
+           sidecar waiters, followed by the lock wait times counted in the
+           metrics. the holders are read from /proc/locks, or else the first
+           conflicting lock is asked with F_GETLK.
+  post   : returns 0 if the repository cannot be opened.
+****************************************************************************/
+int printLockStatus( const char *filename, const char *waiters, FILE *out )
+{
+  struct stat        st;
+  unsigned long long now = metricsClock();
+  int                fd, i, found = 0;
+  Waiters            *w;
+
+  fd = open( filename, O_RDONLY );
+  if ( fd < 0 || fstat( fd, &st ) != 0 )
+  {
+    if ( fd >= 0 ) close( fd );
+    return 0;
+  }
+  fprintf( out, "holders of %s:\n", filename );
+  fprintf( out, "  %-8s %-6s %-7s %s\n", "pid", "lock", "kind", "command" );
+  if ( !printProcLocks( st.st_dev, st.st_ino, out ) )
+  {
+    struct flock lock;
+    LockWait     holder;
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = 0;
+    lock.l_len = 0;
+    holder.holder = 0;
+    if ( lockHolder( fd, &lock, &holder ) )
+      fprintf( out, "  %-8ld %-6s %-7s %s\n",
+               (long) holder.holder,
+               lockTypeName( holder.holdertype ),
+               "POSIX",
+               holder.command );
+    else
+      fprintf( out, "  none\n" );
+  }
+  close( fd );
+
+  fprintf( out, "waiters:\n" );
+  fprintf( out, "  %-8s %-6s %9s %7s %-8s %s\n",
+           "pid", "lock", "waiting", "retries", "behind", "command" );
+  w = (Waiters*) mapSidecar( waiters, WAITERS_MAGIC, sizeof( Waiters ), NULL );
+  for ( i = 0; w && i < WAITER_SLOTS; i++ )
+  {
+    Waiter  s = w->slots[i];
+    int32_t pid = __atomic_load_n( &w->slots[i].pid, __ATOMIC_ACQUIRE );
+    /* a waiter that was killed leaves its slot behind */
+    if ( pid <= 0 || ( kill( pid, 0 ) == -1 && errno == ESRCH ) ) continue;
+    fprintf( out, "  %-8ld %-6s %8.3fs %7d %-8ld %s\n",
+             (long) pid,
+             lockTypeName( s.type ),
+             now > s.since ? ( now - s.since ) / 1e6 : 0.0,
+             s.retries,
+             (long) s.holder,
+             s.command );
+    found = 1;
+  }
+  if ( !found ) fprintf( out, "  none\n" );
+  unmapSidecar( w, sizeof( Waiters ) );
+
+  fprintf( out, "read lock waits:\n" );
+  printHistogram( H_LOCK_R, out );
+  fprintf( out, "write lock waits:\n" );
+  printHistogram( H_LOCK_W, out );
+  return 1;
+}
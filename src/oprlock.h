@@ -0,0 +1,67 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRLOCK_H
+#define _OPRLOCK_H 1
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+/* width of the command line kept of a lock holder */
+#define W_LOCKCOMMAND 128
+
+/* suffix of the list of processes waiting for the repository lock */
+#define LOCKS_SUFFIX ".locks"
+
+/****************************************************************************
+a lock attempt of this process.
+   type       - F_RDLCK or F_WRLCK.
+   retries    - attempts that found the lock taken.
+   waited     - microseconds until the lock was obtained or given up.
+   holder     - pid of the last process found holding the lock, 0 if none
+                was found, -1 for a lock that has no pid.
+   holdertype - the lock type of holder.
+   command    - the command line of holder, if it could be read.
+****************************************************************************/
+typedef struct {
+  short              type;
+  int                retries;
+  unsigned long long waited;
+  pid_t              holder;
+  short              holdertype;
+  char               command[W_LOCKCOMMAND];
+} LockWait;
+
+int lockHolder( int fd, struct flock *lock, LockWait *wait );
+
+void showWaiting( const char *filename, LockWait *wait );
+
+void stopWaiting();
+
+const char* lockTypeName( short type );
+
+int printLockStatus( const char *filename, const char *waiters, FILE *out );
+
+#endif // !_OPRLOCK_H
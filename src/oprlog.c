@@ -0,0 +1,374 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "oprlog.h"
+#include "oprtrace.h"
+
+/* width of the name of the open log file */
+#define W_AUDITNAME 256
+
+/* size of the buffer records are collected in by auditBatch */
+#define W_AUDITBATCH 65536
+
+/* the log file records are appended to, -1 if not open */
+static int auditfd = -1;
+
+/* the name auditfd was opened with */
+static char auditname[W_AUDITNAME];
+
+/* the operation of this command and when it started */
+static const char *operationname = "";
+static struct timespec operationstart;
+static int operationstarted = 0;
+
+/* records collected for a single write when batching */
+static int batching = 0;
+static char batch[W_AUDITBATCH];
+static size_t batchused = 0;
+
+/* set by SIGHUP, the log file is reopened before the next write */
+static volatile sig_atomic_t reopen = 0;
+
+/****************************************************************************
+SIGHUP handler, so logrotate can move the log file of a batch away.
+****************************************************************************/
+static void hangup( int sig )
+{
+  reopen = 1;
+}
+
+/****************************************************************************
+write size bytes to the log file, as a single write() unless the file
+system takes less. returns 0 on error.
+****************************************************************************/
+static int writeLog( const char *buffer, size_t size )
+{
+  unsigned long long t = traceClock();
+  while ( size > 0 )
+  {
+    ssize_t n = write( auditfd, buffer, size );
+    if ( n < 0 && errno == EINTR ) continue;
+    if ( n <= 0 ) break;
+    buffer += n;
+    size -= n;
+  }
+  traceSince( T_LOG, t );
+  return size == 0;
+}
+
+/****************************************************************************
+write the collected records, returns 0 on error.
+****************************************************************************/
+static int writeBatch()
+{
+  int result = 1;
+  if ( batchused > 0 && auditfd >= 0 ) result = writeLog( batch, batchused );
+  batchused = 0;
+  return result;
+}
+
+/****************************************************************************
+make auditfd the log file filename, opened for appending. pending records
+go to the file they were collected for first. returns 0 on error.
+****************************************************************************/
+static int openLog( const char *filename )
+{
+  int result = 1;
+  if ( auditfd >= 0 && !reopen && strcmp( filename, auditname ) == 0 )
+    return 1;
+  if ( auditfd >= 0 )
+  {
+    result = writeBatch();
+    close( auditfd );
+    auditfd = -1;
+  }
+  reopen = 0;
+  if ( strlen( filename ) >= sizeof( auditname ) ) return 0;
+  auditfd = open( filename,
+                  O_WRONLY | O_APPEND | O_CREAT,
+                  S_IRUSR | S_IWUSR );
+  if ( auditfd < 0 ) return 0;
+  fcntl( auditfd, F_SETFD, FD_CLOEXEC );
+  strcpy( auditname, filename );
+  return result;
+}
+
+/****************************************************************************
+append " key=value" to the record at p, quoting value if it is empty or
+holds blanks, quotes or '='. returns the new end of the record, which is
+never beyond end.
+****************************************************************************/
+static char* appendValue( char       *p,
+                          char       *end,
+                          const char *key,
+                          const char *value )
+{
+  int quote = *value == 0 || strpbrk( value, " \t\"=\\" ) != NULL;
+  p += snprintf( p, end - p, " %s=%s", key, quote ? "\"" : "" );
+  if ( p >= end ) return end - 1;
+  for ( ; *value && p < end - 2; value++ )
+  {
+    if ( quote && ( *value == '"' || *value == '\\' ) ) *p++ = '\\';
+    *p++ = ( *value == '\n' || *value == '\t' ) ? ' ' : *value;
+  }
+  if ( quote && p < end - 1 ) *p++ = '"';
+  *p = 0;
+  return p;
+}
+
+/****************************************************************************
+  purpose: name the operation of this command, for the op field of its
+           records. its latency is measured from this call.
+****************************************************************************/
+void auditOperation( const char *operation )
+{
+  operationname = operation;
+  clock_gettime( CLOCK_MONOTONIC, &operationstart );
+  operationstarted = 1;
+}
+
+/****************************************************************************
+append time in UTC with microseconds to the record at p, for example
+2026-10-19T12:40:29.412345Z. returns the new end of the record.
+****************************************************************************/
+static char* appendTime( char *p, char *end, struct timespec *time )
+{
+  struct tm tm;
+  gmtime_r( &time->tv_sec, &tm );
+  p += strftime( p, end - p, "%Y-%m-%dT%H:%M:%S", &tm );
+  p += snprintf( p, end - p, ".%06ldZ", (long) time->tv_nsec / 1000 );
+  return p >= end ? end - 1 : p;
+}
+
+/****************************************************************************
+format the fields every record starts with into record, returns the end of
+the record.
+****************************************************************************/
+static char* startRecord( char       *record,
+                          char       *end,
+                          int        error,
+                          const char *operation,
+                          const char *caller,
+                          const char *osuser,
+                          const char *database,
+                          const char *schema )
+{
+  struct timespec now;
+  char            *p;
+
+  clock_gettime( CLOCK_REALTIME, &now );
+  p = appendTime( record + sprintf( record, "time=" ), end, &now );
+  p += snprintf( p, end - p, " status=%s", error ? "fail" : "ok" );
+  if ( p >= end ) p = end - 1;
+  if ( *operation ) p = appendValue( p, end, "op", operation );
+  p += snprintf( p, end - p, " uid=%ld pid=%ld",
+                 (long) getuid(),
+                 (long) getpid() );
+  if ( p >= end ) p = end - 1;
+  p = appendValue( p, end, "caller", caller );
+  if ( osuser && *osuser ) p = appendValue( p, end, "osuser", osuser );
+  if ( database && *database ) p = appendValue( p, end, "database", database );
+  if ( schema && *schema ) p = appendValue( p, end, "schema", schema );
+  return p;
+}
+
+/****************************************************************************
+append the record of size bytes to the log file filename, or collect it
+when batching. returns 0 on error.
+****************************************************************************/
+static int emitRecord( const char *filename,
+                       const char *record,
+                       size_t     size )
+{
+  if ( !openLog( filename ) ) return 0;
+  if ( !batching ) return writeLog( record, size );
+  if ( batchused + size > sizeof( batch ) && !writeBatch() ) return 0;
+  memcpy( batch + batchused, record, size );
+  batchused += size;
+  return 1;
+}
+
+/****************************************************************************
+  purpose: append a record to the log file filename, as key=value pairs on
+           a single line, for example
+             time=2026-10-19T12:40:29.412345Z status=ok op=read uid=1001
+             pid=4242 caller=batch osuser=batch database=DB1 schema=scott
+             latency_us=812 message="request ok"
+           the time is UTC, latency_us counts from auditOperation. caller is
+           the os user running opr, osuser the user of the entry. osuser,
+           database and schema are left out when NULL or empty.
+  post   : the record is written with a single write(), or collected when
+           batching. returns 0 if the log file cannot be written.
+****************************************************************************/
+int auditRecord( const char *filename,
+                 int        error,
+                 const char *caller,
+                 const char *osuser,
+                 const char *database,
+                 const char *schema,
+                 const char *message )
+{
+  char            record[W_AUDITRECORD];
+  char            *end = record + sizeof( record ) - 1;
+  char            *p;
+  struct timespec now;
+
+  p = startRecord( record, end, error, operationname,
+                   caller, osuser, database, schema );
+  if ( operationstarted )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    p += snprintf( p, end - p, " latency_us=%ld",
+                   (long) ( now.tv_sec - operationstart.tv_sec ) * 1000000L +
+                   ( now.tv_nsec - operationstart.tv_nsec ) / 1000 );
+    if ( p >= end ) p = end - 1;
+  }
+  p = appendValue( p, end, "message", message );
+  *p++ = '\n';
+  return emitRecord( filename, record, p - record );
+}
+
+/****************************************************************************
+  purpose: append a summary of the successful reads of schema@database by
+           osuser to the log file filename, for example
+             time=2026-10-19T13:00:02.100000Z status=ok op=reads uid=1001
+             pid=4242 caller=batch osuser=batch database=DB1 schema=scott
+             reads=5120 since=2026-10-19T12:00:01.000000Z
+  post   : as auditRecord.
+****************************************************************************/
+int auditReads( const char    *filename,
+                const char    *caller,
+                const char    *osuser,
+                const char    *database,
+                const char    *schema,
+                unsigned long count,
+                time_t        since )
+{
+  char            record[W_AUDITRECORD];
+  char            *end = record + sizeof( record ) - 1;
+  char            *p;
+  struct timespec start;
+
+  p = startRecord( record, end, 0, "reads",
+                   caller, osuser, database, schema );
+  p += snprintf( p, end - p, " reads=%lu", count );
+  if ( p >= end ) p = end - 1;
+  p += snprintf( p, end - p, " since=" );
+  if ( p >= end ) p = end - 1;
+  start.tv_sec = since;
+  start.tv_nsec = 0;
+  p = appendTime( p, end, &start );
+  *p++ = '\n';
+  return emitRecord( filename, record, p - record );
+}
+
+/****************************************************************************
+  purpose: append a record of a lock that was taken only after retries, or
+           not at all, to the log file filename, for example
+             time=2026-10-19T13:00:02.100000Z status=ok op=read uid=1001
+             pid=4242 caller=batch lock=read wait_us=441713 retries=11
+             holder_pid=4200 holder_lock=write holder_cmd="opr -M scott DB1"
+           holder is 0 if the holder was not found, holdercommand may be
+           empty.
+  post   : as auditRecord.
+****************************************************************************/
+int auditLockWait( const char         *filename,
+                   int                error,
+                   const char         *caller,
+                   const char         *lock,
+                   unsigned long long waited,
+                   int                retries,
+                   long               holder,
+                   const char         *holderlock,
+                   const char         *holdercommand )
+{
+  char record[W_AUDITRECORD];
+  char *end = record + sizeof( record ) - 1;
+  char *p;
+
+  p = startRecord( record, end, error, operationname,
+                   caller, NULL, NULL, NULL );
+  p = appendValue( p, end, "lock", lock );
+  p += snprintf( p, end - p, " wait_us=%llu retries=%d holder_pid=%ld",
+                 waited, retries, holder );
+  if ( p >= end ) p = end - 1;
+  p = appendValue( p, end, "holder_lock", holderlock );
+  if ( *holdercommand ) p = appendValue( p, end, "holder_cmd", holdercommand );
+  *p++ = '\n';
+  return emitRecord( filename, record, p - record );
+}
+
+/****************************************************************************
+  purpose: write the records collected by auditBatch.
+  post   : returns 0 if they could not be written.
+****************************************************************************/
+int auditFlush()
+{
+  char name[W_AUDITNAME];
+  strcpy( name, auditname );
+  if ( reopen && auditfd >= 0 && !openLog( name ) ) return 0;
+  return writeBatch();
+}
+
+/****************************************************************************
+  purpose: flush at exit, terminate() and exit() included.
+****************************************************************************/
+static void flushAtExit()
+{
+  if ( !auditFlush() )
+    fprintf( stderr, "unable to append to logfile %s.\n", auditname );
+}
+
+/****************************************************************************
+  purpose: collect the records of a command that logs many of them, such as
+           a rotation, and write them together with auditFlush, when the
+           buffer fills, or at exit. the log file is reopened after a SIGHUP,
+           so it can be rotated while the command runs.
+****************************************************************************/
+void auditBatch()
+{
+  struct sigaction action;
+  if ( batching ) return;
+  batching = 1;
+  memset( &action, 0, sizeof( action ) );
+  action.sa_handler = hangup;
+  action.sa_flags = SA_RESTART;
+  sigemptyset( &action.sa_mask );
+  sigaction( SIGHUP, &action, NULL );
+  atexit( flushAtExit );
+}
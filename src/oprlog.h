@@ -0,0 +1,65 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRLOG_H
+#define _OPRLOG_H 1
+
+#include <time.h>
+
+/* width of a single audit record */
+#define W_AUDITRECORD 1024
+
+void auditOperation( const char *operation );
+
+int auditRecord( const char *filename,
+                 int        error,
+                 const char *caller,
+                 const char *osuser,
+                 const char *database,
+                 const char *schema,
+                 const char *message );
+
+int auditReads( const char    *filename,
+                const char    *caller,
+                const char    *osuser,
+                const char    *database,
+                const char    *schema,
+                unsigned long count,
+                time_t        since );
+
+int auditLockWait( const char         *filename,
+                   int                error,
+                   const char         *caller,
+                   const char         *lock,
+                   unsigned long long waited,
+                   int                retries,
+                   long               holder,
+                   const char         *holderlock,
+                   const char         *holdercommand );
+
+void auditBatch();
+
+int auditFlush();
+
+#endif // !_OPRLOG_H
@@ -0,0 +1,494 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "oprmap.h"
+#include "oprrepos.h"
+
+/* width of the magic string at the start of every sidecar */
+#define W_MAPMAGIC 32
+
+/* first bytes of the read counter sidecar. a sidecar of an earlier layout
+   has another size and is not mapped */
+#define READMAP_MAGIC "OraclePasswordRepository reads 2"
+
+/* first bytes of the usage sidecar */
+#define USAGEMAP_MAGIC "OraclePasswordRepository usage 2"
+
+/* number of (osuser, database, schema) counters in the read and usage
+   sidecars, twice the maximum number of repository entries so that probes
+   stay short */
+#define READ_SLOTS ( 2 * MAX_ENTRIES )
+
+/* the largest read count kept in the usage sidecar */
+#define USAGE_MAXCOUNT 0xffffffffULL
+
+/* number of times a slot claimed by another process is checked again
+   before it is passed over, its claimer may have died */
+#define CLAIM_RETRIES 10000
+
+/* states of a read counter */
+#define SLOT_FREE    0
+#define SLOT_CLAIMED 1
+#define SLOT_USED    2
+#define SLOT_DELETED 3
+
+/****************************************************************************
+a read counter. a slot is claimed by the process that sets state from
+SLOT_FREE to SLOT_CLAIMED, which then fills in the names and sets it to
+SLOT_USED. in the usage sidecar, the slot of a deleted entry is set to
+SLOT_DELETED by forgetUsage, and claimed again for other names. the names
+are those of the repository, terminated.
+in the usage sidecar, count holds the time of the last read in its upper
+32 bits and the number of reads, saturating, in its lower 32 bits.
+****************************************************************************/
+typedef struct {
+  uint32_t state;
+  uint32_t hash;
+  uint64_t count;
+  char     osuser[W_OSUSERNAME + 1];
+  char     database[W_DATABASE + 1];
+  char     schema[W_SCHEMANAME + 1];
+} ReadSlot;
+
+/****************************************************************************
+the read counter sidecar. since is the start of the current interval, the
+process that moves it on reports and resets the counters.
+****************************************************************************/
+typedef struct {
+  char     magic[W_MAPMAGIC];
+  int64_t  since;
+  ReadSlot slots[READ_SLOTS];
+} ReadMap;
+
+/****************************************************************************
+the usage sidecar. since is when it was created, entries not read since
+then have not been read for at least that long. overflow is set once a read
+could not be recorded, for lack of a free slot.
+****************************************************************************/
+typedef struct {
+  char     magic[W_MAPMAGIC];
+  int64_t  since;
+  uint32_t overflow;
+  ReadSlot slots[READ_SLOTS];
+} UsageMap;
+
+/* the read and usage sidecars of this process, mapped on first use */
+static ReadMap  *readmap = NULL;
+static UsageMap *usagemap = NULL;
+
+/****************************************************************************
+  purpose: map the sidecar file filename of size bytes, shared with other
+           processes. a new file is created, zero filled, passed to init
+           (if not NULL) and stamped with magic, all under an exclusive
+           lock, so other processes never see it half initialized. an
+           existing file is mapped without locking.
+  post   : returns the mapping, or NULL if the file cannot be created or
+           mapped, or holds something else.
+****************************************************************************/
+void* mapSidecar( const char *filename,
+                  const char *magic,
+                  size_t     size,
+                  void       (*init)( void* ) )
+{
+  struct stat st;
+  void        *map = NULL;
+  int         fd, locked = 0;
+
+  fd = open( filename, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR );
+  if ( fd < 0 ) return NULL;
+  if ( fstat( fd, &st ) == 0 && st.st_size != size )
+  {
+    locked = 1;
+    if ( flock( fd, LOCK_EX ) != 0 || fstat( fd, &st ) != 0 ||
+         ( st.st_size == 0 && ftruncate( fd, size ) != 0 ) )
+      st.st_size = -1;
+  }
+  if ( st.st_size == 0 || st.st_size == size )
+  {
+    map = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( map == MAP_FAILED ) map = NULL;
+  }
+  if ( map && st.st_size == 0 )
+  {
+    if ( init ) init( map );
+    strncpy( (char*) map, magic, W_MAPMAGIC );
+  } else
+  if ( map && strncmp( (char*) map, magic, W_MAPMAGIC ) != 0 )
+  {
+    /* the file may still be initialized by its creator, which holds the
+       lock until it is done */
+    if ( locked || flock( fd, LOCK_EX ) != 0 ||
+         strncmp( (char*) map, magic, W_MAPMAGIC ) != 0 )
+    {
+      munmap( map, size );
+      map = NULL;
+    }
+  }
+  close( fd );
+  return map;
+}
+
+/****************************************************************************
+  purpose: unmap a sidecar mapped by mapSidecar.
+****************************************************************************/
+void unmapSidecar( void *map, size_t size )
+{
+  if ( map ) munmap( map, size );
+}
+
+/****************************************************************************
+  purpose: start the first interval of a new read sidecar.
+****************************************************************************/
+static void initReadMap( void *map )
+{
+  ( (ReadMap*) map )->since = time( NULL );
+}
+
+/****************************************************************************
+  purpose: map the read sidecar if it is not yet.
+****************************************************************************/
+static ReadMap* openReadMap( const char *filename )
+{
+  if ( !readmap )
+    readmap = (ReadMap*) mapSidecar( filename,
+                                     READMAP_MAGIC,
+                                     sizeof( ReadMap ),
+                                     initReadMap );
+  return readmap;
+}
+
+/****************************************************************************
+  purpose: FNV-1a hash of a name, continuing from h.
+****************************************************************************/
+static uint32_t hashName( uint32_t h, const char *name, size_t width )
+{
+  size_t i;
+  for ( i = 0; i < width && name[i]; i++ )
+    h = ( h ^ (unsigned char) name[i] ) * 16777619U;
+  return ( h ^ 0xff ) * 16777619U;
+}
+
+/****************************************************************************
+  purpose: returns whether slot holds the given names.
+****************************************************************************/
+static int sameNames( ReadSlot   *slot,
+                      const char *osuser,
+                      const char *database,
+                      const char *schema )
+{
+  return strncmp( slot->osuser, osuser, W_OSUSERNAME ) == 0 &&
+         strncmp( slot->database, database, W_DATABASE ) == 0 &&
+         strncmp( slot->schema, schema, W_SCHEMANAME ) == 0;
+}
+
+/****************************************************************************
+  purpose: claim slot, in state from, for the names with hash h.
+  post   : returns 0 if another process changed its state first.
+****************************************************************************/
+static int claimSlot( ReadSlot   *slot,
+                      uint32_t   from,
+                      uint32_t   h,
+                      const char *osuser,
+                      const char *database,
+                      const char *schema )
+{
+  if ( !__atomic_compare_exchange_n( &slot->state,
+                                     &from,
+                                     SLOT_CLAIMED,
+                                     0,
+                                     __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE ) )
+    return 0;
+  memset( slot->osuser, 0, sizeof( slot->osuser ) );
+  memset( slot->database, 0, sizeof( slot->database ) );
+  memset( slot->schema, 0, sizeof( slot->schema ) );
+  strncpy( slot->osuser, osuser, W_OSUSERNAME );
+  strncpy( slot->database, database, W_DATABASE );
+  strncpy( slot->schema, schema, W_SCHEMANAME );
+  slot->hash = h;
+  __atomic_store_n( &slot->count, 0, __ATOMIC_RELAXED );
+  __atomic_store_n( &slot->state, SLOT_USED, __ATOMIC_RELEASE );
+  return 1;
+}
+
+/****************************************************************************
+  purpose: find the slot of schema@database for osuser in slots. if claim is
+           set, a slot is claimed for names not found, the first deleted one
+           on their probe or else the free one that ends it.
+  post   : returns NULL if the names are not found, and no slot could be
+           claimed for them. a slot left claimed by a process that died
+           while filling it in is passed over after CLAIM_RETRIES checks.
+****************************************************************************/
+static ReadSlot* findSlot( ReadSlot   *slots,
+                           const char *osuser,
+                           const char *database,
+                           const char *schema,
+                           int        claim )
+{
+  ReadSlot *reuse = NULL;
+  uint32_t h;
+  int      i, retries;
+
+  h = hashName( hashName( hashName( 2166136261U, osuser, W_OSUSERNAME ),
+                          database, W_DATABASE ),
+                schema, W_SCHEMANAME );
+  for ( i = 0; i < READ_SLOTS; i++ )
+  {
+    ReadSlot *slot = &slots[( h + i ) % READ_SLOTS];
+    uint32_t state = __atomic_load_n( &slot->state, __ATOMIC_ACQUIRE );
+    if ( state == SLOT_FREE )
+    {
+      if ( !claim ) return NULL;
+      /* a process that lost the deleted slot to another one looks again,
+         the winner may have claimed it for the same names */
+      if ( reuse )
+        return claimSlot( reuse, SLOT_DELETED, h, osuser, database, schema ) ?
+               reuse : findSlot( slots, osuser, database, schema, claim );
+      if ( claimSlot( slot, SLOT_FREE, h, osuser, database, schema ) )
+        return slot;
+      state = __atomic_load_n( &slot->state, __ATOMIC_ACQUIRE );
+    }
+    if ( state == SLOT_DELETED )
+    {
+      if ( !reuse ) reuse = slot;
+      continue;
+    }
+    /* another process is filling in this slot */
+    for ( retries = 0; state == SLOT_CLAIMED && retries < CLAIM_RETRIES;
+          retries++ )
+    {
+      sched_yield();
+      state = __atomic_load_n( &slot->state, __ATOMIC_ACQUIRE );
+    }
+    if ( state == SLOT_USED && slot->hash == h &&
+         sameNames( slot, osuser, database, schema ) )
+      return slot;
+  }
+  if ( claim && reuse )
+    return claimSlot( reuse, SLOT_DELETED, h, osuser, database, schema ) ?
+           reuse : findSlot( slots, osuser, database, schema, claim );
+  return NULL;
+}
+
+/****************************************************************************
+  purpose: count a successful read of schema@database by osuser in the read
+           sidecar filename, with an atomic increment of its counter.
+  post   : returns 0 if the read could not be counted, because the sidecar
+           cannot be mapped or has no free counters left.
+****************************************************************************/
+int countRead( const char *filename,
+               const char *osuser,
+               const char *database,
+               const char *schema )
+{
+  ReadMap  *map = openReadMap( filename );
+  ReadSlot *slot;
+
+  if ( !map ) return 0;
+  slot = findSlot( map->slots, osuser, database, schema, 1 );
+  if ( !slot ) return 0;
+  __atomic_fetch_add( &slot->count, 1, __ATOMIC_RELAXED );
+  return 1;
+}
+
+/****************************************************************************
+  purpose: report the read counters of the read sidecar filename when its
+           current interval is at least interval seconds old, 0 reports
+           them now. emit is called for every counter that is not 0, with
+           the names, the count and the start of the interval. the counters
+           are then reset and the next interval starts.
+  post   : returns 0 if the sidecar cannot be mapped. only one of several
+           concurrent callers reports an interval.
+****************************************************************************/
+int takeReadCounts( const char *filename,
+                    int        interval,
+                    void       (*emit)( const char*,
+                                        const char*,
+                                        const char*,
+                                        unsigned long,
+                                        time_t ) )
+{
+  ReadMap *map = openReadMap( filename );
+  int64_t since, now = time( NULL );
+  int     i;
+
+  if ( !map ) return 0;
+  since = __atomic_load_n( &map->since, __ATOMIC_ACQUIRE );
+  if ( now - since < interval ) return 1;
+  if ( !__atomic_compare_exchange_n( &map->since,
+                                     &since,
+                                     now,
+                                     0,
+                                     __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE ) ) return 1;
+  for ( i = 0; i < READ_SLOTS; i++ )
+  {
+    ReadSlot *slot = &map->slots[i];
+    uint64_t count;
+    if ( __atomic_load_n( &slot->state, __ATOMIC_ACQUIRE ) != SLOT_USED )
+      continue;
+    count = __atomic_exchange_n( &slot->count, 0, __ATOMIC_ACQ_REL );
+    if ( count ) emit( slot->osuser,
+                       slot->database,
+                       slot->schema,
+                       (unsigned long) count,
+                       (time_t) since );
+  }
+  return 1;
+}
+
+/****************************************************************************
+  purpose: start the usage sidecar, as in initReadMap.
+****************************************************************************/
+static void initUsageMap( void *map )
+{
+  ( (UsageMap*) map )->since = time( NULL );
+}
+
+/****************************************************************************
+  purpose: map the usage sidecar if it is not yet.
+****************************************************************************/
+static UsageMap* openUsageMap( const char *filename )
+{
+  if ( !usagemap )
+    usagemap = (UsageMap*) mapSidecar( filename,
+                                       USAGEMAP_MAGIC,
+                                       sizeof( UsageMap ),
+                                       initUsageMap );
+  return usagemap;
+}
+
+/****************************************************************************
+  purpose: record a read of schema@database by osuser in the usage sidecar
+           filename: its last read time becomes now and its read count goes
+           up by one, unless it is at its maximum. both are set with a
+           single atomic store. a read that races with another one may not
+           be counted, the last read time is always right.
+  post   : returns 0 if the read could not be recorded. if the sidecar has
+           no free slot left, its overflow is set.
+****************************************************************************/
+int touchUsage( const char *filename,
+                const char *osuser,
+                const char *database,
+                const char *schema )
+{
+  UsageMap *map = openUsageMap( filename );
+  ReadSlot *slot;
+  uint64_t count;
+
+  if ( !map ) return 0;
+  slot = findSlot( map->slots, osuser, database, schema, 1 );
+  if ( !slot )
+  {
+    __atomic_store_n( &map->overflow, 1, __ATOMIC_RELEASE );
+    return 0;
+  }
+  count = __atomic_load_n( &slot->count, __ATOMIC_RELAXED ) & USAGE_MAXCOUNT;
+  if ( count < USAGE_MAXCOUNT ) count++;
+  __atomic_store_n( &slot->count,
+                    (uint64_t) (uint32_t) time( NULL ) << 32 | count,
+                    __ATOMIC_RELAXED );
+  return 1;
+}
+
+/****************************************************************************
+  purpose: look up the usage of schema@database by osuser in the usage
+           sidecar filename. last is set to the time of the last read and
+           count to the number of reads, both 0 if it was not read. since
+           is set to when the sidecar was created.
+  post   : returns 0 if the sidecar cannot be mapped.
+****************************************************************************/
+int entryUsage( const char    *filename,
+                const char    *osuser,
+                const char    *database,
+                const char    *schema,
+                time_t        *last,
+                unsigned long *count,
+                time_t        *since )
+{
+  UsageMap *map = openUsageMap( filename );
+  ReadSlot *slot;
+  uint64_t usage = 0;
+
+  if ( !map ) return 0;
+  slot = findSlot( map->slots, osuser, database, schema, 0 );
+  if ( slot ) usage = __atomic_load_n( &slot->count, __ATOMIC_RELAXED );
+  *last = (time_t) ( usage >> 32 );
+  *count = (unsigned long) ( usage & USAGE_MAXCOUNT );
+  *since = (time_t) map->since;
+  return 1;
+}
+
+/****************************************************************************
+  purpose: free the slot of schema@database for osuser in the usage sidecar
+           filename, for an entry that was deleted. an entry added again
+           later starts without reads.
+  post   : returns 0 if the sidecar cannot be mapped.
+****************************************************************************/
+int forgetUsage( const char *filename,
+                 const char *osuser,
+                 const char *database,
+                 const char *schema )
+{
+  UsageMap *map = openUsageMap( filename );
+  ReadSlot *slot;
+
+  if ( !map ) return 0;
+  slot = findSlot( map->slots, osuser, database, schema, 0 );
+  if ( slot )
+  {
+    __atomic_store_n( &slot->count, 0, __ATOMIC_RELAXED );
+    __atomic_store_n( &slot->state, SLOT_DELETED, __ATOMIC_RELEASE );
+  }
+  return 1;
+}
+
+/****************************************************************************
+  purpose: tell if a read could not be recorded in the usage sidecar
+           filename, the usage of some entries is then too old. overflow is
+           set to 1 if so, 0 otherwise.
+  post   : returns 0 if the sidecar cannot be mapped.
+****************************************************************************/
+int usageOverflow( const char *filename, int *overflow )
+{
+  UsageMap *map = openUsageMap( filename );
+
+  if ( !map ) return 0;
+  *overflow = __atomic_load_n( &map->overflow, __ATOMIC_ACQUIRE ) != 0;
+  return 1;
+}
@@ -0,0 +1,71 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRMAP_H
+#define _OPRMAP_H 1
+
+#include <stddef.h>
+#include <time.h>
+
+void* mapSidecar( const char *filename,
+                  const char *magic,
+                  size_t     size,
+                  void       (*init)( void* ) );
+
+void unmapSidecar( void *map, size_t size );
+
+int countRead( const char *filename,
+               const char *osuser,
+               const char *database,
+               const char *schema );
+
+int takeReadCounts( const char *filename,
+                    int        interval,
+                    void       (*emit)( const char*,
+                                        const char*,
+                                        const char*,
+                                        unsigned long,
+                                        time_t ) );
+
+int touchUsage( const char *filename,
+                const char *osuser,
+                const char *database,
+                const char *schema );
+
+int entryUsage( const char    *filename,
+                const char    *osuser,
+                const char    *database,
+                const char    *schema,
+                time_t        *last,
+                unsigned long *count,
+                time_t        *since );
+
+int forgetUsage( const char *filename,
+                 const char *osuser,
+                 const char *database,
+                 const char *schema );
+
+int usageOverflow( const char *filename, int *overflow );
+
+#endif // !_OPRMAP_H
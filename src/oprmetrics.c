@@ -0,0 +1,290 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "oprmap.h"
+#include "oprmetrics.h"
+
+/* first bytes of the metrics sidecar */
+#define METRICS_MAGIC "OraclePasswordRepository stats 2"
+
+/* histogram buckets. bucket 2e+h, e >= 1, holds the values from
+   2^e + h*2^(e-1) up to 2^e + (h+1)*2^(e-1) microseconds, buckets 0 and 1
+   hold 0 and 1. the last bucket also holds everything above 2^32. */
+#define HIST_BUCKETS 64
+
+/* the operations counted, the last one counts all others */
+static const char *operations[] = {
+  "create", "read", "add", "delete", "modify", "rotate", "export",
+  "import", "crosscheck", "log", "list", "metrics", "lock-status", "usage",
+  "prune", "stats", "views", "other" };
+#define M_OPERATIONS ( sizeof( operations ) / sizeof( operations[0] ) )
+
+/****************************************************************************
+a latency histogram, sum is the total of all values in microseconds.
+****************************************************************************/
+typedef struct {
+  uint64_t sum;
+  uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+/****************************************************************************
+the metrics sidecar, shared by all opr processes on a repository. all
+fields are only changed by atomic adds.
+****************************************************************************/
+typedef struct {
+  char      magic[32];
+  uint64_t  counters[M_COUNTERS];
+  uint64_t  operations[M_OPERATIONS][2];
+  Histogram histograms[H_HISTOGRAMS];
+} Metrics;
+
+/****************************************************************************
+the prometheus name, labels and help of a counter or histogram.
+****************************************************************************/
+typedef struct {
+  const char *name;
+  const char *labels;
+  const char *help;
+} MetricName;
+
+static const MetricName counternames[M_COUNTERS] = {
+  { "opr_reads_total", "outcome=\"ok\"", "Password reads." },
+  { "opr_reads_total", "outcome=\"denied\"", "Password reads." },
+  { "opr_lock_retries_total", "lock=\"read\"",
+    "Repository lock attempts that found the lock taken." },
+  { "opr_lock_retries_total", "lock=\"write\"",
+    "Repository lock attempts that found the lock taken." },
+  { "opr_lock_failures_total", "lock=\"read\"",
+    "Repository locks not obtained after all retries." },
+  { "opr_lock_failures_total", "lock=\"write\"",
+    "Repository locks not obtained after all retries." } };
+
+static const MetricName histogramnames[H_HISTOGRAMS] = {
+  { "opr_read_seconds", "", "Time opr -r takes, from start to answer." },
+  { "opr_repository_load_seconds", "",
+    "Time to read the repository, locking included." },
+  { "opr_lock_wait_seconds", "lock=\"read\"",
+    "Time spent obtaining a repository lock." },
+  { "opr_lock_wait_seconds", "lock=\"write\"",
+    "Time spent obtaining a repository lock." },
+  { "opr_oci_seconds", "call=\"environment\"", "Time spent in OCI calls." },
+  { "opr_oci_seconds", "call=\"attach\"", "Time spent in OCI calls." },
+  { "opr_oci_seconds", "call=\"logon\"", "Time spent in OCI calls." },
+  { "opr_oci_seconds", "call=\"logoff\"", "Time spent in OCI calls." },
+  { "opr_oci_seconds", "call=\"change\"", "Time spent in OCI calls." },
+  { "opr_oci_seconds", "call=\"query\"", "Time spent in OCI calls." } };
+
+/* the metrics of this process' repository, NULL if not available */
+static Metrics *metrics = NULL;
+
+/****************************************************************************
+  purpose: map the metrics sidecar filename. until this is done, or if it
+           fails, counting is a no-op.
+  post   : returns 0 if the sidecar cannot be mapped.
+****************************************************************************/
+int openMetrics( const char *filename )
+{
+  if ( !metrics )
+    metrics = (Metrics*) mapSidecar( filename,
+                                     METRICS_MAGIC,
+                                     sizeof( Metrics ),
+                                     NULL );
+  return metrics != NULL;
+}
+
+/****************************************************************************
+  purpose: the monotonic clock in microseconds, for timeMetric.
+****************************************************************************/
+unsigned long long metricsClock()
+{
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (unsigned long long) now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/****************************************************************************
+  purpose: add n to a counter.
+****************************************************************************/
+void countMetric( int counter, unsigned long n )
+{
+  if ( metrics )
+    __atomic_fetch_add( &metrics->counters[counter], n, __ATOMIC_RELAXED );
+}
+
+/****************************************************************************
+  purpose: the histogram bucket of a value.
+****************************************************************************/
+static int bucketOf( unsigned long long us )
+{
+  int e;
+  if ( us < 2 ) return (int) us;
+  e = 63 - __builtin_clzll( us );
+  if ( e > 31 ) return HIST_BUCKETS - 1;
+  return 2 * e + (int) ( ( us >> ( e - 1 ) ) & 1 );
+}
+
+/****************************************************************************
+  purpose: the upper bound (exclusive) of a histogram bucket.
+****************************************************************************/
+static unsigned long long bucketBound( int b )
+{
+  int e = b / 2;
+  if ( b < 2 ) return (unsigned long long) b + 1;
+  return ( 1ULL << e ) + (unsigned long long) ( b % 2 + 1 ) * ( 1ULL << ( e - 1 ) );
+}
+
+/****************************************************************************
+  purpose: add a latency of us microseconds to a histogram.
+****************************************************************************/
+void timeMetric( int histogram, unsigned long long us )
+{
+  Histogram *h;
+  if ( !metrics ) return;
+  h = &metrics->histograms[histogram];
+  __atomic_fetch_add( &h->buckets[bucketOf( us )], 1, __ATOMIC_RELAXED );
+  __atomic_fetch_add( &h->sum, us, __ATOMIC_RELAXED );
+}
+
+/****************************************************************************
+  purpose: count a finished command by its operation name and outcome.
+****************************************************************************/
+void countOperation( const char *operation, int failed )
+{
+  int i;
+  if ( !metrics ) return;
+  for ( i = 0; i < M_OPERATIONS - 1; i++ )
+    if ( strcmp( operation, operations[i] ) == 0 ) break;
+  __atomic_fetch_add( &metrics->operations[i][failed ? 1 : 0],
+                      1,
+                      __ATOMIC_RELAXED );
+}
+
+/****************************************************************************
+  purpose: print a HELP and TYPE line, once per metric name.
+****************************************************************************/
+static void printType( FILE       *out,
+                       const char *name,
+                       const char *help,
+                       const char *type,
+                       const char **last )
+{
+  if ( *last && strcmp( *last, name ) == 0 ) return;
+  fprintf( out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type );
+  *last = name;
+}
+
+/****************************************************************************
+  purpose: print the metrics of the sidecar filename to out, in the
+           prometheus text format.
+  post   : returns 0 if the sidecar cannot be mapped.
+****************************************************************************/
+int printMetrics( const char *filename, FILE *out )
+{
+  const char *last = NULL;
+  int        i, b;
+
+  if ( !openMetrics( filename ) ) return 0;
+  for ( i = 0; i < M_COUNTERS; i++ )
+  {
+    printType( out, counternames[i].name, counternames[i].help,
+               "counter", &last );
+    fprintf( out, "%s{%s} %llu\n",
+             counternames[i].name,
+             counternames[i].labels,
+             (unsigned long long)
+             __atomic_load_n( &metrics->counters[i], __ATOMIC_RELAXED ) );
+  }
+  printType( out, "opr_operations_total", "Finished opr commands.",
+             "counter", &last );
+  for ( i = 0; i < M_OPERATIONS; i++ )
+    for ( b = 0; b < 2; b++ )
+      fprintf( out, "opr_operations_total{op=\"%s\",outcome=\"%s\"} %llu\n",
+               operations[i],
+               b ? "fail" : "ok",
+               (unsigned long long)
+               __atomic_load_n( &metrics->operations[i][b], __ATOMIC_RELAXED ) );
+  for ( i = 0; i < H_HISTOGRAMS; i++ )
+  {
+    Histogram          *h = &metrics->histograms[i];
+    const char         *labels = histogramnames[i].labels;
+    const char         *sep = *labels ? "," : "";
+    unsigned long long cumulative = 0;
+    printType( out, histogramnames[i].name, histogramnames[i].help,
+               "histogram", &last );
+    for ( b = 0; b < HIST_BUCKETS - 1; b++ )
+    {
+      cumulative += __atomic_load_n( &h->buckets[b], __ATOMIC_RELAXED );
+      fprintf( out, "%s_bucket{%s%sle=\"%g\"} %llu\n",
+               histogramnames[i].name, labels, sep,
+               bucketBound( b ) / 1e6, cumulative );
+    }
+    cumulative += __atomic_load_n( &h->buckets[b], __ATOMIC_RELAXED );
+    fprintf( out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n",
+             histogramnames[i].name, labels, sep, cumulative );
+    fprintf( out, "%s_sum%s%s%s %g\n", histogramnames[i].name,
+             *labels ? "{" : "", labels, *labels ? "}" : "",
+             __atomic_load_n( &h->sum, __ATOMIC_RELAXED ) / 1e6 );
+    fprintf( out, "%s_count%s%s%s %llu\n", histogramnames[i].name,
+             *labels ? "{" : "", labels, *labels ? "}" : "",
+             cumulative );
+  }
+  return 1;
+}
+
+/****************************************************************************
+  purpose: print the count and total of a histogram and its non-empty
+           buckets to out, a line per bucket, for people to read.
+  pre    : openMetrics
+****************************************************************************/
+void printHistogram( int histogram, FILE *out )
+{
+  Histogram          *h;
+  unsigned long long n, count = 0;
+  int                b;
+
+  if ( !metrics ) return;
+  h = &metrics->histograms[histogram];
+  for ( b = 0; b < HIST_BUCKETS; b++ )
+    count += __atomic_load_n( &h->buckets[b], __ATOMIC_RELAXED );
+  fprintf( out, "  %llu in %.3fs\n",
+           count,
+           __atomic_load_n( &h->sum, __ATOMIC_RELAXED ) / 1e6 );
+  for ( b = 0; b < HIST_BUCKETS; b++ )
+  {
+    n = __atomic_load_n( &h->buckets[b], __ATOMIC_RELAXED );
+    if ( n == 0 ) continue;
+    if ( b < HIST_BUCKETS - 1 )
+      fprintf( out, "  < %11.6fs %llu\n", bucketBound( b ) / 1e6, n );
+    else
+      fprintf( out, "  > %11.6fs %llu\n", bucketBound( b - 1 ) / 1e6, n );
+  }
+}
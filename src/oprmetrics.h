@@ -0,0 +1,66 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRMETRICS_H
+#define _OPRMETRICS_H 1
+
+#include <stdio.h>
+
+/* counters */
+#define M_READS_OK       0
+#define M_READS_DENIED   1
+#define M_LOCK_RETRIES_R 2
+#define M_LOCK_RETRIES_W 3
+#define M_LOCK_FAILED_R  4
+#define M_LOCK_FAILED_W  5
+#define M_COUNTERS       6
+
+/* latency histograms */
+#define H_READ        0
+#define H_LOAD        1
+#define H_LOCK_R      2
+#define H_LOCK_W      3
+#define H_OCI_ENV     4
+#define H_OCI_ATTACH  5
+#define H_OCI_LOGON   6
+#define H_OCI_LOGOFF  7
+#define H_OCI_CHANGE  8
+#define H_OCI_QUERY   9
+#define H_HISTOGRAMS 10
+
+int openMetrics( const char *filename );
+
+unsigned long long metricsClock();
+
+void countMetric( int counter, unsigned long n );
+
+void timeMetric( int histogram, unsigned long long us );
+
+void countOperation( const char *operation, int failed );
+
+int printMetrics( const char *filename, FILE *out );
+
+void printHistogram( int histogram, FILE *out );
+
+#endif // !_OPRMETRICS_H
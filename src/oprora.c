@@ -29,11 +29,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <dlfcn.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
 /* cross platform dynamic library abstraction */
 #include <ltdl.h>
 /* oracle call interface */
 #include <oci.h>
+#include "oprora.h"
+#include "oprpool.h"
+#include "oprhash.h"
+#include "oprmetrics.h"
+#include "oprtrace.h"
+#include "oprprobes.h"
 /* 
  * oracle client libraries. extensions are overruled by lt_dlopenext
  * depending on the platform (.la, .so, .sl, .. )
@@ -45,6 +55,26 @@
 /* name of the environment variable */
 #define ORACLE_HOME "ORACLE_HOME"
 
+/* default number of seconds an attach, a logon and a password change may
+   take before they are broken off, 0 is no limit */
+#define ATTACH_TIMEOUT 30
+#define LOGIN_TIMEOUT 30
+#define CHANGE_TIMEOUT 60
+
+/* number of seconds a crosscheck waits beyond its deadline for broken off
+   checks to return */
+#define BREAK_GRACE 2
+
+/* the query that reads the password verifiers of all database users */
+#define VERIFIER_QUERY "select name, spare4 from sys.user$ where type# = 1"
+
+/* maximum length of a database username, and of the verifiers of a user */
+#define W_USERNAME 129
+#define W_VERIFIERS 1001
+
+/* number of verifier rows fetched per round trip */
+#define VERIFIER_PREFETCH 1000
+
 /* handle to the oci client library */
 lt_dlhandle libclntsh_so;
 int libclntsh_so_loaded = 0;
@@ -58,12 +88,34 @@ sword (*ocihandlefree)( dvoid*, ub4 );
 sword (*ociattrset)( dvoid*, ub4, dvoid*, ub4, ub4, OCIError* );
 sword (*ociserverattach)( OCIServer*, OCIError*, CONST text*,
                           sb4, ub4 );
+sword (*ociserverdetach)( OCIServer*, OCIError*, ub4 );
 sword (*ocisessionbegin)( OCISvcCtx*, OCIError*, OCISession*,
                           ub4, ub4 );
 sword (*ocisessionend)( OCISvcCtx*, OCIError*, OCISession*, ub4 );                          
 sword (*ocipasswordchange)( OCISvcCtx *, OCIError *, CONST text *,
                             ub4, CONST text *, ub4, CONST text *,
                             sb4, ub4);
+sword (*ocistmtprepare2)( OCISvcCtx*, OCIStmt**, OCIError*, CONST text*,
+                          ub4, CONST text*, ub4, ub4, ub4 );
+sword (*ocistmtexecute)( OCISvcCtx*, OCIStmt*, OCIError*, ub4, ub4,
+                         CONST OCISnapshot*, OCISnapshot*, ub4 );
+sword (*ocidefinebypos)( OCIStmt*, OCIDefine**, OCIError*, ub4, dvoid*,
+                         sb4, ub2, dvoid*, ub2*, ub2*, ub4 );
+sword (*ocistmtfetch2)( OCIStmt*, OCIError*, ub4, ub2, sb4, ub4 );
+sword (*ocistmtrelease)( OCIStmt*, OCIError*, CONST text*, ub4, ub4 );
+sword (*ocibreak)( dvoid*, OCIError* );
+sword (*ocireset)( dvoid*, OCIError* );
+
+/* seconds an attach, a logon and a password change may take, 0 is no limit */
+int attachtimeout = ATTACH_TIMEOUT;
+int logintimeout = LOGIN_TIMEOUT;
+int changetimeout = CHANGE_TIMEOUT;
+
+/* crosscheck scheduling, see oprora.h */
+int    dbthreads = 1;
+double loginrate = 0;
+void   (*checkpoint)( DBCheck *checks, int count ) = NULL;
+int    checkpointinterval = 0;
 
 /****************************************************************************
 load the oracle dynamic libraries manually. check the oratab to determine
@@ -75,6 +127,7 @@ void loadOraLibs()
 {
   if ( !libclntsh_so_loaded ) {
 
+    unsigned long long t = traceClock();
     char libpath32[MAX_LIB_PATH];
     char libpath[MAX_LIB_PATH];
     char oratab_entry[MAX_LIB_PATH];
@@ -83,6 +136,7 @@ void loadOraLibs()
     int found = 0;
     int i;
     
+    OPR_PROBE0( oralibs__load__start );
     //init ltdl
     if ( lt_dlinit() )
     {
@@ -189,6 +243,12 @@ void loadOraLibs()
       fprintf( stderr, "failed to locate function OCIServerAttach\n" );
       exit(-1);
     }
+    ociserverdetach = lt_dlsym( libclntsh_so, "OCIServerDetach" );
+    if ( !ociserverdetach )
+    {
+      fprintf( stderr, "failed to locate function OCIServerDetach\n" );
+      exit(-1);
+    }
     ocisessionbegin = lt_dlsym( libclntsh_so, "OCISessionBegin" );
     if ( !ocisessionbegin )
     {
@@ -207,13 +267,59 @@ void loadOraLibs()
       fprintf( stderr, "failed to locate function OCIPasswordChange\n" );
       exit(-1);
     }
+    ocistmtprepare2 = lt_dlsym( libclntsh_so, "OCIStmtPrepare2" );
+    if ( !ocistmtprepare2 )
+    {
+      fprintf( stderr, "failed to locate function OCIStmtPrepare2\n" );
+      exit(-1);
+    }
+    ocistmtexecute = lt_dlsym( libclntsh_so, "OCIStmtExecute" );
+    if ( !ocistmtexecute )
+    {
+      fprintf( stderr, "failed to locate function OCIStmtExecute\n" );
+      exit(-1);
+    }
+    ocidefinebypos = lt_dlsym( libclntsh_so, "OCIDefineByPos" );
+    if ( !ocidefinebypos )
+    {
+      fprintf( stderr, "failed to locate function OCIDefineByPos\n" );
+      exit(-1);
+    }
+    ocistmtfetch2 = lt_dlsym( libclntsh_so, "OCIStmtFetch2" );
+    if ( !ocistmtfetch2 )
+    {
+      fprintf( stderr, "failed to locate function OCIStmtFetch2\n" );
+      exit(-1);
+    }
+    ocistmtrelease = lt_dlsym( libclntsh_so, "OCIStmtRelease" );
+    if ( !ocistmtrelease )
+    {
+      fprintf( stderr, "failed to locate function OCIStmtRelease\n" );
+      exit(-1);
+    }
+    ocibreak = lt_dlsym( libclntsh_so, "OCIBreak" );
+    if ( !ocibreak )
+    {
+      fprintf( stderr, "failed to locate function OCIBreak\n" );
+      exit(-1);
+    }
+    ocireset = lt_dlsym( libclntsh_so, "OCIReset" );
+    if ( !ocireset )
+    {
+      fprintf( stderr, "failed to locate function OCIReset\n" );
+      exit(-1);
+    }
 
     libclntsh_so_loaded = 1;
+    traceSince( T_ORALIBS, t );
+    OPR_PROBE0( oralibs__load__done );
   }
 }
 
 void unloadOraLibs()
 {
+  /* abandoned checks may still run in the library */
+  if ( oraAbandoned() ) return;
   if ( libclntsh_so_loaded == 1 )
     lt_dlclose( libclntsh_so );
   lt_dlexit();
@@ -294,6 +400,58 @@ sword errcheck( sword    fresult,
   }
 }
 
+/****************************************************************************
+copy the oracle error message on an error handle into message. returns the
+oracle error code, 0 if it could not be read.
+****************************************************************************/
+int oraMessage( OCIError *error,
+                char     *message,
+                size_t   size )
+{
+  sb4 errorcode = 0;
+  if ( ocierrorget( (void*) error,
+                    1,
+                    0,
+                    &errorcode,
+                    (text*) message,
+                    size,
+                    OCI_HTYPE_ERROR ) != OCI_SUCCESS )
+  {
+    snprintf( message, size, "unable to get oracle error message.\n" );
+    return 0;
+  }
+  return errorcode;
+}
+
+/****************************************************************************
+check the OCI function result on an error handle like errcheck, but keep the
+oracle error message in message instead of printing it, and its error code
+in oracode if that is not NULL, 0 if the error has no oracle error code
+****************************************************************************/
+sword errkeep( sword    fresult,
+               OCIError *error,
+               char     *message,
+               size_t   size,
+               int      *oracode )
+{
+  int code = 0;
+  switch ( fresult )
+  {
+    case OCI_SUCCESS           : return OCI_SUCCESS;
+    case OCI_SUCCESS_WITH_INFO : return OCI_SUCCESS;
+    case OCI_INVALID_HANDLE    : snprintf( message, size,
+                                           "invalid handle.\n" );
+                                 break;
+    case OCI_ERROR             : code = oraMessage( error, message, size );
+                                 break;
+    default                    : snprintf( message, size,
+                                           "unhandled Oracle error %d.\n",
+                                           fresult );
+  }
+  if ( oracode ) *oracode = code;
+  return OCI_ERROR;
+}
+
 /****************************************************************************
 check the OCI function result on an error handle
 ****************************************************************************/
@@ -317,6 +475,140 @@ sword envcheck( sword    fresult,
   }
 }
 
+/****************************************************************************
+a watch on a blocking OCI call. while armed, the watchdog thread breaks the
+call on server when the deadline passes, and marks the watch fired.
+****************************************************************************/
+typedef struct Watch {
+  struct timespec deadline;
+  int             armed;
+  OCIServer       *server;
+  OCIError        *error;
+  int             fired;
+  struct Watch    *next;
+} Watch;
+
+static pthread_mutex_t watchmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  watchcond = PTHREAD_COND_INITIALIZER;
+static Watch           *watches = NULL;
+static int             watchdogrunning = 0;
+
+/****************************************************************************
+compare two points in time, like strcmp.
+****************************************************************************/
+static int timespeccmp( struct timespec *a,
+                        struct timespec *b )
+{
+  if ( a->tv_sec != b->tv_sec ) return a->tv_sec < b->tv_sec ? -1 : 1;
+  if ( a->tv_nsec != b->tv_nsec ) return a->tv_nsec < b->tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/****************************************************************************
+the watchdog thread. sleeps until the earliest armed deadline, or until a
+watch is added, and breaks the calls whose deadline has passed.
+****************************************************************************/
+static void* watchdog( void *arg )
+{
+  struct timespec now, first;
+  Watch           *w;
+  int             waiting;
+
+  pthread_mutex_lock( &watchmutex );
+  for (;;)
+  {
+    clock_gettime( CLOCK_REALTIME, &now );
+    waiting = 0;
+    for ( w = watches; w; w = w->next )
+    {
+      if ( w->fired ) continue;
+      if ( timespeccmp( &w->deadline, &now ) <= 0 )
+      {
+        w->fired = 1;
+        ocibreak( (dvoid*) w->server, w->error );
+      } else
+      if ( !waiting || timespeccmp( &w->deadline, &first ) < 0 )
+      {
+        first = w->deadline;
+        waiting = 1;
+      }
+    }
+    if ( !waiting )
+      pthread_cond_wait( &watchcond, &watchmutex );
+    else
+      pthread_cond_timedwait( &watchcond, &watchmutex, &first );
+  }
+  return NULL;
+}
+
+/****************************************************************************
+arm watch on the calls on server for seconds seconds, but no longer than the
+limit (both 0 is no limit). the watchdog thread is started on first use.
+****************************************************************************/
+static void startWatch( Watch     *watch,
+                        int       seconds,
+                        time_t    limit,
+                        OCIServer *server,
+                        OCIError  *error )
+{
+  pthread_t tid;
+  watch->fired = 0;
+  watch->server = server;
+  watch->error = error;
+  watch->armed = seconds > 0 || limit > 0;
+  if ( !watch->armed ) return;
+  clock_gettime( CLOCK_REALTIME, &watch->deadline );
+  watch->deadline.tv_sec += seconds;
+  if ( limit > 0 && ( seconds == 0 || limit < watch->deadline.tv_sec ) )
+  {
+    watch->deadline.tv_sec = limit;
+    watch->deadline.tv_nsec = 0;
+  }
+  pthread_mutex_lock( &watchmutex );
+  if ( !watchdogrunning &&
+       pthread_create( &tid, NULL, watchdog, NULL ) == 0 )
+  {
+    pthread_detach( tid );
+    watchdogrunning = 1;
+  }
+  watch->next = watches;
+  watches = watch;
+  pthread_cond_signal( &watchcond );
+  pthread_mutex_unlock( &watchmutex );
+}
+
+/****************************************************************************
+disarm watch. returns 1 if the call was broken off, in that case the server
+is reset so it can be used again, 0 otherwise.
+****************************************************************************/
+static int stopWatch( Watch *watch )
+{
+  Watch **w;
+  if ( !watch->armed ) return 0;
+  pthread_mutex_lock( &watchmutex );
+  for ( w = &watches; *w; w = &(*w)->next )
+    if ( *w == watch )
+    {
+      *w = watch->next;
+      break;
+    }
+  pthread_mutex_unlock( &watchmutex );
+  if ( watch->fired )
+    ocireset( (dvoid*) watch->server, watch->error );
+  return watch->fired;
+}
+
+/****************************************************************************
+add us microseconds spent in an OCI call to its metrics histogram and to
+the trace. the trace phases of the OCI calls are in the order of their
+histograms.
+****************************************************************************/
+static void ociSpent( int histogram, unsigned long long us )
+{
+  timeMetric( histogram, us );
+  traceSpent( T_OCI_ENV + histogram - H_OCI_ENV, us );
+}
+
 /****************************************************************************
 change the oldpasswd to new passwd on the database. if anything goes wrong,
 changeDBPassword returns 0, 1 if successfull.
@@ -331,11 +623,15 @@ int changeDBPassword( char* database,
   OCIServer  *server;
   OCISession *session;  
   OCISvcCtx  *service;
+  Watch      watch;
+  unsigned long long start;
   int result = 1;
 
-  /* create the environment handle */
+  OPR_PROBE2( db__change__start, database, schema );
+  /* create the environment handle, threaded for the watchdog */
+  start = metricsClock();
   if ( ocienvcreate( &env, 
-                     OCI_DEFAULT, 
+                     OCI_THREADED, 
                      (dvoid*) 0, 
                      0, 
                      0, 
@@ -346,7 +642,7 @@ int changeDBPassword( char* database,
     fprintf( stderr,
              "OCI environment initialization failure.\n" );
     result = 0;
-  }
+  } else ociSpent( H_OCI_ENV, metricsClock() - start );
   /* allocate an error handle */
   if ( result && ( envcheck( ocihandlealloc( (dvoid*) env,
                                              (dvoid**) &error,                
@@ -362,12 +658,20 @@ int changeDBPassword( char* database,
                                              (dvoid**) 0 ),
                               env ) != OCI_SUCCESS ) ) result = 0;
   /* attach to the database */                            
-  if ( result && ( errcheck( ociserverattach( server, 
-                                              error,
-                                              (text*) database,
-                                              strlen( database ),
-                                              OCI_DEFAULT ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
+  if ( result )
+  {
+    startWatch( &watch, attachtimeout, 0, server, error );
+    start = metricsClock();
+    if ( errcheck( ociserverattach( server, 
+                                    error,
+                                    (text*) database,
+                                    strlen( database ),
+                                    OCI_DEFAULT ),
+                   error ) != OCI_SUCCESS ) result = 0;
+    ociSpent( H_OCI_ATTACH, metricsClock() - start );
+    if ( stopWatch( &watch ) )
+      fprintf( stderr, "attach to %s timed out.\n", database );
+  }
   /* setup a service context */             
   if ( result && ( envcheck( ocihandlealloc( (dvoid*) env,
                                              (dvoid**) &service,                
@@ -397,139 +701,1112 @@ int changeDBPassword( char* database,
                                          error ),
                              error ) != OCI_SUCCESS ) ) result = 0;
   /* change the password */                            
-  if ( result && ( errcheck( ocipasswordchange( service,
-                                                error,
-                                                (text*) schema,
-                                                strlen( schema ),
-                                                (text*) oldpasswd,
-                                                strlen( oldpasswd ),
-                                                (text*) newpasswd,
-                                                strlen( newpasswd ),
-                                                OCI_AUTH ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
+  if ( result )
+  {
+    startWatch( &watch, changetimeout, 0, server, error );
+    start = metricsClock();
+    if ( errcheck( ocipasswordchange( service,
+                                      error,
+                                      (text*) schema,
+                                      strlen( schema ),
+                                      (text*) oldpasswd,
+                                      strlen( oldpasswd ),
+                                      (text*) newpasswd,
+                                      strlen( newpasswd ),
+                                      OCI_AUTH ),
+                   error ) != OCI_SUCCESS ) result = 0;
+    ociSpent( H_OCI_CHANGE, metricsClock() - start );
+    if ( stopWatch( &watch ) )
+      fprintf( stderr, "password change on %s timed out.\n", database );
+  }
                              
   /** all child handles are freed automatically by oracle */                              
   ocihandlefree( env, OCI_HTYPE_ENV );                       
         
+  OPR_PROBE3( db__change__done, database, schema, result );
   return result;                 
 }
 
+/* the environment shared by the threads of a checkDBPasswords run */
+static OCIEnv *checkenv;
+
+/* milliseconds spent creating checkenv */
+static double checkenvtime;
+
+/* if set, checkenv is created once and kept for later runs */
+static int checkenvkept = 0;
+
+/* the time at which a checkDBPasswords run must end, 0 is no limit */
+static time_t checklimit;
+
+/* guards the results of a checkDBPasswords run, which is abandoned when the
+   checks do not return in time. abandonedruns counts the runs abandoned by
+   this process, whose threads may still be running */
+static pthread_mutex_t checkmutex = PTHREAD_MUTEX_INITIALIZER;
+static int             checkabandoned;
+static int             abandonedruns = 0;
+
+/* the checks of the running checkDBPasswords run for its checkpoints.
+   checkdirty is set when a check completed since the last checkpoint, the
+   checkpoint thread runs while checkpointing is set. */
+static DBCheck        *checkall;
+static int            checkcount;
+static int            checkdirty;
+static int            checkpointing;
+static pthread_cond_t checkpointcond = PTHREAD_COND_INITIALIZER;
+
+/* the time before which no next login may begin, with loginrate */
+static pthread_mutex_t pacemutex = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec nextlogin;
+
 /****************************************************************************
-checks the database/schema password combination by attempting a logon.
-returns 1 on succes, 0 otherwise
+the checks of a checkDBPasswords run against a single database, all or a
+part of them. they share one server attach.
 ****************************************************************************/
-int checkDBPassword( char* database, 
-                     char* schema, 
-                     char* passwd )
+typedef struct {
+  DBCheck *checks;
+  int     count;
+} DBGroup;
+
+/****************************************************************************
+milliseconds passed since start, on the monotonic clock
+****************************************************************************/
+static double msSince( struct timespec *start )
 {
-  OCIEnv     *env;
-  OCIError   *error;
-  OCIServer  *server;
-  OCISession *session;  
-  OCISvcCtx  *service;
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - start->tv_sec ) * 1000.0 +
+         ( now.tv_nsec - start->tv_nsec ) / 1000000.0;
+}
+
+/****************************************************************************
+milliseconds passed since start, also added to the OCI histogram of the
+metrics sidecar and to the trace
+****************************************************************************/
+static double ociTime( int histogram, struct timespec *start )
+{
+  double ms = msSince( start );
+  ociSpent( histogram, (unsigned long long) ( ms * 1000 ) );
+  return ms;
+}
+
+/****************************************************************************
+store the result, message, oracle error code and phase timings of a check,
+unless the run has been abandoned.
+****************************************************************************/
+static void finishCheck( DBCheck *check,
+                         int     result,
+                         char    *message,
+                         int     oracode,
+                         double  *timing )
+{
+  OPR_PROBE3( db__check__done, check->database, check->schema, result );
+  pthread_mutex_lock( &checkmutex );
+  if ( !checkabandoned )
+  {
+    check->result = result;
+    strncpy( check->message, message, sizeof( check->message ) );
+    check->message[sizeof( check->message ) - 1] = 0;
+    check->oracode = oracode;
+    memcpy( check->timing, timing, sizeof( check->timing ) );
+    checkdirty = 1;
+  }
+  pthread_mutex_unlock( &checkmutex );
+}
+
+/****************************************************************************
+the checkpoint thread of a checkDBPasswords run. every checkpointinterval
+seconds, and once more when the run ends, it calls checkpoint if checks
+completed since the last call.
+****************************************************************************/
+static void* checkpointer( void *arg )
+{
+  struct timespec wake;
+  pthread_mutex_lock( &checkmutex );
+  for ( ;; )
+  {
+    if ( checkpointing )
+    {
+      clock_gettime( CLOCK_REALTIME, &wake );
+      wake.tv_sec += checkpointinterval;
+      pthread_cond_timedwait( &checkpointcond, &checkmutex, &wake );
+    }
+    if ( checkdirty )
+    {
+      checkpoint( checkall, checkcount );
+      checkdirty = 0;
+    }
+    if ( !checkpointing ) break;
+  }
+  pthread_mutex_unlock( &checkmutex );
+  return NULL;
+}
+
+/****************************************************************************
+waits until the next login may begin, so that no more than loginrate logins
+per second begin over all threads. the wait ends at the run limit. returns
+0 if the run limit has passed, 1 if the login may begin.
+****************************************************************************/
+static int paceLogin()
+{
+  struct timespec now, slot, limit;
+  long            interval;
+
+  if ( loginrate <= 0 ) return checklimit <= 0 || time( 0 ) < checklimit;
+  interval = (long) ( 1000000000.0 / loginrate );
+  pthread_mutex_lock( &pacemutex );
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  if ( timespeccmp( &nextlogin, &now ) < 0 ) nextlogin = now;
+  slot = nextlogin;
+  nextlogin.tv_sec += interval / 1000000000L;
+  nextlogin.tv_nsec += interval % 1000000000L;
+  if ( nextlogin.tv_nsec >= 1000000000L )
+  {
+    nextlogin.tv_sec++;
+    nextlogin.tv_nsec -= 1000000000L;
+  }
+  pthread_mutex_unlock( &pacemutex );
+  if ( checklimit > 0 )
+  {
+    limit = now;
+    limit.tv_sec += checklimit - time( 0 );
+    if ( timespeccmp( &limit, &slot ) < 0 ) slot = limit;
+  }
+  while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &slot, 0 ) == EINTR );
+  return checklimit <= 0 || time( 0 ) < checklimit;
+}
+
+/****************************************************************************
+checks a single schema password by beginning and ending a session on the
+service context, which is attached to the check's database. the session
+handle is allocated for and freed after this check only. the session begin
+is broken off after logintimeout seconds, or when the run limit passes.
+****************************************************************************/
+static void checkSession( OCIServer *server,
+                          OCISvcCtx *service,
+                          OCIError  *error,
+                          DBCheck   *check,
+                          double    *grouptiming )
+{
+  OCISession *session = 0;
+  Watch      watch;
+  struct timespec start;
+  double     timing[DBPHASES];
+  char       message[W_ORAMSG];
   int        authmode;
-  int result = 1;
+  int        oracode = 0;
+  int result = DBCHECK_OK;
 
-  /* create the environment handle */
-  if ( ocienvcreate( &env, 
-                     OCI_DEFAULT, 
-                     (dvoid*) 0, 
-                     0, 
-                     0, 
-                     0, 
-                     (size_t) 0, 
-                     (dvoid**) 0 ) != OCI_SUCCESS )
+  message[0] = 0;
+  memcpy( timing, grouptiming, sizeof( timing ) );
+  if ( checklimit > 0 && time( 0 ) >= checklimit )
   {
-    fprintf( stderr,
-             "OCI environment initialization failure.\n" );
-    return 0;
+    finishCheck( check,
+                 DBCHECK_TIMEOUT,
+                 "crosscheck deadline passed.\n",
+                 0,
+                 timing );
+    return;
+  }
+
+  /* allocate session handle */
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) checkenv,
+                                             (dvoid**) &session,
+                                             OCI_HTYPE_SESSION,
+                                             0,
+                                             (dvoid**) 0 ),
+                              checkenv ) != OCI_SUCCESS ) ) result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) service,
+                                        OCI_HTYPE_SVCCTX,
+                                        (dvoid*) session,
+                                        (ub4) 0,
+                                        OCI_ATTR_SESSION,
+                                        error ),
+                            error,
+                            message,
+                            sizeof( message ),
+                            &oracode ) != OCI_SUCCESS ) )
+    result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) session,
+                                        OCI_HTYPE_SESSION,
+                                        (dvoid*) check->schema,
+                                        (ub4) strlen( check->schema ),
+                                        OCI_ATTR_USERNAME,
+                                        error ),
+                            error,
+                            message,
+                            sizeof( message ),
+                            &oracode ) != OCI_SUCCESS ) )
+    result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) session,
+                                        OCI_HTYPE_SESSION,
+                                        (dvoid*) check->passwd,
+                                        (ub4) strlen( check->passwd ),
+                                        OCI_ATTR_PASSWORD,
+                                        error ),
+                            error,
+                            message,
+                            sizeof( message ),
+                            &oracode ) != OCI_SUCCESS ) )
+    result = 0;
+
+  if ( strncasecmp( check->schema, "sys", strlen( check->schema ) ) )
+    authmode = OCI_DEFAULT;
+  else
+    authmode = OCI_SYSDBA;
+
+  if ( result && !paceLogin() )
+  {
+    result = DBCHECK_TIMEOUT;
+    snprintf( message, sizeof( message ), "crosscheck deadline passed.\n" );
+    oracode = 0;
+  }
+  if ( result == DBCHECK_OK )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    startWatch( &watch, logintimeout, checklimit, server, error );
+    if ( errkeep( ocisessionbegin( service,
+                                   error,
+                                   session,
+                                   OCI_CRED_RDBMS,
+                                   authmode ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) result = 0;
+    if ( stopWatch( &watch ) )
+    {
+      result = DBCHECK_TIMEOUT;
+      snprintf( message, sizeof( message ), "logon timed out.\n" );
+      oracode = 0;
+    }
+    timing[DBPHASE_BEGIN] = ociTime( H_OCI_LOGON, &start );
+  }
+
+  if ( result == DBCHECK_OK )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    if ( errkeep( ocisessionend( service,
+                                 error,
+                                 session,
+                                 OCI_DEFAULT ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) result = 0;
+    timing[DBPHASE_END] = ociTime( H_OCI_LOGOFF, &start );
+  }
+
+  if ( session ) ocihandlefree( session, OCI_HTYPE_SESSION );
+
+  finishCheck( check, result, message, oracode, timing );
+}
+
+/****************************************************************************
+checks all schema passwords of a group without logging on as those schemas.
+a single session is begun as the monitor schema, which reads the password
+verifiers of all database users in one query. each password is then checked
+against the verifiers of its schema locally. checks without a usable
+verifier, or for which the verifiers could not be read, are unverified.
+****************************************************************************/
+static void verifyGroup( OCIServer *server,
+                         OCISvcCtx *service,
+                         OCIError  *error,
+                         DBGroup   *group,
+                         double    *timing )
+{
+  OCISession *session = 0;
+  OCIStmt    *stmt = 0;
+  OCIDefine  *define;
+  Watch      watch;
+  struct timespec start;
+  char       message[W_ORAMSG];
+  char       name[W_USERNAME];
+  char       verifiers[W_VERIFIERS];
+  sb2        indicator;
+  int        *verdict;
+  char       *monitor = group->checks[0].monitor;
+  char       *monitorpasswd = group->checks[0].monitorpasswd;
+  ub4        prefetch = VERIFIER_PREFETCH;
+  int        authmode, i;
+  int        loggedon = 0;
+  int        oracode = 0;
+  sword      r;
+  int result = DBCHECK_OK;
+
+  message[0] = 0;
+  verdict = (int*) malloc( group->count * sizeof( int ) );
+  if ( !verdict )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    exit( -1 );
+  }
+  for ( i = 0; i < group->count; i++ ) verdict[i] = DBCHECK_PENDING;
+
+  /* logon as the monitor schema */
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) checkenv,
+                                             (dvoid**) &session,
+                                             OCI_HTYPE_SESSION,
+                                             0,
+                                             (dvoid**) 0 ),
+                              checkenv ) != OCI_SUCCESS ) ) result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) service,
+                                        OCI_HTYPE_SVCCTX,
+                                        (dvoid*) session,
+                                        (ub4) 0,
+                                        OCI_ATTR_SESSION,
+                                        error ),
+                            error,
+                            message,
+                            sizeof( message ),
+                            &oracode ) != OCI_SUCCESS ) )
+    result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) session,
+                                        OCI_HTYPE_SESSION,
+                                        (dvoid*) monitor,
+                                        (ub4) strlen( monitor ),
+                                        OCI_ATTR_USERNAME,
+                                        error ),
+                            error,
+                            message,
+                            sizeof( message ),
+                            &oracode ) != OCI_SUCCESS ) )
+    result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) session,
+                                        OCI_HTYPE_SESSION,
+                                        (dvoid*) monitorpasswd,
+                                        (ub4) strlen( monitorpasswd ),
+                                        OCI_ATTR_PASSWORD,
+                                        error ),
+                            error,
+                            message,
+                            sizeof( message ),
+                            &oracode ) != OCI_SUCCESS ) )
+    result = 0;
+
+  if ( strncasecmp( monitor, "sys", strlen( monitor ) ) )
+    authmode = OCI_DEFAULT;
+  else
+    authmode = OCI_SYSDBA;
+
+  if ( result && !paceLogin() )
+  {
+    result = DBCHECK_TIMEOUT;
+    snprintf( message, sizeof( message ), "crosscheck deadline passed.\n" );
+    oracode = 0;
+  }
+  if ( result == DBCHECK_OK )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    startWatch( &watch, logintimeout, checklimit, server, error );
+    if ( errkeep( ocisessionbegin( service,
+                                   error,
+                                   session,
+                                   OCI_CRED_RDBMS,
+                                   authmode ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) result = 0;
+    if ( stopWatch( &watch ) )
+    {
+      result = DBCHECK_TIMEOUT;
+      snprintf( message, sizeof( message ), "monitor logon timed out.\n" );
+      oracode = 0;
+    }
+    loggedon = ( result == DBCHECK_OK );
+    timing[DBPHASE_BEGIN] = ociTime( H_OCI_LOGON, &start );
+  }
+
+  /* read the verifiers of all users */
+  if ( result == DBCHECK_OK &&
+       errkeep( ocistmtprepare2( service,
+                                 &stmt,
+                                 error,
+                                 (text*) VERIFIER_QUERY,
+                                 strlen( VERIFIER_QUERY ),
+                                 0,
+                                 0,
+                                 OCI_NTV_SYNTAX,
+                                 OCI_DEFAULT ),
+                error,
+                message,
+                sizeof( message ),
+                &oracode ) != OCI_SUCCESS ) result = 0;
+  if ( result == DBCHECK_OK &&
+       errkeep( ociattrset( (dvoid*) stmt,
+                            OCI_HTYPE_STMT,
+                            (dvoid*) &prefetch,
+                            (ub4) sizeof( prefetch ),
+                            OCI_ATTR_PREFETCH_ROWS,
+                            error ),
+                error,
+                message,
+                sizeof( message ),
+                &oracode ) != OCI_SUCCESS ) result = 0;
+  if ( result == DBCHECK_OK &&
+       errkeep( ocidefinebypos( stmt,
+                                &define,
+                                error,
+                                1,
+                                (dvoid*) name,
+                                sizeof( name ),
+                                SQLT_STR,
+                                (dvoid*) 0,
+                                (ub2*) 0,
+                                (ub2*) 0,
+                                OCI_DEFAULT ),
+                error,
+                message,
+                sizeof( message ),
+                &oracode ) != OCI_SUCCESS ) result = 0;
+  if ( result == DBCHECK_OK &&
+       errkeep( ocidefinebypos( stmt,
+                                &define,
+                                error,
+                                2,
+                                (dvoid*) verifiers,
+                                sizeof( verifiers ),
+                                SQLT_STR,
+                                (dvoid*) &indicator,
+                                (ub2*) 0,
+                                (ub2*) 0,
+                                OCI_DEFAULT ),
+                error,
+                message,
+                sizeof( message ),
+                &oracode ) != OCI_SUCCESS ) result = 0;
+  if ( result == DBCHECK_OK )
+  {
+    startWatch( &watch, logintimeout, checklimit, server, error );
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    if ( errkeep( ocistmtexecute( service,
+                                  stmt,
+                                  error,
+                                  0,
+                                  0,
+                                  (OCISnapshot*) 0,
+                                  (OCISnapshot*) 0,
+                                  OCI_DEFAULT ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) result = 0;
+    while ( result == DBCHECK_OK )
+    {
+      r = ocistmtfetch2( stmt, error, 1, OCI_FETCH_NEXT, 0, OCI_DEFAULT );
+      if ( r == OCI_NO_DATA ) break;
+      if ( errkeep( r, error, message, sizeof( message ), &oracode ) != OCI_SUCCESS )
+      {
+        result = 0;
+        break;
+      }
+      for ( i = 0; i < group->count; i++ )
+      {
+        if ( verdict[i] != DBCHECK_PENDING ||
+             strcasecmp( name, group->checks[i].schema ) ) continue;
+        switch ( indicator == -1 ? VERIFIER_NONE :
+                 checkVerifier( verifiers, group->checks[i].passwd ) )
+        {
+          case VERIFIER_MATCH    : verdict[i] = DBCHECK_OK;
+                                   break;
+          case VERIFIER_MISMATCH : verdict[i] = DBCHECK_INVALID;
+                                   break;
+          default                : verdict[i] = DBCHECK_UNVERIFIED;
+        }
+      }
+    }
+    ociTime( H_OCI_QUERY, &start );
+    if ( stopWatch( &watch ) )
+    {
+      result = DBCHECK_TIMEOUT;
+      snprintf( message, sizeof( message ), "verifier query timed out.\n" );
+      oracode = 0;
+    }
+  }
+  if ( stmt ) ocistmtrelease( stmt, error, (text*) 0, 0, OCI_DEFAULT );
+  if ( loggedon )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    if ( errkeep( ocisessionend( service,
+                                 error,
+                                 session,
+                                 OCI_DEFAULT ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) result = 0;
+    timing[DBPHASE_END] = ociTime( H_OCI_LOGOFF, &start );
+  }
+  if ( session ) ocihandlefree( session, OCI_HTYPE_SESSION );
+
+  /* the verdicts reached stand, even if the session end failed */
+  for ( i = 0; i < group->count; i++ )
+  {
+    switch ( verdict[i] )
+    {
+      case DBCHECK_OK         : finishCheck( &group->checks[i],
+                                             DBCHECK_OK,
+                                             "",
+                                             0,
+                                             timing );
+                                break;
+      case DBCHECK_INVALID    : finishCheck( &group->checks[i],
+                                             DBCHECK_INVALID,
+                                             "password does not match"
+                                             " the verifier.\n",
+                                             0,
+                                             timing );
+                                break;
+      case DBCHECK_UNVERIFIED : finishCheck( &group->checks[i],
+                                             DBCHECK_UNVERIFIED,
+                                             "no usable password"
+                                             " verifier.\n",
+                                             0,
+                                             timing );
+                                break;
+      default                 : if ( result == DBCHECK_TIMEOUT )
+                                  finishCheck( &group->checks[i],
+                                               DBCHECK_TIMEOUT,
+                                               message,
+                                               oracode,
+                                               timing );
+                                else
+                                if ( result == DBCHECK_OK )
+                                  finishCheck( &group->checks[i],
+                                               DBCHECK_INVALID,
+                                               "schema does not exist.\n",
+                                               0,
+                                               timing );
+                                else
+                                  finishCheck( &group->checks[i],
+                                               DBCHECK_UNVERIFIED,
+                                               message,
+                                               oracode,
+                                               timing );
+    }
   }
+  free( verdict );
+}
+
+/****************************************************************************
+checks all schema passwords of a group. the database is attached once, and
+a session is begun and ended per schema on that attach. if the attach fails,
+all checks in the group fail with the attach error. the handles are
+allocated for and freed after this group only, so groups may be checked
+concurrently in an OCI_THREADED environment. the attach is broken off after
+attachtimeout seconds, or when the run limit passes.
+****************************************************************************/
+static void checkGroup( void *item )
+{
+  DBGroup    *group = (DBGroup*) item;
+  OCIError   *error = 0;
+  OCIServer  *server = 0;
+  OCISvcCtx  *service = 0;
+  Watch      watch;
+  struct timespec start;
+  char       message[W_ORAMSG];
+  double     timing[DBPHASES];
+  int        attached = 0;
+  int        i;
+  int        oracode = 0;
+  int result = DBCHECK_OK;
+
+  message[0] = 0;
+  for ( i = 0; i < DBPHASES; i++ ) timing[i] = -1;
+  timing[DBPHASE_ENV] = checkenvtime;
+
   /* allocate an error handle */
-  if ( result && ( envcheck( ocihandlealloc( (dvoid*) env,
-                                             (dvoid**) &error,                
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) checkenv,
+                                             (dvoid**) &error,
                                              OCI_HTYPE_ERROR,
                                              0,
                                             (dvoid**) 0 ),
-                             env ) != OCI_SUCCESS ) ) result = 0;
-  /* allocate a server handle */  
-  if ( result && ( envcheck( ocihandlealloc( (dvoid*) env,
-                                             (dvoid**) &server,                
+                             checkenv ) != OCI_SUCCESS ) ) result = 0;
+  /* allocate a server handle */
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) checkenv,
+                                             (dvoid**) &server,
                                              OCI_HTYPE_SERVER,
                                              0,
                                              (dvoid**) 0 ),
-                             env ) != OCI_SUCCESS ) ) result = 0;                           
-  /* attach to the database */                            
-  if ( result && ( errcheck( ociserverattach( server, 
-                                              error,
-                                              (text*) database,
-                                              strlen( database ),
-                                              OCI_DEFAULT ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
-  /* setup a service context */            
-  if ( result && ( envcheck( ocihandlealloc( (dvoid*) env,
-                                             (dvoid**) &service,                
+                             checkenv ) != OCI_SUCCESS ) ) result = 0;
+  /* attach to the database */
+  if ( result )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    startWatch( &watch, attachtimeout, checklimit, server, error );
+    if ( errkeep( ociserverattach( server,
+                                   error,
+                                   (text*) group->checks[0].database,
+                                   strlen( group->checks[0].database ),
+                                   OCI_DEFAULT ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) result = 0;
+    else attached = 1;
+    if ( stopWatch( &watch ) )
+    {
+      result = DBCHECK_TIMEOUT;
+      snprintf( message, sizeof( message ), "attach timed out.\n" );
+      oracode = 0;
+    }
+    timing[DBPHASE_ATTACH] = ociTime( H_OCI_ATTACH, &start );
+  }
+  /* setup a service context */
+  if ( result == DBCHECK_OK &&
+       ( envcheck( ocihandlealloc( (dvoid*) checkenv,
+                                   (dvoid**) &service,
+                                   OCI_HTYPE_SVCCTX,
+                                   0,
+                                  (dvoid**) 0 ),
+                   checkenv ) != OCI_SUCCESS ) ) result = 0;
+  /* set server in service context */
+  if ( result == DBCHECK_OK &&
+       ( errkeep( ociattrset( (dvoid*) service,
+                              OCI_HTYPE_SVCCTX,
+                              (dvoid*) server,
+                              (ub4) 0,
+                              OCI_ATTR_SERVER,
+                              error ),
+                  error,
+                  message,
+                  sizeof( message ),
+                  &oracode ) != OCI_SUCCESS ) ) result = 0;
+
+  if ( result == DBCHECK_OK && group->checks[0].monitor )
+    verifyGroup( server, service, error, group, timing );
+  else
+  for ( i = 0; i < group->count; i++ )
+  {
+    if ( result == DBCHECK_OK )
+      checkSession( server, service, error, &group->checks[i], timing );
+    else
+      finishCheck( &group->checks[i], result, message, oracode, timing );
+  }
+
+  /* the environment lives on, so free the child handles explicitly */
+  if ( attached ) ociserverdetach( server, error, OCI_DEFAULT );
+  if ( service ) ocihandlefree( service, OCI_HTYPE_SVCCTX );
+  if ( server ) ocihandlefree( server, OCI_HTYPE_SERVER );
+  if ( error ) ocihandlefree( error, OCI_HTYPE_ERROR );
+}
+
+/****************************************************************************
+copy s to *p, moving *p past the copy. returns the copy.
+****************************************************************************/
+static char *copyString( char **p, const char *s )
+{
+  char *copy = *p;
+  size_t n = strlen( s ) + 1;
+  memcpy( copy, s, n );
+  *p += n;
+  return copy;
+}
+
+/****************************************************************************
+a copy of count checks in a single allocation of *size bytes, with their
+names and passwords, owned by a checkDBPasswords run. threads of a run that
+is abandoned keep using it, so it does not depend on the buffers of the
+caller. returns NULL if out of memory.
+****************************************************************************/
+static DBCheck *copyChecks( DBCheck *checks, int count, size_t *size )
+{
+  DBCheck *copy;
+  char    *p;
+  int     i;
+  *size = count * sizeof( DBCheck );
+  for ( i = 0; i < count; i++ )
+  {
+    *size += strlen( checks[i].database ) + strlen( checks[i].schema ) +
+             strlen( checks[i].passwd ) + 3;
+    if ( checks[i].monitor )
+      *size += strlen( checks[i].monitor ) +
+               strlen( checks[i].monitorpasswd ) + 2;
+  }
+  copy = (DBCheck*) malloc( *size );
+  if ( !copy ) return NULL;
+  memcpy( copy, checks, count * sizeof( DBCheck ) );
+  p = (char*) ( copy + count );
+  for ( i = 0; i < count; i++ )
+  {
+    copy[i].database = copyString( &p, checks[i].database );
+    copy[i].schema = copyString( &p, checks[i].schema );
+    copy[i].passwd = copyString( &p, checks[i].passwd );
+    if ( checks[i].monitor )
+    {
+      copy[i].monitor = copyString( &p, checks[i].monitor );
+      copy[i].monitorpasswd = copyString( &p, checks[i].monitorpasswd );
+    }
+  }
+  return copy;
+}
+
+/****************************************************************************
+copy the results of count checks run on their copy back to checks.
+****************************************************************************/
+static void copyResults( DBCheck *checks, DBCheck *run, int count )
+{
+  int i;
+  for ( i = 0; i < count; i++ )
+  {
+    checks[i].result = run[i].result;
+    checks[i].oracode = run[i].oracode;
+    memcpy( checks[i].message, run[i].message, sizeof( checks[i].message ) );
+    memcpy( checks[i].timing, run[i].timing, sizeof( checks[i].timing ) );
+  }
+}
+
+/****************************************************************************
+checks count database/schema password combinations, sharing one OCI_THREADED
+environment. the checks must be ordered by database; the checks of one
+database are split over at most dbthreads server attaches, and at most
+threads attaches are used concurrently. if deadline is not 0, the run ends after deadline
+seconds; checks that have not completed by then are timed out. the result
+and message of each check are stored in its DBCheck. the checks run on a
+copy, so the caller may free its buffers once this returns. returns 0 if
+checks were abandoned at the deadline, whose threads may still be running
+on that copy, see oraAbandoned, 1 otherwise.
+****************************************************************************/
+int checkDBPasswords( DBCheck *checks,
+                      int     count,
+                      int     threads,
+                      int     deadline )
+{
+  DBGroup   *groups;
+  DBCheck   *run;
+  struct timespec start;
+  pthread_t checkpointthread;
+  size_t    size = 0;
+  int       i, g, p, n, parts, completed;
+
+  for ( i = 0; i < count; i++ )
+  {
+    checks[i].result = DBCHECK_PENDING;
+    checks[i].message[0] = 0;
+    checks[i].oracode = 0;
+    for ( p = 0; p < DBPHASES; p++ ) checks[i].timing[p] = -1;
+    OPR_PROBE2( db__check__start, checks[i].database, checks[i].schema );
+  }
+  checkabandoned = 0;
+  checklimit = deadline > 0 ? time( 0 ) + deadline : 0;
+
+  groups = (DBGroup*) malloc( count * sizeof( DBGroup ) );
+  run = copyChecks( checks, count, &size );
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  if ( !groups || !run || ( !checkenvkept &&
+                    ocienvcreate( &checkenv,
+                                  OCI_THREADED,
+                                  (dvoid*) 0,
+                                  0,
+                                  0,
+                                  0,
+                                  (size_t) 0,
+                                  (dvoid**) 0 ) != OCI_SUCCESS ) )
+  {
+    for ( i = 0; i < count; i++ )
+    {
+      checks[i].result = DBCHECK_INVALID;
+      snprintf( checks[i].message,
+                sizeof( checks[i].message ),
+                "OCI environment initialization failure.\n" );
+    }
+    if ( run ) memset( run, 0, size );
+    free( run );
+    free( groups );
+    return 1;
+  }
+  checkenvtime = checkenvkept ? 0 : ociTime( H_OCI_ENV, &start );
+
+  /* the checks of a database are split over at most dbthreads groups,
+     except with verifiers, which are read once per database */
+  g = 0;
+  for ( i = 0; i < count; i += n )
+  {
+    for ( n = 1;
+          i + n < count && strcmp( run[i].database,
+                                   run[i+n].database ) == 0;
+          n++ );
+    parts = run[i].monitor || dbthreads < 1 ? 1 :
+            dbthreads < n ? dbthreads : n;
+    for ( p = 0; p < parts; p++ )
+    {
+      groups[g].checks = &run[i + n * p / parts];
+      groups[g].count = n * ( p + 1 ) / parts - n * p / parts;
+      g++;
+    }
+  }
+  checkall = run;
+  checkcount = count;
+  checkdirty = 0;
+  checkpointing = checkpoint && checkpointinterval > 0;
+  if ( checkpointing &&
+       pthread_create( &checkpointthread, NULL, checkpointer, NULL ) != 0 )
+    checkpointing = 0;
+  completed = runPool( groups,
+                       g,
+                       sizeof( DBGroup ),
+                       threads,
+                       checkGroup,
+                       checklimit > 0 ? checklimit + BREAK_GRACE : 0 );
+  if ( checkpointing )
+  {
+    pthread_mutex_lock( &checkmutex );
+    checkpointing = 0;
+    pthread_cond_signal( &checkpointcond );
+    pthread_mutex_unlock( &checkmutex );
+    pthread_join( checkpointthread, NULL );
+  }
+  if ( completed )
+  {
+    if ( !checkenvkept ) ocihandlefree( checkenv, OCI_HTYPE_ENV );
+    copyResults( checks, run, count );
+    memset( run, 0, size );
+    free( run );
+    free( groups );
+    return 1;
+  } else
+  {
+    /* checks still blocked are abandoned, with the environment, the groups
+       and the copy of the checks they use */
+    pthread_mutex_lock( &checkmutex );
+    checkabandoned = 1;
+    abandonedruns++;
+    copyResults( checks, run, count );
+    for ( i = 0; i < count; i++ )
+      if ( checks[i].result == DBCHECK_PENDING )
+      {
+        checks[i].result = DBCHECK_TIMEOUT;
+        snprintf( checks[i].message,
+                  sizeof( checks[i].message ),
+                  "crosscheck deadline passed.\n" );
+      }
+    pthread_mutex_unlock( &checkmutex );
+    return 0;
+  }
+}
+
+/****************************************************************************
+tell if checkDBPasswords abandoned checks in this process, which may still
+be running in the oracle client library. the library must then not be
+unloaded, nor may the process run its exit handlers under them: it ends
+with _exit.
+****************************************************************************/
+int oraAbandoned()
+{
+  int abandoned;
+  pthread_mutex_lock( &checkmutex );
+  abandoned = abandonedruns > 0;
+  pthread_mutex_unlock( &checkmutex );
+  return abandoned;
+}
+
+/****************************************************************************
+creates the environment of checkDBPasswords now, and keeps it for all later
+runs, for processes that check passwords repeatedly.
+****************************************************************************/
+void keepOraEnv()
+{
+  if ( checkenvkept ) return;
+  if ( ocienvcreate( &checkenv,
+                     OCI_THREADED,
+                     (dvoid*) 0,
+                     0,
+                     0,
+                     0,
+                     (size_t) 0,
+                     (dvoid**) 0 ) == OCI_SUCCESS ) checkenvkept = 1;
+}
+
+/****************************************************************************
+checks the database/schema password combination by attempting a logon.
+returns 1 on succes, 0 otherwise
+****************************************************************************/
+int checkDBPassword( char* database, 
+                     char* schema, 
+                     char* passwd )
+{
+  DBCheck check;
+  check.database = database;
+  check.schema = schema;
+  check.passwd = passwd;
+  check.monitor = NULL;
+  checkDBPasswords( &check, 1, 1, 0 );
+  if ( strlen( check.message ) > 0 )
+    fprintf( stderr, "%s", check.message );
+  return check.result == DBCHECK_OK;
+}
+
+/* the environment shared by the threads of a changeDBPasswords run */
+static OCIEnv *changeenv;
+
+/****************************************************************************
+changes a single password on its own server attach, keeping the oracle
+error message in the DBChange. the attach and the change are broken off
+after attachtimeout and changetimeout seconds.
+****************************************************************************/
+static void changeOne( void *item )
+{
+  DBChange   *change = (DBChange*) item;
+  OCIError   *error = 0;
+  OCIServer  *server = 0;
+  OCISvcCtx  *service = 0;
+  OCISession *session = 0;
+  Watch      watch;
+  unsigned long long start;
+  int        attached = 0;
+  int        changed = 0;
+  int result = DBCHECK_OK;
+
+  change->message[0] = 0;
+  OPR_PROBE2( db__change__start, change->database, change->schema );
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) changeenv,
+                                             (dvoid**) &error,
+                                             OCI_HTYPE_ERROR,
+                                             0,
+                                             (dvoid**) 0 ),
+                             changeenv ) != OCI_SUCCESS ) ) result = 0;
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) changeenv,
+                                             (dvoid**) &server,
+                                             OCI_HTYPE_SERVER,
+                                             0,
+                                             (dvoid**) 0 ),
+                             changeenv ) != OCI_SUCCESS ) ) result = 0;
+  if ( result )
+  {
+    startWatch( &watch, attachtimeout, 0, server, error );
+    start = metricsClock();
+    if ( errkeep( ociserverattach( server,
+                                   error,
+                                   (text*) change->database,
+                                   strlen( change->database ),
+                                   OCI_DEFAULT ),
+                  error,
+                  change->message,
+                  sizeof( change->message ),
+                  NULL ) != OCI_SUCCESS ) result = 0;
+    else attached = 1;
+    ociSpent( H_OCI_ATTACH, metricsClock() - start );
+    if ( stopWatch( &watch ) )
+    {
+      /* nothing was changed yet */
+      result = 0;
+      snprintf( change->message,
+                sizeof( change->message ),
+                "attach timed out.\n" );
+    }
+  }
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) changeenv,
+                                             (dvoid**) &service,
                                              OCI_HTYPE_SVCCTX,
                                              0,
-                                            (dvoid**) 0 ),
-                             env ) != OCI_SUCCESS ) ) result = 0;
-  /* set server in service context */
-  if ( result && ( errcheck( ociattrset( (dvoid*) service,
-                                         OCI_HTYPE_SVCCTX,
-                                         (dvoid*) server,
-                                         (ub4) 0,
-                                         OCI_ATTR_SERVER,
-                                         error ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
-  /* allocate session handle */                 
-  if ( result && ( envcheck( ocihandlealloc( (dvoid*) env,
-                                             (dvoid**) &session,                
+                                             (dvoid**) 0 ),
+                             changeenv ) != OCI_SUCCESS ) ) result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) service,
+                                        OCI_HTYPE_SVCCTX,
+                                        (dvoid*) server,
+                                        (ub4) 0,
+                                        OCI_ATTR_SERVER,
+                                        error ),
+                            error,
+                            change->message,
+                            sizeof( change->message ),
+                            NULL ) != OCI_SUCCESS ) )
+    result = 0;
+  if ( result && ( envcheck( ocihandlealloc( (dvoid*) changeenv,
+                                             (dvoid**) &session,
                                              OCI_HTYPE_SESSION,
                                              0,
                                              (dvoid**) 0 ),
-                              env ) != OCI_SUCCESS ) ) result = 0;
-  if ( result && ( errcheck( ociattrset( (dvoid*) service,
-                                         OCI_HTYPE_SVCCTX,
-                                         (dvoid*) session,
-                                         (ub4) 0,
-                                         OCI_ATTR_SESSION,
-                                         error ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
-  if ( result && ( errcheck( ociattrset( (dvoid*) session,
-                                         OCI_HTYPE_SESSION,
-                                         (dvoid*) schema,
-                                         (ub4) strlen( schema ),
-                                         OCI_ATTR_USERNAME,
-                                         error ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
-  if ( result && ( errcheck( ociattrset( (dvoid*) session,
-                                         OCI_HTYPE_SESSION,
-                                         (dvoid*) passwd,
-                                         (ub4) strlen( passwd ),
-                                         OCI_ATTR_PASSWORD,
-                                         error ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
-
-  if ( strncasecmp( schema, "sys", strlen( schema ) ) )
-    authmode = OCI_DEFAULT;
-  else
-    authmode = OCI_SYSDBA;
+                             changeenv ) != OCI_SUCCESS ) ) result = 0;
+  if ( result && ( errkeep( ociattrset( (dvoid*) service,
+                                        OCI_HTYPE_SVCCTX,
+                                        (dvoid*) session,
+                                        (ub4) 0,
+                                        OCI_ATTR_SESSION,
+                                        error ),
+                            error,
+                            change->message,
+                            sizeof( change->message ),
+                            NULL ) != OCI_SUCCESS ) )
+    result = 0;
+  if ( result )
+  {
+    startWatch( &watch, changetimeout, 0, server, error );
+    start = metricsClock();
+    if ( errkeep( ocipasswordchange( service,
+                                     error,
+                                     (text*) change->schema,
+                                     strlen( change->schema ),
+                                     (text*) change->oldpasswd,
+                                     strlen( change->oldpasswd ),
+                                     (text*) change->newpasswd,
+                                     strlen( change->newpasswd ),
+                                     OCI_AUTH ),
+                  error,
+                  change->message,
+                  sizeof( change->message ),
+                  NULL ) != OCI_SUCCESS ) result = 0;
+    else changed = 1;
+    ociSpent( H_OCI_CHANGE, metricsClock() - start );
+    if ( stopWatch( &watch ) )
+    {
+      result = DBCHECK_TIMEOUT;
+      snprintf( change->message,
+                sizeof( change->message ),
+                "password change timed out.\n" );
+    }
+  }
+  /* the change began a session */
+  if ( changed ) ocisessionend( service, error, session, OCI_DEFAULT );
 
-  if ( result && ( errcheck( ocisessionbegin( service,
-                                              error,
-                                              session,
-                                              OCI_CRED_RDBMS,
-                                              authmode ),
-                             error ) != OCI_SUCCESS ) ) result = 0;
-                             
-  if ( result && ( errcheck( ocisessionend( service,
-                                            error,
-                                            session,
-                                            OCI_DEFAULT ),
-                             error ) != OCI_SUCCESS ) ) result = 0;                               
-                
-  /** all child handles are freed automatically by oracle */                       
-  ocihandlefree( env, OCI_HTYPE_ENV );                                
-                             
-  return result;                 
+  if ( attached ) ociserverdetach( server, error, OCI_DEFAULT );
+  if ( session ) ocihandlefree( session, OCI_HTYPE_SESSION );
+  if ( service ) ocihandlefree( service, OCI_HTYPE_SVCCTX );
+  if ( server ) ocihandlefree( server, OCI_HTYPE_SERVER );
+  if ( error ) ocihandlefree( error, OCI_HTYPE_ERROR );
+  change->result = result;
+  OPR_PROBE3( db__change__done, change->database, change->schema, result );
 }
 
+/****************************************************************************
+changes count passwords, at most threads at a time, sharing one OCI_THREADED
+environment, the one kept by keepOraEnv if any. each change has its own
+server attach. the result and message of each change are stored in its
+DBChange.
+****************************************************************************/
+void changeDBPasswords( DBChange *changes,
+                        int      count,
+                        int      threads )
+{
+  struct timespec start;
+  int i;
+  if ( checkenvkept )
+  {
+    changeenv = checkenv;
+    runPool( changes, count, sizeof( DBChange ), threads, changeOne, 0 );
+    return;
+  }
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  if ( ocienvcreate( &changeenv,
+                     OCI_THREADED,
+                     (dvoid*) 0,
+                     0,
+                     0,
+                     0,
+                     (size_t) 0,
+                     (dvoid**) 0 ) != OCI_SUCCESS )
+  {
+    for ( i = 0; i < count; i++ )
+    {
+      changes[i].result = DBCHECK_INVALID;
+      snprintf( changes[i].message,
+                sizeof( changes[i].message ),
+                "OCI environment initialization failure.\n" );
+    }
+    return;
+  }
+  ociTime( H_OCI_ENV, &start );
+  runPool( changes, count, sizeof( DBChange ), threads, changeOne, 0 );
+  ocihandlefree( changeenv, OCI_HTYPE_ENV );
+}
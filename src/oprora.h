@@ -22,6 +22,93 @@
 
 ****************************************************************************/
 
+#ifndef _OPRORA_H
+#define _OPRORA_H 1
+
+/* size of the buffer holding an oracle error message */
+#define W_ORAMSG 512
+
+/* results of a password check */
+#define DBCHECK_PENDING -1
+#define DBCHECK_INVALID  0
+#define DBCHECK_OK       1
+#define DBCHECK_TIMEOUT  2
+#define DBCHECK_UNVERIFIED 3
+
+/* phases of a password check that are timed */
+#define DBPHASE_ENV    0
+#define DBPHASE_ATTACH 1
+#define DBPHASE_BEGIN  2
+#define DBPHASE_END    3
+#define DBPHASES       4
+
+/****************************************************************************
+a single password check :
+  database - the name of the database
+  schema   - the name of the schema
+  passwd   - the (decrypted) password to check
+  monitor  - if not NULL, the schema used to read the password verifiers of
+             the database. all checks of one database use the same monitor.
+  monitorpasswd - the (decrypted) password of the monitor schema
+  result   - set by checkDBPasswords, one of the DBCHECK results
+  message  - set by checkDBPasswords, the oracle error message if any
+  oracode  - set by checkDBPasswords, the oracle error code, 0 if none
+  timing   - set by checkDBPasswords, the milliseconds spent per DBPHASE,
+             -1 for a phase that was not run. the environment and the attach
+             are shared by the checks of a run and of a database, and so
+             are their timings.
+****************************************************************************/
+typedef struct {
+  char *database;
+  char *schema;
+  char *passwd;
+  char *monitor;
+  char *monitorpasswd;
+  int    result;
+  char   message[W_ORAMSG];
+  int    oracode;
+  double timing[DBPHASES];
+} DBCheck;
+
+/****************************************************************************
+a single password change :
+  database  - the name of the database
+  schema    - the name of the schema
+  oldpasswd - the current (decrypted) password
+  newpasswd - the new password
+  result    - set by changeDBPasswords, DBCHECK_OK if changed,
+              DBCHECK_INVALID if not, DBCHECK_TIMEOUT if broken off, in which
+              case the password may or may not have been changed
+  message   - set by changeDBPasswords, the oracle error message if any
+****************************************************************************/
+typedef struct {
+  char *database;
+  char *schema;
+  char *oldpasswd;
+  char *newpasswd;
+  int  result;
+  char message[W_ORAMSG];
+} DBChange;
+
+/* seconds an attach, a logon and a password change may take, 0 is no limit */
+extern int attachtimeout;
+extern int logintimeout;
+extern int changetimeout;
+
+/* crosscheck scheduling : the number of concurrent attaches per database,
+   the maximum number of logins per second over all databases (0 is no
+   limit), and a function that checkDBPasswords calls with its checks about
+   every checkpointinterval seconds while it runs. the results are stable
+   during the call, checks still running are DBCHECK_PENDING. */
+extern int    dbthreads;
+extern double loginrate;
+extern void   (*checkpoint)( DBCheck *checks, int count );
+extern int    checkpointinterval;
+
+void loadOraLibs();
+
+void unloadOraLibs();
+
 int changeDBPassword( char* database, 
                       char* schema, 
                       char* oldpasswd,
@@ -29,5 +116,19 @@ int changeDBPassword( char* database,
                       
 int checkDBPassword( char* database, 
                      char* schema, 
-                     char* passwd );                      
+                     char* passwd );
+
+int checkDBPasswords( DBCheck *checks,
+                      int     count,
+                      int     threads,
+                      int     deadline );
+
+void keepOraEnv();
+
+int oraAbandoned();
+
+void changeDBPasswords( DBChange *changes,
+                        int      count,
+                        int      threads );
 
+#endif // !_OPRORA_H
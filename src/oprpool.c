@@ -0,0 +1,159 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include "oprpool.h"
+
+/* maximum number of worker threads in a pool (practical value) */
+#define MAX_THREADS 64
+
+/****************************************************************************
+the state shared by the threads of one pool. items are handed out in array
+order, each item is processed exactly once. finished counts the processed
+items, the done condition is signalled when all are.
+****************************************************************************/
+typedef struct {
+  char            *items;
+  int             count;
+  size_t          size;
+  int             next;
+  int             finished;
+  void            (*work)( void* );
+  pthread_mutex_t mutex;
+  pthread_cond_t  done;
+} Pool;
+
+/****************************************************************************
+  purpose: worker thread, takes the next unprocessed item until none are
+           left.
+****************************************************************************/
+static void* poolWorker( void *arg )
+{
+  Pool *pool = (Pool*) arg;
+  int  i;
+  for (;;)
+  {
+    pthread_mutex_lock( &pool->mutex );
+    i = pool->next++;
+    pthread_mutex_unlock( &pool->mutex );
+    if ( i >= pool->count ) break;
+    pool->work( pool->items + i * pool->size );
+    pthread_mutex_lock( &pool->mutex );
+    if ( ++pool->finished == pool->count )
+      pthread_cond_signal( &pool->done );
+    pthread_mutex_unlock( &pool->mutex );
+  }
+  return NULL;
+}
+
+/****************************************************************************
+  purpose: call work for each of the count items (each size bytes) using at
+           most threads threads. the work function must only modify the
+           item it is passed.
+  pre    : 
+  post   : returns 1 when work has been called for every item. if deadline
+           is not 0 and passes before that, the pool is abandoned and 0 is
+           returned; unfinished items may still be worked on, and no further
+           items are started.
+****************************************************************************/
+int runPool( void   *items,
+             int    count,
+             size_t size,
+             int    threads,
+             void   (*work)( void* ),
+             time_t deadline )
+{
+  pthread_t       tids[MAX_THREADS];
+  struct timespec until;
+  Pool            *pool;
+  int             i, started, complete;
+
+  if ( threads > MAX_THREADS ) threads = MAX_THREADS;
+  if ( threads > count ) threads = count;
+  if ( count == 0 ) return 1;
+
+  /* abandoned workers may outlive this call, so the pool is on the heap */
+  pool = (Pool*) malloc( sizeof( Pool ) );
+  if ( !pool )
+  {
+    fprintf( stderr, "out of memory.\n" );
+    exit( -1 );
+  }
+  pool->items = (char*) items;
+  pool->count = count;
+  pool->size = size;
+  pool->next = 0;
+  pool->finished = 0;
+  pool->work = work;
+  pthread_mutex_init( &pool->mutex, NULL );
+  pthread_cond_init( &pool->done, NULL );
+
+  started = 0;
+  for ( i = 0; i < threads; i++ )
+  {
+    if ( pthread_create( &tids[started], NULL, poolWorker, pool ) != 0 )
+    {
+      fprintf( stderr, "unable to start worker thread %d.\n", i );
+      break;
+    }
+    started++;
+  }
+  /* no threads at all, work in the calling thread without a deadline */
+  if ( started == 0 ) poolWorker( pool );
+
+  until.tv_sec = deadline;
+  until.tv_nsec = 0;
+  pthread_mutex_lock( &pool->mutex );
+  while ( pool->finished < pool->count )
+  {
+    if ( deadline == 0 )
+      pthread_cond_wait( &pool->done, &pool->mutex );
+    else
+    if ( pthread_cond_timedwait( &pool->done,
+                                 &pool->mutex,
+                                 &until ) == ETIMEDOUT )
+      break;
+  }
+  complete = pool->finished == pool->count;
+  if ( !complete ) pool->next = pool->count;
+  pthread_mutex_unlock( &pool->mutex );
+
+  /* abandoned workers are left running, they are not joined */
+  if ( complete )
+  {
+    for ( i = 0; i < started; i++ )
+      pthread_join( tids[i], NULL );
+    pthread_cond_destroy( &pool->done );
+    pthread_mutex_destroy( &pool->mutex );
+    free( pool );
+  }
+  return complete;
+}
@@ -0,0 +1,53 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRPROBES_H
+#define _OPRPROBES_H 1
+
+/****************************************************************************
+USDT probes of provider opr, for bpftrace, perf and systemtap. with
+sys/sdt.h a probe is a nop instruction plus a note in the executable, so it
+costs nothing until it is traced. without sys/sdt.h the probes are left out.
+the probes are listed in README, the scripts in probes/ use them.
+****************************************************************************/
+#ifdef HAVE_SYS_SDT_H
+  #include <sys/sdt.h>
+  #define OPR_PROBE0( name ) DTRACE_PROBE( opr, name )
+  #define OPR_PROBE1( name, a ) DTRACE_PROBE1( opr, name, a )
+  #define OPR_PROBE2( name, a, b ) DTRACE_PROBE2( opr, name, a, b )
+  #define OPR_PROBE3( name, a, b, c ) DTRACE_PROBE3( opr, name, a, b, c )
+  #define OPR_PROBE4( name, a, b, c, d ) \
+          DTRACE_PROBE4( opr, name, a, b, c, d )
+  #define OPR_PROBE5( name, a, b, c, d, e ) \
+          DTRACE_PROBE5( opr, name, a, b, c, d, e )
+#else
+  #define OPR_PROBE0( name ) do {} while ( 0 )
+  #define OPR_PROBE1( name, a ) do {} while ( 0 )
+  #define OPR_PROBE2( name, a, b ) do {} while ( 0 )
+  #define OPR_PROBE3( name, a, b, c ) do {} while ( 0 )
+  #define OPR_PROBE4( name, a, b, c, d ) do {} while ( 0 )
+  #define OPR_PROBE5( name, a, b, c, d, e ) do {} while ( 0 )
+#endif
+
+#endif // !_OPRPROBES_H
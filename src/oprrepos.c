@@ -0,0 +1,1546 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "oprrepos.h"
+#include "oprlock.h"
+#include "oprmetrics.h"
+#include "oprtrace.h"
+#include "oprprobes.h"
+
+/* number of nanoseconds to wait before lock retry */
+#define LOCK_SLEEP 40000000
+
+/* number of lock retries before giving up */
+#define LOCK_RETRIES 100
+
+/* the changes recorded by a handle */
+#define C_ADD      0
+#define C_DELETE   1
+#define C_PASSWORD 2
+#define C_DELUSER  3
+
+/* the view changes of reposSetViews */
+#define V_KEEP   -1
+#define V_REMOVE  0
+#define V_CREATE  1
+
+/****************************************************************************
+the repository header.
+   magic      - this field is used to validate the file as being a repository.
+   reposowner - holds the osusername of the repository creator.
+   logfile    - name of the logfile. if logging not enabled, empty string.
+   entries    - holds the number of entries in the repository.
+   generation - incremented each time the repository is written (1.2.0).
+   loglevel   - one of the LOG values (1.3.0).
+   loginterval- seconds successful reads are summarized over (1.3.0).
+****************************************************************************/
+typedef struct {
+  char   magic[W_MAGIC];
+  char   reposowner[W_OSUSERNAME];
+  char   logfile[W_LOGFILE];
+  int    entries;
+  int    generation;
+  int    loglevel;
+  int    loginterval;
+} Header;
+
+/****************************************************************************
+a change made to a loaded repository, kept until it is committed.
+   type  - one of the C values.
+   entry - the entry added with its encrypted password, the names of the
+           entry deleted, the database and schema of a password change
+           with the new password, unencrypted, or the osuser whose entries
+           were deleted.
+****************************************************************************/
+typedef struct {
+  int   type;
+  Entry entry;
+} Change;
+
+/****************************************************************************
+a loaded repository.
+   filename   - the repository file.
+   header     - its header, the entries count being that of entries.
+   headersize - bytes of the header in the file.
+   entries    - the entries, sorted by compareEntries.
+   allocated  - room in entries.
+   byuser     - the entries sorted by osuser, then as entries, built when
+                first needed after a change.
+   indexed    - set if byuser is that of entries.
+   loaded     - the file as it was loaded or last written, to tell if it
+                was written by another process since.
+   changes    - the changes since, replayed when it was.
+   logchanged - set if the log settings in header were changed since.
+   views      - one of the V values, set by reposSetViews.
+   stream     - the read locked file of a handle of reposOpenStream, at the
+                next entry.
+   remaining  - the entries of stream not read yet.
+   lockwait   - the last lock attempt.
+   error      - the errno of the last failure.
+   lock       - serializes changes with lookups.
+****************************************************************************/
+struct Repos {
+  char             filename[W_REPOSNAME];
+  Header           header;
+  long             headersize;
+  Entry            *entries;
+  int              allocated;
+  const Entry      **byuser;
+  int              indexed;
+  struct stat      loaded;
+  Change           *changes;
+  int              nchanges;
+  int              allocatedchanges;
+  int              logchanged;
+  int              views;
+  FILE             *stream;
+  int              remaining;
+  Header           logsettings;
+  LockWait         lockwait;
+  int              error;
+  pthread_rwlock_t lock;
+};
+
+#ifndef HAVE_RANDOM_R
+/* srand and rand are not reentrant */
+static pthread_mutex_t randlock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/****************************************************************************
+describe a REPOS result.
+****************************************************************************/
+const char *reposError( int result )
+{
+  switch ( result )
+  {
+    case REPOS_OK      : return "ok";
+    case REPOS_EOPEN   : return "unable to open the repository";
+    case REPOS_EEXIST  : return "the repository exists";
+    case REPOS_ELOCK   : return "unable to lock the repository";
+    case REPOS_EFORMAT : return "not a valid OPR repository";
+    case REPOS_EREAD   : return "read failure";
+    case REPOS_EWRITE  : return "write failure";
+    case REPOS_ENOENT  : return "entry does not exist";
+    case REPOS_EDUP    : return "entry exists";
+    case REPOS_EFULL   : return "max_entries reached";
+    case REPOS_ENAME   : return "name too long";
+    case REPOS_ENOMEM  : return "out of memory";
+    case REPOS_EVIEWS  : return "unable to write the views";
+  }
+  return "unknown error";
+}
+
+/****************************************************************************
+compare two entries. sorted on database, schemaname, osusername. comparison
+is case sensitive. this function is passed to qsort.
+****************************************************************************/
+int compareEntries( const void *p1, const void *p2 )
+{
+  int result = strncmp( ((const Entry*)p1)->database,
+                        ((const Entry*)p2)->database,
+                        W_DATABASE );
+  if ( !result )
+  {
+    result = strncmp( ((const Entry*)p1)->schemaname,
+                      ((const Entry*)p2)->schemaname,
+                      W_SCHEMANAME );
+    if ( !result )
+    {
+      result = strncmp( ((const Entry*)p1)->osusername,
+                        ((const Entry*)p2)->osusername,
+                        W_OSUSERNAME );
+    }
+  }
+  return result;
+}
+
+/****************************************************************************
+encrypt or decrypt password, the W_PASSWORD bytes of the password of entry.
+the stream is that of rand after srand with the sum of the names of entry,
+random_r is used for it where available, so this is reentrant. Note that
+encryption is too strong a word for the algorithm :), the entry is just
+made unreadable for the prowling eye. Do not rely on the encryption for
+your password's safety, rely on the UNIX access rights on the repository
+file.
+****************************************************************************/
+static void cryptPassword( const Entry *entry, char *password )
+{
+  int seed = 0, i;
+#ifdef HAVE_RANDOM_R
+  struct random_data data;
+  char               state[128];
+  int32_t            r;
+#endif
+  for ( i = 0; i < W_DATABASE; i++ )
+    seed += entry->database[i];
+  for ( i = 0; i < W_SCHEMANAME; i++ )
+    seed += entry->schemaname[i];
+  for ( i = 0; i < W_OSUSERNAME; i++ )
+    seed += entry->osusername[i];
+#ifdef HAVE_RANDOM_R
+  /* a 128 byte state is the one of rand */
+  memset( &data, 0, sizeof( data ) );
+  initstate_r( seed, state, sizeof( state ), &data );
+  for ( i = 0; i < W_PASSWORD; i++ )
+  {
+    random_r( &data, &r );
+    password[i] = password[i] ^ (char) r;
+  }
+  memset( state, 0, sizeof( state ) );
+#else
+  pthread_mutex_lock( &randlock );
+  srand( seed );
+  for ( i = 0; i < W_PASSWORD; i++ )
+    password[i] = password[i] ^ (char) rand();
+  pthread_mutex_unlock( &randlock );
+#endif
+}
+
+/****************************************************************************
+encrypt the password of entry, or decrypt it if it is encrypted.
+****************************************************************************/
+void reposCrypt( Entry *entry )
+{
+  unsigned long long t = traceClock();
+  cryptPassword( entry, entry->password );
+  traceSince( T_CRYPT, t );
+}
+
+/****************************************************************************
+decrypt the password of entry into password, W_PASSWORD + 1 bytes.
+****************************************************************************/
+void reposDecrypt( const Entry *entry, char *password )
+{
+  unsigned long long t = traceClock();
+  memcpy( password, entry->password, W_PASSWORD );
+  cryptPassword( entry, password );
+  password[W_PASSWORD] = 0;
+  traceSince( T_CRYPT, t );
+}
+
+/****************************************************************************
+lock the repository file for type F_RDLCK or F_WRLCK, trying LOCK_RETRIES
+more times LOCK_SLEEP apart if it is taken. while waiting, the holder of
+the lock is looked up and this process is listed as a waiter for opr
+--lock-status. file is opened for reading for a read lock and for writing
+for a write lock. returns -1 if the lock was not obtained. the wait is kept
+in the lockwait of repos and counted in the metrics.
+****************************************************************************/
+static int takeLock( Repos *repos, FILE *file, short type )
+{
+  char   name[W_REPOSNAME + sizeof( LOCKS_SUFFIX )];
+  int    r = -1;
+  struct flock all;
+  struct timespec req;
+  unsigned long long start = metricsClock();
+  LockWait *lockwait = &repos->lockwait;
+  req.tv_sec = 0;
+  req.tv_nsec = LOCK_SLEEP;
+  all.l_type = type;
+  all.l_whence = SEEK_SET;
+  all.l_start = 0;
+  all.l_len = 10;
+  lockwait->type = type;
+  lockwait->retries = 0;
+  lockwait->holder = 0;
+  lockwait->holdertype = F_UNLCK;
+  lockwait->command[0] = 0;
+  OPR_PROBE1( lock__acquire, type );
+  r = fcntl( fileno( file ),
+             F_SETLK,
+             &all );
+  while( r == -1 && ( errno == EAGAIN || errno == EACCES ) &&
+         lockwait->retries < LOCK_RETRIES )
+  {
+    lockHolder( fileno( file ), &all, lockwait );
+    if ( lockwait->retries == 0 )
+      snprintf( name, sizeof( name ), "%s%s", repos->filename, LOCKS_SUFFIX );
+    showWaiting( name, lockwait );
+    nanosleep( &req, NULL );
+    r = fcntl( fileno( file ),
+                F_SETLK,
+                &all );
+    lockwait->retries++;
+  }
+  if ( r == -1 ) repos->error = errno;
+  if ( lockwait->retries ) stopWaiting();
+  lockwait->waited = metricsClock() - start;
+  timeMetric( type == F_RDLCK ? H_LOCK_R : H_LOCK_W, lockwait->waited );
+  countMetric( type == F_RDLCK ? M_LOCK_RETRIES_R : M_LOCK_RETRIES_W,
+               lockwait->retries );
+  if ( r == -1 )
+    countMetric( type == F_RDLCK ? M_LOCK_FAILED_R : M_LOCK_FAILED_W, 1 );
+  OPR_PROBE5( lock__acquired, type, r, lockwait->retries, lockwait->waited,
+              lockwait->holder );
+  return r;
+}
+
+/****************************************************************************
+unlock the repository file.
+****************************************************************************/
+static int unLock( FILE *file )
+{
+  struct flock all;
+  OPR_PROBE0( lock__release );
+  all.l_type = F_UNLCK;
+  all.l_whence = SEEK_SET;
+  all.l_start = 0;
+  all.l_len = 10;
+  return fcntl( fileno( file ),
+                F_SETLK,
+                &all );
+}
+
+/****************************************************************************
+read a W_INTBUF string holding a number from file.
+****************************************************************************/
+static int readNumber( FILE *file )
+{
+  char intbuf[W_INTBUF + 1];
+  intbuf[W_INTBUF] = 0;
+  if ( fread( intbuf, W_INTBUF, 1, file ) != 1 ) return 0;
+  return atoi( intbuf );
+}
+
+/****************************************************************************
+write number to file as a W_INTBUF string.
+****************************************************************************/
+static void writeNumber( FILE *file, int number )
+{
+  char intbuf[W_INTBUF];
+  memset( intbuf, 0, sizeof( intbuf ) );
+  snprintf( intbuf, sizeof( intbuf ), "%d", number );
+  fwrite( intbuf, sizeof( intbuf ), 1, file );
+}
+
+/****************************************************************************
+read the repos header from file into header. all fields are stored as
+strings thereby making the repository platform independent. returns 0 on
+a read failure.
+****************************************************************************/
+static int readHeader( FILE *file, Header *header )
+{
+  if ( fread( header->magic, sizeof( header->magic ), 1, file ) != 1 ||
+       fread( header->reposowner, sizeof( header->reposowner ), 1, file ) != 1 ||
+       fread( header->logfile, sizeof( header->logfile ), 1, file ) != 1 )
+    return 0;
+  header->logfile[W_LOGFILE - 1] = 0;
+  header->entries = readNumber( file );
+  header->generation = 0;
+  header->loglevel = LOG_ALL;
+  header->loginterval = LOG_INTERVAL;
+  if ( strncmp( header->magic, MAGIC, W_MAGIC ) == 0 ||
+       strncmp( header->magic, MAGIC_120, W_MAGIC ) == 0 )
+    header->generation = readNumber( file );
+  if ( strncmp( header->magic, MAGIC, W_MAGIC ) == 0 )
+  {
+    header->loglevel = readNumber( file );
+    header->loginterval = readNumber( file );
+    if ( header->loglevel < LOG_ERRORS || header->loglevel > LOG_SUMMARY )
+      header->loglevel = LOG_ALL;
+    if ( header->loginterval < 1 ) header->loginterval = LOG_INTERVAL;
+  }
+  return !ferror( file );
+}
+
+/****************************************************************************
+write the repos header to file, with MAGIC. all fields are stored as
+strings making the repository platform indepenent.
+****************************************************************************/
+static int writeHeader( FILE *file, Header *header )
+{
+  strncpy( header->magic, MAGIC, sizeof( header->magic ) );
+  fwrite( header->magic, sizeof( header->magic ), 1, file );
+  fwrite( header->reposowner, sizeof( header->reposowner ), 1, file );
+  fwrite( header->logfile, sizeof( header->logfile ), 1, file );
+  writeNumber( file, header->entries );
+  writeNumber( file, header->generation );
+  writeNumber( file, header->loglevel );
+  writeNumber( file, header->loginterval );
+  return !ferror( file );
+}
+
+/****************************************************************************
+make room for count entries in repos.
+****************************************************************************/
+static int reserve( Repos *repos, int count )
+{
+  Entry *entries;
+  int   allocated = repos->allocated ? repos->allocated : 64;
+  if ( count <= repos->allocated ) return REPOS_OK;
+  while ( allocated < count ) allocated *= 2;
+  if ( allocated > MAX_ENTRIES ) allocated = MAX_ENTRIES;
+  if ( allocated < count ) return REPOS_EFULL;
+  entries = realloc( repos->entries, allocated * sizeof( Entry ) );
+  if ( !entries ) return REPOS_ENOMEM;
+  repos->entries = entries;
+  repos->allocated = allocated;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+load the repository from file, which is locked and at its start, into
+repos. the changes of repos are not replayed.
+****************************************************************************/
+static int load( Repos *repos, FILE *file )
+{
+  Header header;
+  int    r;
+  if ( !readHeader( file, &header ) ) return REPOS_EREAD;
+  if ( strncmp( header.magic, MAGIC, W_MAGIC ) != 0 &&
+       strncmp( header.magic, MAGIC_120, W_MAGIC ) != 0 &&
+       strncmp( header.magic, MAGIC_110, W_MAGIC ) != 0 )
+    return REPOS_EFORMAT;
+  if ( header.entries < 0 ) return REPOS_EFORMAT;
+  if ( header.entries > MAX_ENTRIES ) return REPOS_EFULL;
+  r = reserve( repos, header.entries );
+  if ( r != REPOS_OK ) return r;
+  repos->headersize = ftell( file );
+  if ( header.entries &&
+       fread( repos->entries, sizeof( Entry ), header.entries, file ) !=
+       header.entries )
+    return REPOS_EREAD;
+  if ( fstat( fileno( file ), &repos->loaded ) != 0 )
+  {
+    repos->error = errno;
+    return REPOS_EREAD;
+  }
+  repos->header = header;
+  repos->indexed = 0;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+read the repository file of repos.
+****************************************************************************/
+static int readRepos( Repos *repos )
+{
+  unsigned long long start = metricsClock();
+  unsigned long long t = traceClock();
+  FILE *file;
+  int  r;
+  OPR_PROBE0( repos__read__start );
+  file = fopen( repos->filename, "rb" );
+  traceSince( T_OPEN, t );
+  if ( !file )
+  {
+    repos->error = errno;
+    return REPOS_EOPEN;
+  }
+  // obtain read (shared) lock on the file, blocking
+  t = traceClock();
+  r = takeLock( repos, file, F_RDLCK );
+  traceSince( T_LOCK, t );
+  if ( r == -1 )
+  {
+    fclose( file );
+    return REPOS_ELOCK;
+  }
+  t = traceClock();
+  r = load( repos, file );
+  traceSince( T_PARSE, t );
+  unLock( file );
+  fclose( file );
+  if ( r != REPOS_OK ) return r;
+  timeMetric( H_LOAD, metricsClock() - start );
+  OPR_PROBE2( repos__read__done, repos->header.entries,
+              repos->header.generation );
+  return REPOS_OK;
+}
+
+/****************************************************************************
+the index of the first entry of repos not before entry, the number of
+entries if there is none.
+****************************************************************************/
+static int lowerBound( Repos *repos, const Entry *entry )
+{
+  int l = 0, r = repos->header.entries;
+  while ( l < r )
+  {
+    int m = ( l + r ) / 2;
+    if ( compareEntries( &repos->entries[m], entry ) < 0 ) l = m + 1;
+      else r = m;
+  }
+  return l;
+}
+
+/****************************************************************************
+fill entry with the names given, an empty password.
+****************************************************************************/
+static void makeEntry( Entry      *entry,
+                       const char *database,
+                       const char *schemaname,
+                       const char *osuser )
+{
+  memset( entry, 0, sizeof( Entry ) );
+  strncpy( entry->database, database, sizeof( entry->database ) );
+  strncpy( entry->schemaname, schemaname, sizeof( entry->schemaname ) );
+  strncpy( entry->osusername, osuser, sizeof( entry->osusername ) );
+}
+
+/****************************************************************************
+the index of the entry of repos with the names of entry, -1 if there is
+none.
+****************************************************************************/
+static int findIndex( Repos *repos, const Entry *entry )
+{
+  int i = lowerBound( repos, entry );
+  if ( i < repos->header.entries &&
+       compareEntries( &repos->entries[i], entry ) == 0 )
+    return i;
+  return -1;
+}
+
+/****************************************************************************
+insert entry in repos, in order.
+****************************************************************************/
+static int insertEntry( Repos *repos, const Entry *entry )
+{
+  int i = lowerBound( repos, entry ), r;
+  if ( i < repos->header.entries &&
+       compareEntries( &repos->entries[i], entry ) == 0 )
+    return REPOS_EDUP;
+  r = reserve( repos, repos->header.entries + 1 );
+  if ( r != REPOS_OK ) return r;
+  memmove( &repos->entries[i + 1],
+           &repos->entries[i],
+           ( repos->header.entries - i ) * sizeof( Entry ) );
+  repos->entries[i] = *entry;
+  repos->header.entries++;
+  repos->indexed = 0;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+remove the entry of repos with the names of entry.
+****************************************************************************/
+static int removeEntry( Repos *repos, const Entry *entry )
+{
+  int i = findIndex( repos, entry );
+  if ( i == -1 ) return REPOS_ENOENT;
+  memmove( &repos->entries[i],
+           &repos->entries[i + 1],
+           ( repos->header.entries - i - 1 ) * sizeof( Entry ) );
+  repos->header.entries--;
+  repos->indexed = 0;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+remove the entries of repos of osuser, in one pass. returns the number of
+entries removed.
+****************************************************************************/
+static int removeUser( Repos *repos, const char *osuser )
+{
+  int i, j;
+  for ( i = 0, j = 0; i < repos->header.entries; i++ )
+  {
+    if ( strncmp( repos->entries[i].osusername, osuser, W_OSUSERNAME ) == 0 )
+      continue;
+    if ( i != j ) repos->entries[j] = repos->entries[i];
+    j++;
+  }
+  memset( &repos->entries[j], 0, ( i - j ) * sizeof( Entry ) );
+  repos->header.entries = j;
+  if ( i != j ) repos->indexed = 0;
+  return i - j;
+}
+
+/****************************************************************************
+compare two entries by osuser, then by their position in the entries. this
+function is passed to qsort, to sort byuser.
+****************************************************************************/
+static int compareByUser( const void *p1, const void *p2 )
+{
+  const Entry *e1 = *(const Entry**) p1, *e2 = *(const Entry**) p2;
+  int result = strncmp( e1->osusername, e2->osusername, W_OSUSERNAME );
+  if ( !result ) result = e1 < e2 ? -1 : e1 > e2;
+  return result;
+}
+
+/****************************************************************************
+build byuser for the entries of repos. the caller holds the write lock.
+****************************************************************************/
+static int indexUsers( Repos *repos )
+{
+  const Entry **byuser;
+  int         i;
+  byuser = realloc( repos->byuser,
+                    ( repos->allocated ? repos->allocated : 1 ) *
+                    sizeof( Entry* ) );
+  if ( !byuser ) return REPOS_ENOMEM;
+  repos->byuser = byuser;
+  for ( i = 0; i < repos->header.entries; i++ )
+    byuser[i] = &repos->entries[i];
+  qsort( byuser, repos->header.entries, sizeof( Entry* ), compareByUser );
+  repos->indexed = 1;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+set the password of the entries of repos with the database and schema of
+entry to its (unencrypted) password. returns the number of entries set.
+****************************************************************************/
+static int setPassword( Repos *repos, const Entry *entry )
+{
+  Entry key = *entry;
+  int   i, n = 0;
+  memset( key.osusername, 0, sizeof( key.osusername ) );
+  for ( i = lowerBound( repos, &key ); i < repos->header.entries; i++ )
+  {
+    Entry *e = &repos->entries[i];
+    if ( strncmp( e->database, entry->database, W_DATABASE ) ||
+         strncmp( e->schemaname, entry->schemaname, W_SCHEMANAME ) )
+      break;
+    memcpy( e->password, entry->password, W_PASSWORD );
+    reposCrypt( e );
+    n++;
+  }
+  return n;
+}
+
+/****************************************************************************
+record change in repos, for reposCommit.
+****************************************************************************/
+static int record( Repos *repos, int type, const Entry *entry )
+{
+  if ( repos->nchanges == repos->allocatedchanges )
+  {
+    int    n = repos->allocatedchanges ? 2 * repos->allocatedchanges : 16;
+    Change *changes = malloc( n * sizeof( Change ) );
+    if ( !changes ) return REPOS_ENOMEM;
+    if ( repos->nchanges )
+      memcpy( changes, repos->changes, repos->nchanges * sizeof( Change ) );
+    if ( repos->changes )
+    {
+      memset( repos->changes, 0, repos->nchanges * sizeof( Change ) );
+      free( repos->changes );
+    }
+    repos->changes = changes;
+    repos->allocatedchanges = n;
+  }
+  repos->changes[repos->nchanges].type = type;
+  repos->changes[repos->nchanges].entry = *entry;
+  repos->nchanges++;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+apply the changes of repos again, to the repository as read since. an entry
+added meanwhile by another process gets the password of the one added by
+repos.
+****************************************************************************/
+static int replay( Repos *repos )
+{
+  int i, r;
+  for ( i = 0; i < repos->nchanges; i++ )
+  {
+    Change *c = &repos->changes[i];
+    if ( c->type == C_ADD )
+    {
+      int e = findIndex( repos, &c->entry );
+      if ( e != -1 ) repos->entries[e] = c->entry;
+      else
+      {
+        r = insertEntry( repos, &c->entry );
+        if ( r != REPOS_OK ) return r;
+      }
+    } else
+    if ( c->type == C_DELETE ) removeEntry( repos, &c->entry );
+    else
+    if ( c->type == C_PASSWORD ) setPassword( repos, &c->entry );
+    else
+    if ( c->type == C_DELUSER ) removeUser( repos, c->entry.osusername );
+  }
+  if ( repos->logchanged )
+  {
+    memcpy( repos->header.logfile, repos->logsettings.logfile, W_LOGFILE );
+    repos->header.loglevel = repos->logsettings.loglevel;
+    repos->header.loginterval = repos->logsettings.loginterval;
+  }
+  return REPOS_OK;
+}
+
+/****************************************************************************
+forget the changes of repos, they are committed or the handle is closed.
+****************************************************************************/
+static void forget( Repos *repos )
+{
+  if ( repos->changes )
+    memset( repos->changes, 0, repos->nchanges * sizeof( Change ) );
+  repos->nchanges = 0;
+  repos->logchanged = 0;
+  repos->views = V_KEEP;
+}
+
+/****************************************************************************
+compare two osuser names, passed by pointer. this function is passed to
+qsort.
+****************************************************************************/
+static int compareUsers( const void *p1, const void *p2 )
+{
+  return strncmp( *(const char**) p1, *(const char**) p2, W_OSUSERNAME );
+}
+
+/****************************************************************************
+write the view of osuser into the views directory dir: a repository file
+with the header of repos and only the entries of osuser, passwords still
+encrypted. it is written to a file named after osuser with a . before it,
+and renamed over the view, so readers never see it half written. an osuser
+without entries has its view removed. repos is indexed and write locked.
+osusers that cannot be a file name get no view, their reads fall back to
+the repository. returns -1 if the view was not written, having removed it.
+****************************************************************************/
+static int writeView( Repos *repos, const char *dir, const char *osuser )
+{
+  char   name[W_REPOSNAME + sizeof( VIEWS_SUFFIX ) + W_OSUSERNAME + 1];
+  char   temp[W_REPOSNAME + sizeof( VIEWS_SUFFIX ) + W_OSUSERNAME + 2];
+  char   user[W_OSUSERNAME + 1];
+  Header header;
+  FILE   *file;
+  int    fd, first, last, i, r;
+
+  snprintf( user, sizeof( user ), "%.*s", W_OSUSERNAME, osuser );
+  if ( user[0] == 0 || user[0] == '.' || strchr( user, '/' ) ) return 0;
+  snprintf( name, sizeof( name ), "%s/%s", dir, user );
+  snprintf( temp, sizeof( temp ), "%s/.%s", dir, user );
+
+  /* the entries of osuser in byuser */
+  first = 0;
+  last = repos->header.entries;
+  while ( first < last )
+  {
+    i = ( first + last ) / 2;
+    if ( strncmp( repos->byuser[i]->osusername, osuser, W_OSUSERNAME ) < 0 )
+      first = i + 1;
+    else last = i;
+  }
+  for ( last = first; last < repos->header.entries &&
+        strncmp( repos->byuser[last]->osusername, osuser,
+                 W_OSUSERNAME ) == 0; last++ );
+  if ( first == last )
+    return unlink( name ) == 0 || errno == ENOENT ? 0 : -1;
+
+  fd = open( temp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+  file = fd == -1 ? NULL : fdopen( fd, "w" );
+  r = file ? 0 : -1;
+  if ( fd != -1 && !file ) close( fd );
+  if ( file )
+  {
+    header = repos->header;
+    header.entries = last - first;
+    if ( !writeHeader( file, &header ) ) r = -1;
+    for ( i = first; i < last && r == 0; i++ )
+      if ( fwrite( repos->byuser[i], sizeof( Entry ), 1, file ) != 1 ) r = -1;
+    if ( fclose( file ) != 0 ) r = -1;
+    if ( r == 0 && rename( temp, name ) != 0 ) r = -1;
+  }
+  if ( r != 0 )
+  {
+    repos->error = errno;
+    unlink( temp );
+    unlink( name );
+  }
+  return r;
+}
+
+/****************************************************************************
+remove the files in the views directory dir, and dir itself if removedir is
+set.
+****************************************************************************/
+static int removeViews( const char *dir, int removedir )
+{
+  char          name[W_REPOSNAME + sizeof( VIEWS_SUFFIX ) + 256];
+  DIR           *views = opendir( dir );
+  struct dirent *d;
+  int           r = 0;
+  if ( !views ) return errno == ENOENT ? 0 : -1;
+  while ( ( d = readdir( views ) ) )
+  {
+    if ( strcmp( d->d_name, "." ) == 0 || strcmp( d->d_name, ".." ) == 0 )
+      continue;
+    snprintf( name, sizeof( name ), "%s/%s", dir, d->d_name );
+    if ( unlink( name ) != 0 ) r = -1;
+  }
+  closedir( views );
+  if ( removedir && r == 0 && rmdir( dir ) != 0 ) r = -1;
+  return r;
+}
+
+/****************************************************************************
+bring the views of repos up to date with the changes just written, while
+the repository is still locked: all views when they are created or the
+log settings, that they carry, changed, otherwise only those of the
+osusers whose entries changed. nothing is done if the repository has no
+views directory. repos is write locked.
+****************************************************************************/
+static int commitViews( Repos *repos )
+{
+  char        dir[W_REPOSNAME + sizeof( VIEWS_SUFFIX )];
+  const char  **users;
+  struct stat st;
+  int         n = 0, i, j, r = REPOS_OK;
+
+  snprintf( dir, sizeof( dir ), "%s%s", repos->filename, VIEWS_SUFFIX );
+  if ( repos->views == V_REMOVE )
+    return removeViews( dir, 1 ) == 0 ? REPOS_OK : REPOS_EVIEWS;
+  if ( repos->views == V_CREATE &&
+       mkdir( dir, S_IRWXU ) != 0 && errno != EEXIST )
+  {
+    repos->error = errno;
+    return REPOS_EVIEWS;
+  }
+  if ( stat( dir, &st ) != 0 || !S_ISDIR( st.st_mode ) ) return REPOS_OK;
+  if ( !repos->indexed && indexUsers( repos ) != REPOS_OK )
+    return REPOS_ENOMEM;
+
+  if ( repos->views == V_CREATE || repos->logchanged )
+  {
+    /* every osuser, once */
+    if ( removeViews( dir, 0 ) != 0 ) r = REPOS_EVIEWS;
+    for ( i = 0; i < repos->header.entries; i++ )
+      if ( ( i == 0 ||
+             strncmp( repos->byuser[i]->osusername,
+                      repos->byuser[i - 1]->osusername, W_OSUSERNAME ) ) &&
+           writeView( repos, dir, repos->byuser[i]->osusername ) != 0 )
+        r = REPOS_EVIEWS;
+    return r;
+  }
+
+  /* the osusers of the changes, those of a password change are the ones of
+     its database and schema */
+  for ( i = 0; i < repos->nchanges; i++ )
+    if ( repos->changes[i].type == C_PASSWORD )
+    {
+      Entry key = repos->changes[i].entry;
+      memset( key.osusername, 0, sizeof( key.osusername ) );
+      for ( j = lowerBound( repos, &key ); j < repos->header.entries &&
+            strncmp( repos->entries[j].database, key.database,
+                     W_DATABASE ) == 0 &&
+            strncmp( repos->entries[j].schemaname, key.schemaname,
+                     W_SCHEMANAME ) == 0; j++ )
+        n++;
+    } else n++;
+  if ( n == 0 ) return REPOS_OK;
+  users = malloc( n * sizeof( char* ) );
+  if ( !users ) return REPOS_ENOMEM;
+  n = 0;
+  for ( i = 0; i < repos->nchanges; i++ )
+    if ( repos->changes[i].type == C_PASSWORD )
+    {
+      Entry key = repos->changes[i].entry;
+      memset( key.osusername, 0, sizeof( key.osusername ) );
+      for ( j = lowerBound( repos, &key ); j < repos->header.entries &&
+            strncmp( repos->entries[j].database, key.database,
+                     W_DATABASE ) == 0 &&
+            strncmp( repos->entries[j].schemaname, key.schemaname,
+                     W_SCHEMANAME ) == 0; j++ )
+        users[n++] = repos->entries[j].osusername;
+    } else users[n++] = repos->changes[i].entry.osusername;
+  qsort( users, n, sizeof( char* ), compareUsers );
+  for ( i = 0; i < n; i++ )
+    if ( ( i == 0 || compareUsers( &users[i], &users[i - 1] ) ) &&
+         writeView( repos, dir, users[i] ) != 0 )
+      r = REPOS_EVIEWS;
+  free( users );
+  return r;
+}
+
+/****************************************************************************
+create a new, empty repository file owned by owner, readable and writable
+by its file owner only.
+****************************************************************************/
+int reposCreate( const char *filename, const char *owner )
+{
+  Header header;
+  FILE   *file;
+  int    fd;
+  if ( strlen( filename ) > W_REPOSNAME - 1 ||
+       strlen( owner ) > W_OSUSERNAME - 1 )
+    return REPOS_ENAME;
+  fd = open( filename, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR );
+  if ( fd == -1 ) return errno == EEXIST ? REPOS_EEXIST : REPOS_EOPEN;
+  file = fdopen( fd, "w" );
+  if ( !file )
+  {
+    close( fd );
+    return REPOS_EOPEN;
+  }
+  memset( &header, 0, sizeof( header ) );
+  strncpy( header.reposowner, owner, sizeof( header.reposowner ) );
+  header.loglevel = LOG_ALL;
+  header.loginterval = LOG_INTERVAL;
+  if ( !writeHeader( file, &header ) )
+  {
+    fclose( file );
+    return REPOS_EWRITE;
+  }
+  return fclose( file ) == 0 ? REPOS_OK : REPOS_EWRITE;
+}
+
+/****************************************************************************
+a new, empty handle on the repository file filename in *repos.
+****************************************************************************/
+static int newRepos( const char *filename, Repos **repos )
+{
+  Repos *r;
+  *repos = NULL;
+  if ( strlen( filename ) > W_REPOSNAME - 1 ) return REPOS_ENAME;
+  r = calloc( 1, sizeof( Repos ) );
+  if ( !r ) return REPOS_ENOMEM;
+  if ( pthread_rwlock_init( &r->lock, NULL ) != 0 )
+  {
+    free( r );
+    return REPOS_ENOMEM;
+  }
+  strncpy( r->filename, filename, sizeof( r->filename ) );
+  r->views = V_KEEP;
+  *repos = r;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+load the repository file filename into a new handle, *repos. *repos is
+also set if loading fails, for reposErrno and reposLockWait, unless with
+REPOS_ENOMEM or REPOS_ENAME. it is closed with reposClose.
+****************************************************************************/
+int reposOpen( const char *filename, Repos **repos )
+{
+  int r = newRepos( filename, repos );
+  if ( r != REPOS_OK ) return r;
+  return readRepos( *repos );
+}
+
+/****************************************************************************
+open the repository file filename for a single pass over its entries,
+without loading them, into a new handle *repos, set as with reposOpen. the
+header is read, and reposNext reads the entries one at a time. the file is
+read locked until reposClose. the handle has no entries to look up or
+change, and cannot be committed.
+****************************************************************************/
+int reposOpenStream( const char *filename, Repos **repos )
+{
+  Header header;
+  FILE   *file;
+  int    r = newRepos( filename, repos );
+  if ( r != REPOS_OK ) return r;
+  file = fopen( filename, "rb" );
+  if ( !file )
+  {
+    ( *repos )->error = errno;
+    return REPOS_EOPEN;
+  }
+  if ( takeLock( *repos, file, F_RDLCK ) == -1 )
+  {
+    fclose( file );
+    return REPOS_ELOCK;
+  }
+  r = REPOS_OK;
+  if ( !readHeader( file, &header ) ) r = REPOS_EREAD;
+  else
+  if ( ( strncmp( header.magic, MAGIC, W_MAGIC ) != 0 &&
+         strncmp( header.magic, MAGIC_120, W_MAGIC ) != 0 &&
+         strncmp( header.magic, MAGIC_110, W_MAGIC ) != 0 ) ||
+       header.entries < 0 ) r = REPOS_EFORMAT;
+  if ( r != REPOS_OK )
+  {
+    unLock( file );
+    fclose( file );
+    return r;
+  }
+  ( *repos )->headersize = ftell( file );
+  ( *repos )->remaining = header.entries;
+  header.entries = 0;
+  ( *repos )->header = header;
+  ( *repos )->stream = file;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+read the next entry of a handle of reposOpenStream into entry. returns
+REPOS_ENOENT after the last entry, REPOS_EREAD if the file ends before it.
+****************************************************************************/
+int reposNext( Repos *repos, Entry *entry )
+{
+  if ( !repos->stream || repos->remaining == 0 ) return REPOS_ENOENT;
+  if ( fread( entry, sizeof( Entry ), 1, repos->stream ) != 1 )
+    return REPOS_EREAD;
+  repos->remaining--;
+  return REPOS_OK;
+}
+
+/****************************************************************************
+load the repository again if it was written since it was loaded, the
+changes not committed yet are applied to it again.
+****************************************************************************/
+int reposReload( Repos *repos )
+{
+  struct stat st;
+  int         r = REPOS_OK;
+  pthread_rwlock_wrlock( &repos->lock );
+  if ( stat( repos->filename, &st ) != 0 ||
+       st.st_dev != repos->loaded.st_dev ||
+       st.st_ino != repos->loaded.st_ino ||
+       st.st_size != repos->loaded.st_size ||
+       st.st_mtime != repos->loaded.st_mtime ||
+       st.st_mtim.tv_nsec != repos->loaded.st_mtim.tv_nsec )
+  {
+    r = readRepos( repos );
+    if ( r == REPOS_OK ) r = replay( repos );
+  }
+  pthread_rwlock_unlock( &repos->lock );
+  return r;
+}
+
+/****************************************************************************
+close repos, changes that were not committed are lost.
+****************************************************************************/
+void reposClose( Repos *repos )
+{
+  if ( !repos ) return;
+  if ( repos->stream )
+  {
+    unLock( repos->stream );
+    fclose( repos->stream );
+  }
+  forget( repos );
+  free( repos->changes );
+  free( repos->byuser );
+  if ( repos->entries )
+    memset( repos->entries, 0, repos->allocated * sizeof( Entry ) );
+  free( repos->entries );
+  pthread_rwlock_destroy( &repos->lock );
+  free( repos );
+}
+
+/****************************************************************************
+write repos to its file. the file is truncated only once it is locked,
+readers would see it empty otherwise. if it was written by another process
+since repos was loaded, which the generation tells, it is read again and
+the changes of repos are applied to it. its views, if any, are brought up
+to date before it is unlocked.
+****************************************************************************/
+int reposCommit( Repos *repos )
+{
+  unsigned long long t = traceClock();
+  FILE   *file;
+  Header disk;
+  int    r;
+
+  /* a stream has not loaded the entries it would write */
+  if ( repos->stream ) return REPOS_EWRITE;
+  pthread_rwlock_wrlock( &repos->lock );
+  OPR_PROBE1( repos__write__start, repos->header.entries );
+  file = fopen( repos->filename, "r+b" );
+  traceSince( T_OPEN, t );
+  if ( !file )
+  {
+    repos->error = errno;
+    pthread_rwlock_unlock( &repos->lock );
+    return REPOS_EOPEN;
+  }
+  // obtain write lock on the file, blocking
+  t = traceClock();
+  r = takeLock( repos, file, F_WRLCK );
+  traceSince( T_LOCK, t );
+  if ( r == -1 )
+  {
+    fclose( file );
+    pthread_rwlock_unlock( &repos->lock );
+    return REPOS_ELOCK;
+  }
+  r = REPOS_OK;
+  if ( !readHeader( file, &disk ) ) r = REPOS_EREAD;
+  else
+  if ( disk.generation != repos->header.generation ||
+       strncmp( disk.magic, repos->header.magic, W_MAGIC ) != 0 )
+  {
+    t = traceClock();
+    rewind( file );
+    r = load( repos, file );
+    if ( r == REPOS_OK ) r = replay( repos );
+    traceSince( T_PARSE, t );
+  }
+  if ( r == REPOS_OK )
+  {
+    t = traceClock();
+    qsort( repos->entries, repos->header.entries, sizeof( Entry ),
+           compareEntries );
+    repos->indexed = 0;
+    traceSince( T_SORT, t );
+    t = traceClock();
+    repos->header.generation++;
+    rewind( file );
+    if ( ftruncate( fileno( file ), 0 ) == -1 )
+    {
+      repos->error = errno;
+      r = REPOS_EWRITE;
+    } else
+    if ( !writeHeader( file, &repos->header ) ||
+         ( repos->header.entries &&
+           fwrite( repos->entries, sizeof( Entry ), repos->header.entries,
+                   file ) != repos->header.entries ) ||
+         fflush( file ) != 0 )
+    {
+      repos->error = errno;
+      r = REPOS_EWRITE;
+    } else
+    {
+      repos->headersize = W_MAGIC + W_OSUSERNAME + W_LOGFILE + 4 * W_INTBUF;
+      fstat( fileno( file ), &repos->loaded );
+    }
+    traceSince( T_WRITE, t );
+    if ( r == REPOS_OK )
+    {
+      /* the repository is written, the changes are forgotten even if the
+         views are not */
+      t = traceClock();
+      r = commitViews( repos );
+      traceSince( T_VIEWS, t );
+      forget( repos );
+    }
+  }
+  unLock( file );
+  if ( fclose( file ) != 0 && r == REPOS_OK )
+  {
+    repos->error = errno;
+    r = REPOS_EWRITE;
+  }
+  if ( r == REPOS_OK )
+    OPR_PROBE2( repos__write__done, repos->header.entries,
+                repos->header.generation );
+  pthread_rwlock_unlock( &repos->lock );
+  return r;
+}
+
+/****************************************************************************
+look up the password of schemaname@database for osuser, decrypted into
+password of size bytes, at least W_PASSWORD + 1. returns REPOS_ENOENT if
+osuser has no such entry.
+****************************************************************************/
+int reposLookup( Repos      *repos,
+                 const char *database,
+                 const char *schemaname,
+                 const char *osuser,
+                 char       *password,
+                 size_t     size )
+{
+  unsigned long long t = traceClock();
+  char  plain[W_PASSWORD + 1];
+  Entry key;
+  int   i;
+  makeEntry( &key, database, schemaname, osuser );
+  pthread_rwlock_rdlock( &repos->lock );
+  i = findIndex( repos, &key );
+  traceSince( T_FIND, t );
+  if ( i != -1 ) reposDecrypt( &repos->entries[i], plain );
+  pthread_rwlock_unlock( &repos->lock );
+  OPR_PROBE4( find__entry, database, schemaname, osuser, i );
+  if ( i == -1 ) return REPOS_ENOENT;
+  snprintf( password, size, "%s", plain );
+  memset( plain, 0, sizeof( plain ) );
+  return REPOS_OK;
+}
+
+/****************************************************************************
+the index of the entry of (database, schemaname, osuser), -1 if there is
+none.
+****************************************************************************/
+int reposFind( Repos      *repos,
+               const char *database,
+               const char *schemaname,
+               const char *osuser )
+{
+  unsigned long long t = traceClock();
+  Entry key;
+  int   i;
+  makeEntry( &key, database, schemaname, osuser );
+  pthread_rwlock_rdlock( &repos->lock );
+  i = findIndex( repos, &key );
+  pthread_rwlock_unlock( &repos->lock );
+  traceSince( T_FIND, t );
+  OPR_PROBE4( find__entry, database, schemaname, osuser, i );
+  return i;
+}
+
+/****************************************************************************
+the index of the first entry of (database, schemaname), for any osuser, -1
+if there is none.
+****************************************************************************/
+int reposFindCredential( Repos      *repos,
+                         const char *database,
+                         const char *schemaname )
+{
+  Entry key;
+  int   i;
+  makeEntry( &key, database, schemaname, "" );
+  pthread_rwlock_rdlock( &repos->lock );
+  i = lowerBound( repos, &key );
+  if ( i == repos->header.entries ||
+       strncmp( repos->entries[i].database, key.database, W_DATABASE ) ||
+       strncmp( repos->entries[i].schemaname, key.schemaname, W_SCHEMANAME ) )
+    i = -1;
+  pthread_rwlock_unlock( &repos->lock );
+  return i;
+}
+
+/****************************************************************************
+compare entry with a range of database and schemaname, as reposRange. <0 if
+entry is before it, 0 if in it, >0 if after it.
+****************************************************************************/
+static int compareRange( const Entry *entry,
+                         const char  *database,
+                         int         dbprefix,
+                         const char  *schemaname,
+                         int         schemaprefix )
+{
+  int result = 0;
+  if ( database )
+    result = strncmp( entry->database,
+                      database,
+                      dbprefix ? strlen( database ) : W_DATABASE );
+  if ( !result && database && !dbprefix && schemaname )
+    result = strncmp( entry->schemaname,
+                      schemaname,
+                      schemaprefix ? strlen( schemaname ) : W_SCHEMANAME );
+  return result;
+}
+
+/****************************************************************************
+the index of the first entry of repos from l on that is not before the
+range, or is after it if after is set.
+****************************************************************************/
+static int rangeBound( Repos      *repos,
+                       int        l,
+                       const char *database,
+                       int        dbprefix,
+                       const char *schemaname,
+                       int        schemaprefix,
+                       int        after )
+{
+  int r = repos->header.entries;
+  while ( l < r )
+  {
+    int m = ( l + r ) / 2;
+    int c = compareRange( &repos->entries[m], database, dbprefix,
+                          schemaname, schemaprefix );
+    if ( c < 0 || ( after && c == 0 ) ) l = m + 1;
+      else r = m;
+  }
+  return l;
+}
+
+/****************************************************************************
+the entries of database, or of the databases starting with it if dbprefix
+is set, from *first up to *last, found by binary search. with an exact
+database, schemaname (or a prefix, with schemaprefix) narrows the range
+further; with a database prefix the schemas of the range are not ordered,
+and are not looked at. a NULL database is the whole repository. returns
+the number of entries in the range.
+****************************************************************************/
+int reposRange( Repos      *repos,
+                const char *database,
+                int        dbprefix,
+                const char *schemaname,
+                int        schemaprefix,
+                int        *first,
+                int        *last )
+{
+  pthread_rwlock_rdlock( &repos->lock );
+  *first = rangeBound( repos, 0, database, dbprefix,
+                       schemaname, schemaprefix, 0 );
+  *last = rangeBound( repos, *first, database, dbprefix,
+                      schemaname, schemaprefix, 1 );
+  pthread_rwlock_unlock( &repos->lock );
+  return *last - *first;
+}
+
+/****************************************************************************
+the entries of osuser, from *first up to *last in the osuser index, see
+reposUserEntry. the index is built on the first call after a change, after
+that this takes time in the number of entries of osuser. returns that
+number, or REPOS_ENOMEM.
+****************************************************************************/
+int reposUserRange( Repos      *repos,
+                    const char *osuser,
+                    int        *first,
+                    int        *last )
+{
+  int l, r, m;
+  pthread_rwlock_rdlock( &repos->lock );
+  while ( !repos->indexed )
+  {
+    int result = REPOS_OK;
+    pthread_rwlock_unlock( &repos->lock );
+    pthread_rwlock_wrlock( &repos->lock );
+    if ( !repos->indexed ) result = indexUsers( repos );
+    pthread_rwlock_unlock( &repos->lock );
+    if ( result != REPOS_OK ) return result;
+    pthread_rwlock_rdlock( &repos->lock );
+  }
+  l = 0;
+  r = repos->header.entries;
+  while ( l < r )
+  {
+    m = ( l + r ) / 2;
+    if ( strncmp( repos->byuser[m]->osusername, osuser, W_OSUSERNAME ) < 0 )
+      l = m + 1;
+    else r = m;
+  }
+  *first = l;
+  r = repos->header.entries;
+  while ( l < r )
+  {
+    m = ( l + r ) / 2;
+    if ( strncmp( repos->byuser[m]->osusername, osuser, W_OSUSERNAME ) <= 0 )
+      l = m + 1;
+    else r = m;
+  }
+  *last = l;
+  pthread_rwlock_unlock( &repos->lock );
+  return *last - *first;
+}
+
+/****************************************************************************
+the entry at position of the osuser index of repos, valid until repos is
+changed.
+****************************************************************************/
+const Entry *reposUserEntry( Repos *repos, int position )
+{
+  return repos->byuser[position];
+}
+
+/****************************************************************************
+the number of entries of repos.
+****************************************************************************/
+int reposCount( Repos *repos )
+{
+  int count;
+  pthread_rwlock_rdlock( &repos->lock );
+  count = repos->header.entries;
+  pthread_rwlock_unlock( &repos->lock );
+  return count;
+}
+
+/****************************************************************************
+the entry at index of repos, valid until repos is changed.
+****************************************************************************/
+const Entry *reposEntry( Repos *repos, int index )
+{
+  return &repos->entries[index];
+}
+
+/****************************************************************************
+add the entry (database, schemaname, osuser) with password, unencrypted.
+****************************************************************************/
+int reposAdd( Repos      *repos,
+              const char *database,
+              const char *schemaname,
+              const char *osuser,
+              const char *password )
+{
+  Entry entry;
+  int   r;
+  if ( strlen( database ) > W_DATABASE - 1 ||
+       strlen( schemaname ) > W_SCHEMANAME - 1 ||
+       strlen( osuser ) > W_OSUSERNAME - 1 ||
+       strlen( password ) > W_PASSWORD - 1 )
+    return REPOS_ENAME;
+  makeEntry( &entry, database, schemaname, osuser );
+  strncpy( entry.password, password, sizeof( entry.password ) );
+  reposCrypt( &entry );
+  pthread_rwlock_wrlock( &repos->lock );
+  r = insertEntry( repos, &entry );
+  if ( r == REPOS_OK ) r = record( repos, C_ADD, &entry );
+  pthread_rwlock_unlock( &repos->lock );
+  memset( &entry, 0, sizeof( entry ) );
+  return r;
+}
+
+/****************************************************************************
+delete the entry (database, schemaname, osuser).
+****************************************************************************/
+int reposDelete( Repos      *repos,
+                 const char *database,
+                 const char *schemaname,
+                 const char *osuser )
+{
+  Entry entry;
+  int   r;
+  makeEntry( &entry, database, schemaname, osuser );
+  pthread_rwlock_wrlock( &repos->lock );
+  r = removeEntry( repos, &entry );
+  if ( r == REPOS_OK ) r = record( repos, C_DELETE, &entry );
+  pthread_rwlock_unlock( &repos->lock );
+  return r;
+}
+
+/****************************************************************************
+delete every entry of osuser. returns the number of entries deleted.
+****************************************************************************/
+int reposDeleteUser( Repos *repos, const char *osuser )
+{
+  Entry entry;
+  int   n, r = REPOS_OK;
+  makeEntry( &entry, "", "", osuser );
+  pthread_rwlock_wrlock( &repos->lock );
+  n = removeUser( repos, entry.osusername );
+  if ( n > 0 ) r = record( repos, C_DELUSER, &entry );
+  pthread_rwlock_unlock( &repos->lock );
+  return r == REPOS_OK ? n : r;
+}
+
+/****************************************************************************
+set the password of every entry of (database, schemaname) to password,
+unencrypted. returns the number of entries set.
+****************************************************************************/
+int reposSetPassword( Repos      *repos,
+                      const char *database,
+                      const char *schemaname,
+                      const char *password )
+{
+  Entry entry;
+  int   n, r;
+  if ( strlen( password ) > W_PASSWORD - 1 ) return REPOS_ENAME;
+  makeEntry( &entry, database, schemaname, "" );
+  strncpy( entry.password, password, sizeof( entry.password ) );
+  pthread_rwlock_wrlock( &repos->lock );
+  n = setPassword( repos, &entry );
+  r = n > 0 ? record( repos, C_PASSWORD, &entry ) : REPOS_OK;
+  pthread_rwlock_unlock( &repos->lock );
+  memset( &entry, 0, sizeof( entry ) );
+  return r == REPOS_OK ? n : r;
+}
+
+/****************************************************************************
+set the logfile, an empty one disabling logging, the LOG level and the
+interval of read summaries.
+****************************************************************************/
+int reposSetLog( Repos      *repos,
+                 const char *logfile,
+                 int        loglevel,
+                 int        loginterval )
+{
+  if ( strlen( logfile ) > W_LOGFILE - 1 ) return REPOS_ENAME;
+  pthread_rwlock_wrlock( &repos->lock );
+  memset( repos->header.logfile, 0, W_LOGFILE );
+  strncpy( repos->header.logfile, logfile, W_LOGFILE );
+  if ( loglevel >= LOG_ERRORS && loglevel <= LOG_SUMMARY )
+    repos->header.loglevel = loglevel;
+  if ( loginterval > 0 ) repos->header.loginterval = loginterval;
+  repos->logsettings = repos->header;
+  repos->logchanged = 1;
+  pthread_rwlock_unlock( &repos->lock );
+  return REPOS_OK;
+}
+
+/****************************************************************************
+have the next reposCommit create the views of repos, with enable set, or
+remove them. see oprrepos.h.
+****************************************************************************/
+void reposSetViews( Repos *repos, int enable )
+{
+  pthread_rwlock_wrlock( &repos->lock );
+  repos->views = enable ? V_CREATE : V_REMOVE;
+  pthread_rwlock_unlock( &repos->lock );
+}
+
+/****************************************************************************
+tell if repos has views, a views directory.
+****************************************************************************/
+int reposViews( Repos *repos )
+{
+  char        dir[W_REPOSNAME + sizeof( VIEWS_SUFFIX )];
+  struct stat st;
+  snprintf( dir, sizeof( dir ), "%s%s", repos->filename, VIEWS_SUFFIX );
+  return stat( dir, &st ) == 0 && S_ISDIR( st.st_mode );
+}
+
+/****************************************************************************
+the properties of repos.
+****************************************************************************/
+const char *reposFilename( Repos *repos )
+{
+  return repos->filename;
+}
+
+const char *reposMagic( Repos *repos )
+{
+  return repos->header.magic;
+}
+
+const char *reposOwner( Repos *repos )
+{
+  return repos->header.reposowner;
+}
+
+const char *reposLogfile( Repos *repos )
+{
+  return repos->header.logfile;
+}
+
+int reposLogLevel( Repos *repos )
+{
+  return repos->header.loglevel;
+}
+
+int reposLogInterval( Repos *repos )
+{
+  return repos->header.loginterval;
+}
+
+int reposGeneration( Repos *repos )
+{
+  return repos->header.generation;
+}
+
+long reposHeaderSize( Repos *repos )
+{
+  return repos->headersize;
+}
+
+const LockWait *reposLockWait( Repos *repos )
+{
+  return &repos->lockwait;
+}
+
+int reposErrno( Repos *repos )
+{
+  return repos->error;
+}
@@ -0,0 +1,248 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+/****************************************************************************
+the repository library: a repository file loaded into a handle, looked up
+and changed in memory, and written back with reposCommit. the functions
+return a REPOS result instead of exiting, reposError describes it.
+
+lookups (reposLookup, reposFind, reposFindCredential, reposRange,
+reposUserRange) may be called from several threads on one handle, also
+while another thread changes or reloads it. reposEntry and reposUserEntry
+return a pointer into the handle, that is only valid until the handle is
+changed, reloaded or closed.
+
+a handle does not keep the repository locked. reposCommit writes the
+changes made since the repository was loaded; if another process wrote the
+repository meanwhile, it reads it again under the write lock and applies
+the changes to that, so the changes of neither are lost.
+
+a repository can have views, made by reposSetViews: a directory next to it
+holding a repository file per osuser, with the header of the repository and
+only the entries of that osuser. opening the view of an osuser with
+reposOpen loads just those entries. reposCommit rewrites the views of the
+osusers whose entries changed, under the write lock, so views are only kept
+up to date if every writer uses this library. an osuser without a view has
+no entries, or a name that cannot be a file name; a reader then uses the
+repository itself. REPOS_EVIEWS from reposCommit means the repository was
+written but views may have been removed.
+
+reposOpenStream reads the entries one at a time with reposNext instead of
+loading them, for a single pass over a repository of any size.
+****************************************************************************/
+
+#ifndef _OPRREPOS_H
+#define _OPRREPOS_H 1
+
+#include <stddef.h>
+#include "oprlock.h"
+
+/* maximum number of entries allowed in the password repository. the
+   benchmarks build opr with a larger value, see bench/Makefile.am */
+#ifndef MAX_ENTRIES
+#define MAX_ENTRIES 4096
+#endif
+
+/* MAGIC is used to do a (simple) check on the repository file. repositories
+   with the previous MAGIC_120 and MAGIC_110 are read, and written with
+   MAGIC. */
+#define MAGIC "OraclePasswordRepository 1.3.0 "
+#define MAGIC_120 "OraclePasswordRepository 1.2.0 "
+#define MAGIC_110 "OraclePasswordRepository 1.1.0 "
+#define W_MAGIC  32
+
+/* maximum length of the pathname to the repository file (Practical value) */
+#define W_REPOSNAME 256
+
+/* maximum length of the pathname to the log file (Practical Value) */
+#define W_LOGFILE 256 
+
+/* maximum length of a database name (TNS Name length max hard to find in the
+   Oracle manuals, so a pratical value is chosen. You can increase if needed */
+#define W_DATABASE 64
+
+/* maximum length of a schemaname (Oracle defined max) */
+#define W_SCHEMANAME 30
+
+/* maximum length of a password (Oracle defined max) */
+#define W_PASSWORD 30 
+
+/* maximum length of an OSusername (Practical value)*/
+#define W_OSUSERNAME 32
+ 
+/* size of int to string conversion buffers */
+#define W_INTBUF 32 
+
+/* the views directory, named after the repository with this appended */
+#define VIEWS_SUFFIX ".views"
+
+/* log levels: errors only, errors and changes, everything, or everything
+   with successful reads summarized */
+#define LOG_ERRORS  0
+#define LOG_CHANGES 1
+#define LOG_ALL     2
+#define LOG_SUMMARY 3
+
+/* default number of seconds successful reads are summarized over */
+#define LOG_INTERVAL 3600
+
+/* results of the repository functions */
+#define REPOS_OK        0
+#define REPOS_EOPEN    -1
+#define REPOS_EEXIST   -2
+#define REPOS_ELOCK    -3
+#define REPOS_EFORMAT  -4
+#define REPOS_EREAD    -5
+#define REPOS_EWRITE   -6
+#define REPOS_ENOENT   -7
+#define REPOS_EDUP     -8
+#define REPOS_EFULL    -9
+#define REPOS_ENAME   -10
+#define REPOS_ENOMEM  -11
+#define REPOS_EVIEWS  -12
+
+/****************************************************************************
+a repository entry :
+  database   - the name of the database
+  schemaname - the name of the schema
+  osusername - the name of the osuser allowed to read the password
+  password   - the password for schemaname@database, encrypted
+the names fill their fields without a terminating 0 at full width. this is
+also the layout of an entry in the repository file.
+****************************************************************************/
+typedef struct {
+  char database[W_DATABASE];
+  char schemaname[W_SCHEMANAME];
+  char osusername[W_OSUSERNAME];
+  char password[W_PASSWORD];
+} Entry;
+
+/* a loaded repository */
+typedef struct Repos Repos;
+
+const char *reposError( int result );
+
+int reposCreate( const char *filename, const char *owner );
+
+int reposOpen( const char *filename, Repos **repos );
+
+int reposOpenStream( const char *filename, Repos **repos );
+
+int reposNext( Repos *repos, Entry *entry );
+
+int reposReload( Repos *repos );
+
+void reposClose( Repos *repos );
+
+int reposCommit( Repos *repos );
+
+int reposLookup( Repos      *repos,
+                 const char *database,
+                 const char *schemaname,
+                 const char *osuser,
+                 char       *password,
+                 size_t     size );
+
+int reposFind( Repos      *repos,
+               const char *database,
+               const char *schemaname,
+               const char *osuser );
+
+int reposFindCredential( Repos      *repos,
+                         const char *database,
+                         const char *schemaname );
+
+int reposRange( Repos      *repos,
+                const char *database,
+                int        dbprefix,
+                const char *schemaname,
+                int        schemaprefix,
+                int        *first,
+                int        *last );
+
+int reposUserRange( Repos      *repos,
+                    const char *osuser,
+                    int        *first,
+                    int        *last );
+
+const Entry *reposUserEntry( Repos *repos, int position );
+
+int reposCount( Repos *repos );
+
+const Entry *reposEntry( Repos *repos, int index );
+
+int reposAdd( Repos      *repos,
+              const char *database,
+              const char *schemaname,
+              const char *osuser,
+              const char *password );
+
+int reposDelete( Repos      *repos,
+                 const char *database,
+                 const char *schemaname,
+                 const char *osuser );
+
+int reposDeleteUser( Repos *repos, const char *osuser );
+
+int reposSetPassword( Repos      *repos,
+                      const char *database,
+                      const char *schemaname,
+                      const char *password );
+
+int reposSetLog( Repos      *repos,
+                 const char *logfile,
+                 int        loglevel,
+                 int        loginterval );
+
+void reposSetViews( Repos *repos, int enable );
+
+int reposViews( Repos *repos );
+
+const char *reposFilename( Repos *repos );
+
+const char *reposMagic( Repos *repos );
+
+const char *reposOwner( Repos *repos );
+
+const char *reposLogfile( Repos *repos );
+
+int reposLogLevel( Repos *repos );
+
+int reposLogInterval( Repos *repos );
+
+int reposGeneration( Repos *repos );
+
+long reposHeaderSize( Repos *repos );
+
+const LockWait *reposLockWait( Repos *repos );
+
+int reposErrno( Repos *repos );
+
+void reposCrypt( Entry *entry );
+
+void reposDecrypt( const Entry *entry, char *password );
+
+int compareEntries( const void *p1, const void *p2 );
+
+#endif // !_OPRREPOS_H
@@ -0,0 +1,167 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "oprtrace.h"
+
+/* the environment variable that enables tracing */
+#define OPR_TRACE "OPR_TRACE"
+
+/* width of the trace line */
+#define W_TRACELINE 1024
+
+/* the names of the phases, in the trace line */
+static const char *phasenames[T_PHASES] = {
+  "env", "osuser", "open", "lock", "parse", "sort", "find", "crypt",
+  "write", "views", "log", "oralibs", "oci_env", "oci_attach",
+  "oci_logon", "oci_logoff", "oci_change", "oci_query" };
+
+/* set if OPR_TRACE is set, nothing is timed otherwise */
+static int tracing = 0;
+
+/* the trace file, NULL for stderr */
+static const char *tracefile = NULL;
+
+/* the operation traced and when tracing started */
+static const char *tracedoperation = "";
+static unsigned long long tracestart;
+
+/* the microseconds spent in, and the number of passes through, each phase.
+   OCI calls are timed by several threads, so these are added atomically */
+static unsigned long long spent[T_PHASES];
+static unsigned long      passes[T_PHASES];
+
+/****************************************************************************
+  purpose: the monotonic clock in microseconds, 0 when not tracing.
+****************************************************************************/
+unsigned long long traceClock()
+{
+  struct timespec now;
+  if ( !tracing ) return 0;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (unsigned long long) now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/****************************************************************************
+  purpose: add us microseconds to phase.
+****************************************************************************/
+void traceSpent( int phase, unsigned long long us )
+{
+  if ( !tracing ) return;
+  __atomic_fetch_add( &spent[phase], us, __ATOMIC_RELAXED );
+  __atomic_fetch_add( &passes[phase], 1, __ATOMIC_RELAXED );
+}
+
+/****************************************************************************
+  purpose: add the time since start, from traceClock, to phase.
+****************************************************************************/
+void traceSince( int phase, unsigned long long start )
+{
+  if ( !tracing ) return;
+  traceSpent( phase, traceClock() - start );
+}
+
+/****************************************************************************
+  purpose: name the operation traced.
+****************************************************************************/
+void traceOperation( const char *operation )
+{
+  tracedoperation = operation;
+}
+
+/****************************************************************************
+write the trace line at exit, for example
+  opr trace pid=4242 op=read total_us=812 env=2 osuser=11 open=25 lock=3
+  parse=40 find=1 crypt=1 log=95
+phases passed more than once have their count appended, as in
+oci_logon=52311/40. phases not passed are left out. the line is written
+once, by traceEnd or else at exit.
+****************************************************************************/
+static void writeTrace()
+{
+  char line[W_TRACELINE];
+  char *end = line + sizeof( line ) - 1;
+  char *p = line;
+  int  i, fd = 2;
+
+  if ( !tracing ) return;
+  p += snprintf( p, end - p, "opr trace pid=%ld op=%s total_us=%llu",
+                 (long) getpid(),
+                 *tracedoperation ? tracedoperation : "-",
+                 traceClock() - tracestart );
+  for ( i = 0; i < T_PHASES && p < end; i++ )
+  {
+    if ( passes[i] == 0 ) continue;
+    p += snprintf( p, end - p, " %s=%llu", phasenames[i], spent[i] );
+    if ( passes[i] > 1 && p < end )
+      p += snprintf( p, end - p, "/%lu", passes[i] );
+  }
+  if ( p >= end ) p = end - 1;
+  *p++ = '\n';
+  tracing = 0;
+  if ( tracefile )
+    fd = open( tracefile,
+               O_WRONLY | O_APPEND | O_CREAT,
+               S_IRUSR | S_IWUSR );
+  if ( fd < 0 ) return;
+  if ( write( fd, line, p - line ) < 0 )
+    fprintf( stderr, "unable to write the trace to %s.\n", tracefile );
+  if ( fd != 2 ) close( fd );
+}
+
+/****************************************************************************
+  purpose: start tracing if OPR_TRACE is set. with OPR_TRACE=1 the trace
+           line goes to stderr, any other value names a file it is appended
+           to. a setuid opr only traces to stderr, so it cannot be used to
+           write to files of its owner. the trace is never written to
+           stdout, which carries the password of opr -r.
+****************************************************************************/
+void traceStart()
+{
+  char *t = getenv( OPR_TRACE );
+  if ( !t || !*t || strcmp( t, "0" ) == 0 ) return;
+  if ( strcmp( t, "1" ) != 0 && getuid() == geteuid() ) tracefile = t;
+  tracing = 1;
+  tracestart = traceClock();
+  atexit( writeTrace );
+}
+
+/****************************************************************************
+  purpose: write the trace line now, for a process that ends without
+           running its exit handlers.
+****************************************************************************/
+void traceEnd()
+{
+  writeTrace();
+}
@@ -0,0 +1,62 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRTRACE_H
+#define _OPRTRACE_H 1
+
+/* the phases timed by OPR_TRACE, the OCI calls in the order of their
+   metrics histograms */
+#define T_ENV         0
+#define T_OSUSER      1
+#define T_OPEN        2
+#define T_LOCK        3
+#define T_PARSE       4
+#define T_SORT        5
+#define T_FIND        6
+#define T_CRYPT       7
+#define T_WRITE       8
+#define T_VIEWS       9
+#define T_LOG        10
+#define T_ORALIBS    11
+#define T_OCI_ENV    12
+#define T_OCI_ATTACH 13
+#define T_OCI_LOGON  14
+#define T_OCI_LOGOFF 15
+#define T_OCI_CHANGE 16
+#define T_OCI_QUERY  17
+#define T_PHASES     18
+
+void traceStart();
+
+void traceEnd();
+
+void traceOperation( const char *operation );
+
+unsigned long long traceClock();
+
+void traceSince( int phase, unsigned long long start );
+
+void traceSpent( int phase, unsigned long long us );
+
+#endif // !_OPRTRACE_H
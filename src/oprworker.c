@@ -0,0 +1,644 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+/* struct ucred */
+#ifndef _GNU_SOURCE
+  #define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "oprworker.h"
+#include "oprtrace.h"
+
+/* the directory holding the worker sockets, a per user directory is made
+   in it */
+#define WORKER_DIR "/tmp"
+
+/* milliseconds a command waits for a started worker to accept requests */
+#define WORKER_START_WAIT 10000
+
+/* width of the names and passwords sent to the worker */
+#define W_WORKERFIELD 128
+
+/* request types */
+#define WORKER_CHECK  1
+#define WORKER_CHANGE 2
+
+/* the environment variables that determine which databases a worker
+   connects to. commands only use a worker started with the same values. */
+static const char *workerenv[] = { "ORACLE_HOME",
+                                   "ORACLE_SID",
+                                   "TWO_TASK",
+                                   "TNS_ADMIN",
+                                   "NLS_LANG",
+                                   NULL };
+
+int  useworker = 0;
+int  workeridle = WORKER_IDLE;
+char *workerprogram = "opr";
+
+/****************************************************************************
+a request to the worker, followed by count WorkerItems. the timeouts and
+the scheduling are those of the command.
+****************************************************************************/
+typedef struct {
+  int    type;
+  int    count;
+  int    threads;
+  int    deadline;
+  int    attachtimeout;
+  int    logintimeout;
+  int    changetimeout;
+  int    dbthreads;
+  double loginrate;
+} WorkerRequest;
+
+/****************************************************************************
+a single check or password change. monitor is empty for logon checks,
+newpasswd is only used for a change.
+****************************************************************************/
+typedef struct {
+  char database[W_WORKERFIELD];
+  char schema[W_WORKERFIELD];
+  char passwd[W_WORKERFIELD];
+  char newpasswd[W_WORKERFIELD];
+  char monitor[W_WORKERFIELD];
+  char monitorpasswd[W_WORKERFIELD];
+} WorkerItem;
+
+/****************************************************************************
+the worker answers each item with a WorkerReply. for a change, result and
+message are those of its DBChange.
+****************************************************************************/
+typedef struct {
+  int    result;
+  int    oracode;
+  double timing[DBPHASES];
+  char   message[W_ORAMSG];
+} WorkerReply;
+
+/****************************************************************************
+read or write exactly size bytes, returns 0 on error or end of file.
+****************************************************************************/
+static int readFull( int fd, void *buffer, size_t size )
+{
+  char    *p = (char*) buffer;
+  ssize_t n;
+  while ( size > 0 )
+  {
+    n = read( fd, p, size );
+    if ( n < 0 && errno == EINTR ) continue;
+    if ( n <= 0 ) return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+static int writeFull( int fd, const void *buffer, size_t size )
+{
+  const char *p = (const char*) buffer;
+  ssize_t    n;
+  while ( size > 0 )
+  {
+    n = write( fd, p, size );
+    if ( n < 0 && errno == EINTR ) continue;
+    if ( n <= 0 ) return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+/****************************************************************************
+copy s into a WorkerItem field, returns 0 if it does not fit.
+****************************************************************************/
+static int setField( char *field, const char *s )
+{
+  if ( strlen( s ) >= W_WORKERFIELD ) return 0;
+  strncpy( field, s, W_WORKERFIELD );
+  return 1;
+}
+
+/****************************************************************************
+returns the uid of the process on the other end of a unix socket, -1 if it
+cannot be determined.
+****************************************************************************/
+static long peerUid( int fd )
+{
+#if defined(SO_PEERCRED)
+  struct ucred cred;
+  socklen_t    size = sizeof( cred );
+  if ( getsockopt( fd, SOL_SOCKET, SO_PEERCRED, &cred, &size ) == 0 )
+    return (long) cred.uid;
+#elif defined(HAVE_GETPEEREID)
+  uid_t uid;
+  gid_t gid;
+  if ( getpeereid( fd, &uid, &gid ) == 0 ) return (long) uid;
+#endif
+  return -1;
+}
+
+/****************************************************************************
+the socket path of the worker for this user and environment. the directory
+is created if needed, and must be a directory owned by and only accessible
+to the user. returns 0 if it is not.
+****************************************************************************/
+static int workerPath( char *path, size_t size, const char *suffix )
+{
+  struct stat   st;
+  unsigned long hash = 2166136261UL;
+  const char    *v;
+  int           i;
+
+  snprintf( path, size, "%s/opr-%ld", WORKER_DIR, (long) geteuid() );
+  if ( mkdir( path, S_IRWXU ) != 0 && errno != EEXIST ) return 0;
+  if ( lstat( path, &st ) != 0 ||
+       !S_ISDIR( st.st_mode ) ||
+       st.st_uid != geteuid() ||
+       ( st.st_mode & ( S_IRWXG | S_IRWXO ) ) ) return 0;
+
+  for ( i = 0; workerenv[i]; i++ )
+  {
+    v = getenv( workerenv[i] );
+    for ( ; v && *v; v++ ) hash = ( hash ^ (unsigned char) *v ) * 16777619UL;
+    hash = ( hash ^ '\n' ) * 16777619UL;
+  }
+  snprintf( path + strlen( path ),
+            size - strlen( path ),
+            "/worker-%08lx%s",
+            hash & 0xffffffffUL,
+            suffix );
+  return 1;
+}
+
+/****************************************************************************
+start a worker, detached from the command. it gets no descriptors of the
+command, so that it holds no lock on the repository nor any of its pipes.
+****************************************************************************/
+static void startWorker()
+{
+  char  self[1024];
+  char  idle[32];
+  char  *program = workerprogram;
+  pid_t pid;
+  int   fd;
+  ssize_t n;
+
+  n = readlink( "/proc/self/exe", self, sizeof( self ) - 1 );
+  if ( n > 0 )
+  {
+    self[n] = 0;
+    program = self;
+  }
+  snprintf( idle, sizeof( idle ), "--worker-idle=%d", workeridle );
+
+  fflush( stdout );
+  fflush( stderr );
+  pid = fork();
+  if ( pid < 0 ) return;
+  if ( pid == 0 )
+  {
+    setsid();
+    if ( fork() != 0 ) _exit( 0 );
+    fd = open( "/dev/null", O_RDWR );
+    if ( fd >= 0 )
+    {
+      dup2( fd, 0 );
+      dup2( fd, 1 );
+      dup2( fd, 2 );
+    }
+    for ( fd = 3; fd < 1024; fd++ ) close( fd );
+    execl( program, program, "--worker-serve", idle, (char*) 0 );
+    _exit( 1 );
+  }
+  waitpid( pid, 0, 0 );
+}
+
+/****************************************************************************
+connect to the worker, starting it if it does not run. the worker must run
+as the same user. returns the socket, -1 if no worker could be reached.
+****************************************************************************/
+static int connectWorker()
+{
+  struct sockaddr_un addr;
+  struct timespec    pause = { 0, 50000000 };
+  int                fd, waited, started = 0;
+
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  if ( !workerPath( addr.sun_path, sizeof( addr.sun_path ), ".sock" ) )
+    return -1;
+
+  for ( waited = 0; waited <= WORKER_START_WAIT; waited += 50 )
+  {
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 ) return -1;
+    if ( connect( fd, (struct sockaddr*) &addr, sizeof( addr ) ) == 0 )
+    {
+      if ( peerUid( fd ) == (long) geteuid() ) return fd;
+      close( fd );
+      return -1;
+    }
+    close( fd );
+    if ( errno != ENOENT && errno != ECONNREFUSED ) return -1;
+    if ( !started )
+    {
+      startWorker();
+      started = 1;
+    }
+    nanosleep( &pause, 0 );
+  }
+  return -1;
+}
+
+/****************************************************************************
+send a request and its items to the worker. returns the connected socket,
+-1 if no worker could be reached or the request could not be sent.
+****************************************************************************/
+static int sendRequest( WorkerRequest *request, WorkerItem *items )
+{
+  int fd = connectWorker();
+  if ( fd < 0 ) return -1;
+  if ( !writeFull( fd, request, sizeof( *request ) ) ||
+       !writeFull( fd, items, request->count * sizeof( WorkerItem ) ) )
+  {
+    close( fd );
+    return -1;
+  }
+  return fd;
+}
+
+/****************************************************************************
+checks the database/schema password combinations like checkDBPasswords.
+with useworker, the checks are done by the worker. otherwise, or when no
+worker can be reached, the checks are done by this process.
+****************************************************************************/
+void workerCheckDBPasswords( DBCheck *checks,
+                             int     count,
+                             int     threads,
+                             int     deadline )
+{
+  WorkerRequest request;
+  WorkerItem    *items = NULL;
+  WorkerReply   reply;
+  int           fd = -1, i, ok = 1;
+
+  if ( useworker && count > 0 )
+    items = (WorkerItem*) calloc( count, sizeof( WorkerItem ) );
+  for ( i = 0; items && i < count; i++ )
+  {
+    ok = ok &&
+         setField( items[i].database, checks[i].database ) &&
+         setField( items[i].schema, checks[i].schema ) &&
+         setField( items[i].passwd, checks[i].passwd );
+    if ( checks[i].monitor )
+      ok = ok &&
+           setField( items[i].monitor, checks[i].monitor ) &&
+           setField( items[i].monitorpasswd, checks[i].monitorpasswd );
+  }
+  if ( items && ok )
+  {
+    request.type = WORKER_CHECK;
+    request.count = count;
+    request.threads = threads;
+    request.deadline = deadline;
+    request.attachtimeout = attachtimeout;
+    request.logintimeout = logintimeout;
+    request.changetimeout = changetimeout;
+    request.dbthreads = dbthreads;
+    request.loginrate = loginrate;
+    fd = sendRequest( &request, items );
+  }
+  if ( items )
+  {
+    memset( items, 0, count * sizeof( WorkerItem ) );
+    free( items );
+  }
+  if ( fd >= 0 )
+  {
+    for ( i = 0; i < count; i++ )
+    {
+      if ( !readFull( fd, &reply, sizeof( reply ) ) ) break;
+      checks[i].result = reply.result;
+      checks[i].oracode = reply.oracode;
+      memcpy( checks[i].timing, reply.timing, sizeof( checks[i].timing ) );
+      memcpy( checks[i].message, reply.message, sizeof( checks[i].message ) );
+      checks[i].message[sizeof( checks[i].message ) - 1] = 0;
+    }
+    close( fd );
+    if ( i == count ) return;
+    /* checks are harmless to repeat */
+    fprintf( stderr, "lost connection to the opr worker.\n" );
+  }
+  loadOraLibs();
+  checkDBPasswords( checks, count, threads, deadline );
+}
+
+/****************************************************************************
+checks the database/schema password combination like checkDBPassword,
+through the worker with useworker.
+****************************************************************************/
+int workerCheckDBPassword( char* database,
+                           char* schema,
+                           char* passwd )
+{
+  DBCheck check;
+  check.database = database;
+  check.schema = schema;
+  check.passwd = passwd;
+  check.monitor = NULL;
+  workerCheckDBPasswords( &check, 1, 1, 0 );
+  if ( strlen( check.message ) > 0 )
+    fprintf( stderr, "%s", check.message );
+  return check.result == DBCHECK_OK;
+}
+
+/****************************************************************************
+changes count passwords like changeDBPasswords. with useworker, the changes
+are made by the worker. otherwise, or when no worker can be reached, they
+are made by this process. once the changes are sent, they are never
+repeated locally : a change the worker does not answer is DBCHECK_TIMEOUT,
+its password may or may not have been changed.
+****************************************************************************/
+void workerChangeDBPasswords( DBChange *changes,
+                              int      count,
+                              int      threads )
+{
+  WorkerRequest request;
+  WorkerItem    *items = NULL;
+  WorkerReply   reply;
+  int           fd = -1, i, ok = 1;
+
+  if ( useworker && count > 0 )
+    items = (WorkerItem*) calloc( count, sizeof( WorkerItem ) );
+  for ( i = 0; items && i < count; i++ )
+    ok = ok &&
+         setField( items[i].database, changes[i].database ) &&
+         setField( items[i].schema, changes[i].schema ) &&
+         setField( items[i].passwd, changes[i].oldpasswd ) &&
+         setField( items[i].newpasswd, changes[i].newpasswd );
+  if ( items && ok )
+  {
+    request.type = WORKER_CHANGE;
+    request.count = count;
+    request.threads = threads;
+    request.deadline = 0;
+    request.attachtimeout = attachtimeout;
+    request.logintimeout = logintimeout;
+    request.changetimeout = changetimeout;
+    request.dbthreads = dbthreads;
+    request.loginrate = loginrate;
+    fd = sendRequest( &request, items );
+  }
+  if ( items )
+  {
+    memset( items, 0, count * sizeof( WorkerItem ) );
+    free( items );
+  }
+  if ( fd < 0 )
+  {
+    loadOraLibs();
+    changeDBPasswords( changes, count, threads );
+    return;
+  }
+  for ( i = 0; i < count; i++ )
+  {
+    if ( !readFull( fd, &reply, sizeof( reply ) ) ) break;
+    changes[i].result = reply.result;
+    memcpy( changes[i].message, reply.message, sizeof( changes[i].message ) );
+    changes[i].message[sizeof( changes[i].message ) - 1] = 0;
+  }
+  close( fd );
+  for ( ; i < count; i++ )
+  {
+    changes[i].result = DBCHECK_TIMEOUT;
+    snprintf( changes[i].message,
+              sizeof( changes[i].message ),
+              "lost connection to the opr worker, the password may have"
+              " been changed.\n" );
+  }
+}
+
+/****************************************************************************
+changes a password like changeDBPassword, through the worker with
+useworker. if the worker does not answer, the outcome is unknown and 0 is
+returned.
+****************************************************************************/
+int workerChangeDBPassword( char* database,
+                            char* schema,
+                            char* oldpasswd,
+                            char* newpasswd )
+{
+  DBChange change;
+  change.database = database;
+  change.schema = schema;
+  change.oldpasswd = oldpasswd;
+  change.newpasswd = newpasswd;
+  workerChangeDBPasswords( &change, 1, 1 );
+  if ( strlen( change.message ) > 0 )
+    fprintf( stderr, "%s", change.message );
+  return change.result == DBCHECK_OK;
+}
+
+/****************************************************************************
+serve a single request on a connected socket. returns 0 if the worker must
+exit afterwards, because checks were abandoned and may still be running.
+****************************************************************************/
+static int serveRequest( int fd )
+{
+  WorkerRequest request;
+  WorkerItem    *items;
+  WorkerReply   reply;
+  DBCheck       *checks = NULL;
+  DBChange      *changes = NULL;
+  int           i, complete = 1;
+
+  if ( !readFull( fd, &request, sizeof( request ) ) ||
+       request.count < 1 || request.count > 65536 ) return 1;
+  items = (WorkerItem*) calloc( request.count, sizeof( WorkerItem ) );
+  if ( request.type == WORKER_CHANGE )
+    changes = (DBChange*) calloc( request.count, sizeof( DBChange ) );
+  else
+    checks = (DBCheck*) calloc( request.count, sizeof( DBCheck ) );
+  if ( !items || ( !checks && !changes ) ||
+       !readFull( fd, items, request.count * sizeof( WorkerItem ) ) )
+  {
+    free( items );
+    free( checks );
+    free( changes );
+    return 1;
+  }
+  for ( i = 0; i < request.count; i++ )
+  {
+    items[i].database[W_WORKERFIELD - 1] = 0;
+    items[i].schema[W_WORKERFIELD - 1] = 0;
+    items[i].passwd[W_WORKERFIELD - 1] = 0;
+    items[i].newpasswd[W_WORKERFIELD - 1] = 0;
+    items[i].monitor[W_WORKERFIELD - 1] = 0;
+    items[i].monitorpasswd[W_WORKERFIELD - 1] = 0;
+  }
+  attachtimeout = request.attachtimeout;
+  logintimeout = request.logintimeout;
+  changetimeout = request.changetimeout;
+  dbthreads = request.dbthreads;
+  loginrate = request.loginrate;
+
+  if ( request.type == WORKER_CHANGE )
+  {
+    /* the changes run on the environment kept by the worker */
+    for ( i = 0; i < request.count; i++ )
+    {
+      changes[i].database = items[i].database;
+      changes[i].schema = items[i].schema;
+      changes[i].oldpasswd = items[i].passwd;
+      changes[i].newpasswd = items[i].newpasswd;
+    }
+    changeDBPasswords( changes, request.count, request.threads );
+    for ( i = 0; i < request.count; i++ )
+    {
+      memset( &reply, 0, sizeof( reply ) );
+      reply.result = changes[i].result;
+      memcpy( reply.message, changes[i].message, sizeof( reply.message ) );
+      if ( !writeFull( fd, &reply, sizeof( reply ) ) ) break;
+    }
+  } else
+  if ( request.type == WORKER_CHECK )
+  {
+    for ( i = 0; i < request.count; i++ )
+    {
+      checks[i].database = items[i].database;
+      checks[i].schema = items[i].schema;
+      checks[i].passwd = items[i].passwd;
+      checks[i].monitor = items[i].monitor[0] ? items[i].monitor : NULL;
+      checks[i].monitorpasswd = items[i].monitorpasswd;
+    }
+    complete = checkDBPasswords( checks,
+                                 request.count,
+                                 request.threads,
+                                 request.deadline );
+    for ( i = 0; i < request.count; i++ )
+    {
+      memset( &reply, 0, sizeof( reply ) );
+      reply.result = checks[i].result;
+      reply.oracode = checks[i].oracode;
+      memcpy( reply.timing, checks[i].timing, sizeof( reply.timing ) );
+      memcpy( reply.message, checks[i].message, sizeof( reply.message ) );
+      if ( !writeFull( fd, &reply, sizeof( reply ) ) ) break;
+    }
+  }
+  memset( items, 0, request.count * sizeof( WorkerItem ) );
+  free( items );
+  free( checks );
+  free( changes );
+  return complete;
+}
+
+/****************************************************************************
+run as the worker of the invoking user: load the oracle libraries and keep
+an OCI environment, then serve requests of the same user on the worker
+socket, one at a time, until none came for workeridle seconds. only one
+worker runs per user and environment, a second one exits at once.
+****************************************************************************/
+void runWorker()
+{
+  struct sockaddr_un addr;
+  char               lockname[sizeof( addr.sun_path )];
+  struct pollfd      listener;
+  int                lock, fd, r;
+
+  if ( getuid() != geteuid() )
+  {
+    fprintf( stderr, "the opr worker must be started by its own user.\n" );
+    exit( -1 );
+  }
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  if ( !workerPath( addr.sun_path, sizeof( addr.sun_path ), ".sock" ) ||
+       !workerPath( lockname, sizeof( lockname ), ".lock" ) )
+  {
+    fprintf( stderr, "no private directory for the opr worker.\n" );
+    exit( -1 );
+  }
+  lock = open( lockname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR );
+  if ( lock < 0 || flock( lock, LOCK_EX | LOCK_NB ) != 0 ) exit( 0 );
+
+  signal( SIGPIPE, SIG_IGN );
+  loadOraLibs();
+  keepOraEnv();
+
+  umask( S_IRWXG | S_IRWXO );
+  unlink( addr.sun_path );
+  listener.fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( listener.fd < 0 ||
+       bind( listener.fd, (struct sockaddr*) &addr, sizeof( addr ) ) != 0 ||
+       listen( listener.fd, 16 ) != 0 )
+  {
+    fprintf( stderr, "unable to listen on %s.\n", addr.sun_path );
+    exit( -1 );
+  }
+  listener.events = POLLIN;
+
+  for ( ;; )
+  {
+    r = poll( &listener, 1, workeridle * 1000 );
+    if ( r < 0 && errno == EINTR ) continue;
+    if ( r <= 0 ) break;
+    fd = accept( listener.fd, 0, 0 );
+    if ( fd < 0 ) continue;
+    r = 1;
+    if ( peerUid( fd ) == (long) geteuid() ) r = serveRequest( fd );
+    close( fd );
+    if ( !r ) break;
+  }
+  unlink( addr.sun_path );
+  close( listener.fd );
+  /* abandoned checks may still run in the oracle client library, which
+     exit handlers and unloading it would pull away from under them */
+  if ( oraAbandoned() )
+  {
+    traceEnd();
+    _exit( 0 );
+  }
+  unloadOraLibs();
+  exit( 0 );
+}
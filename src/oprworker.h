@@ -0,0 +1,62 @@
+/****************************************************************************
+
+                      opr - Oracle Password Repository
+
+                 Copyright (C) 2000-2013 Jan-Marten Spit
+                       (jmspit@euronet.nl)
+
+       This program is free software; you can redistribute it and/or
+       modify it under the terms of the GNU General Public License
+       as published by the Free Software Foundation; either version 2
+       of the License, or (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+       MA  02111-1307, USA.
+
+****************************************************************************/
+
+#ifndef _OPRWORKER_H
+#define _OPRWORKER_H 1
+
+#include "oprora.h"
+
+/* default number of seconds a worker waits for a request before it exits */
+#define WORKER_IDLE 600
+
+/* if set, database calls are sent to the worker process of the user */
+extern int useworker;
+
+/* seconds a started worker waits for a request before it exits */
+extern int workeridle;
+
+/* the path by which opr was started, used to start a worker */
+extern char *workerprogram;
+
+void workerCheckDBPasswords( DBCheck *checks,
+                             int     count,
+                             int     threads,
+                             int     deadline );
+
+int workerCheckDBPassword( char* database,
+                           char* schema,
+                           char* passwd );
+
+void workerChangeDBPasswords( DBChange *changes,
+                              int      count,
+                              int      threads );
+
+int workerChangeDBPassword( char* database,
+                            char* schema,
+                            char* oldpasswd,
+                            char* newpasswd );
+
+void runWorker();
+
+#endif // !_OPRWORKER_H